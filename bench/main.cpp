@@ -0,0 +1,1822 @@
+#include "Bvh.h"
+#include "Camera.h"
+#include "Framebuffer.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "HeadlessContext.h"
+#include "LightClusters.h"
+#include "Memory.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Model.h"
+#include "Profiler.h"
+#include "Renderer.h"
+#include "SceneGraph.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "Texture.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Headless frame-time benchmark. Renders the cube/light scene into an
+// offscreen framebuffer along a scripted camera path and reports per-frame
+// timings as JSON:
+//
+//   OpenGL-Learn-Bench [--frames N] [--warmup N] [--width W] [--height H]
+//                      [--cubes N] [--lights N]
+//                      [--submission per-object|instanced]
+//                      [--path forward|deferred] [--occlusion on|off]
+//                      [--state-cache on|off] [--stream persistent|orphan]
+//                      [--spotlight on|off] [--shadows on|off] [--shadow-cache on|off]
+//                      [--scenario scene|instancing|uniforms|lights|culling|occlusion|
+//                                  scenegraph|jobs|memory|statecache|streaming|paths|textures|
+//                                  models|shaders|variants|meshopt|vertexformat|lod|shadows]
+//                      [--model file] [--output file.json] [--trace file.json]
+//
+// The "scene" scenario (default) reports every frame of a single run; the
+// others sweep a parameter and report one summary per run. --trace writes
+// the profiler's CPU and GPU scopes over the measured frames as a Chrome
+// trace (of the last run, when there are several).
+
+namespace {
+
+struct BenchOptions {
+  int frames = 500;
+  int warmup = 50;
+  int width = 1920;
+  int height = 1080;
+  unsigned int cubes = 10;
+  unsigned int lights = 4;
+  SubmissionMode submission = SubmissionMode::Instanced;
+  RenderPath path = RenderPath::Forward;
+  bool occlusion = true;
+  bool stateCache = true;
+  bool persistentStreaming = true;
+  bool spotlight = false;
+  bool shadows = true;
+  bool shadowCache = true;
+  std::string scenario = "scene";
+  std::string model; // for the mesh scenarios; empty generates one
+  std::string output;
+  std::string trace;
+};
+
+struct FrameSample {
+  double cpuMs = 0.0;   // time spent submitting the frame
+  double gpuMs = 0.0;   // GL_TIME_ELAPSED for the frame
+  double frameMs = 0.0; // interval between consecutive frame starts
+  unsigned int drawCalls = 0;
+  unsigned int frustumCulled = 0;
+  unsigned int occluded = 0;
+  unsigned int visible = 0;
+  unsigned int packets = 0;
+  unsigned int unsortedStateChanges = 0;
+  unsigned int stateChanges = 0;
+  unsigned int glIssued = 0;
+  unsigned int glFiltered = 0;
+  size_t streamedBytes = 0;
+  unsigned int streamWaits = 0;
+  uint64_t heapAllocations = 0; // operator new calls while rendering the frame
+  ShadowCascadeStats shadowCascades[CascadedShadowMaps::CASCADE_COUNT];
+};
+
+// Timer queries are read back this many frames late so the CPU never waits
+// on the GPU to get a result
+const int QUERY_LATENCY = 4;
+// Frames the CPU may run ahead of the GPU, like a double-buffered swap chain
+const int FRAMES_IN_FLIGHT = 2;
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool parseArgs(int argc, char **argv, BenchOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--frames" && hasValue) {
+      options.frames = std::stoi(argv[++i]);
+    } else if (arg == "--warmup" && hasValue) {
+      options.warmup = std::stoi(argv[++i]);
+    } else if (arg == "--width" && hasValue) {
+      options.width = std::stoi(argv[++i]);
+    } else if (arg == "--height" && hasValue) {
+      options.height = std::stoi(argv[++i]);
+    } else if (arg == "--cubes" && hasValue) {
+      options.cubes = (unsigned int)std::stoul(argv[++i]);
+    } else if (arg == "--lights" && hasValue) {
+      options.lights = (unsigned int)std::stoul(argv[++i]);
+    } else if (arg == "--submission" && hasValue) {
+      std::string mode = argv[++i];
+      if (mode != "per-object" && mode != "instanced") {
+        std::cerr << "Unknown submission mode: " << mode << std::endl;
+        return false;
+      }
+      options.submission = mode == "instanced" ? SubmissionMode::Instanced : SubmissionMode::PerObject;
+    } else if (arg == "--path" && hasValue) {
+      std::string path = argv[++i];
+      if (path != "forward" && path != "deferred") {
+        std::cerr << "Unknown render path: " << path << std::endl;
+        return false;
+      }
+      options.path = path == "deferred" ? RenderPath::Deferred : RenderPath::Forward;
+    } else if (arg == "--occlusion" && hasValue) {
+      std::string occlusion = argv[++i];
+      if (occlusion != "on" && occlusion != "off") {
+        std::cerr << "Unknown occlusion setting: " << occlusion << std::endl;
+        return false;
+      }
+      options.occlusion = occlusion == "on";
+    } else if (arg == "--state-cache" && hasValue) {
+      std::string stateCache = argv[++i];
+      if (stateCache != "on" && stateCache != "off") {
+        std::cerr << "Unknown state cache setting: " << stateCache << std::endl;
+        return false;
+      }
+      options.stateCache = stateCache == "on";
+    } else if (arg == "--stream" && hasValue) {
+      std::string stream = argv[++i];
+      if (stream != "persistent" && stream != "orphan") {
+        std::cerr << "Unknown stream setting: " << stream << std::endl;
+        return false;
+      }
+      options.persistentStreaming = stream == "persistent";
+    } else if (arg == "--spotlight" && hasValue) {
+      std::string spotlight = argv[++i];
+      if (spotlight != "on" && spotlight != "off") {
+        std::cerr << "Unknown spotlight setting: " << spotlight << std::endl;
+        return false;
+      }
+      options.spotlight = spotlight == "on";
+    } else if (arg == "--shadows" && hasValue) {
+      std::string shadows = argv[++i];
+      if (shadows != "on" && shadows != "off") {
+        std::cerr << "Unknown shadows setting: " << shadows << std::endl;
+        return false;
+      }
+      options.shadows = shadows == "on";
+    } else if (arg == "--shadow-cache" && hasValue) {
+      std::string shadowCache = argv[++i];
+      if (shadowCache != "on" && shadowCache != "off") {
+        std::cerr << "Unknown shadow cache setting: " << shadowCache << std::endl;
+        return false;
+      }
+      options.shadowCache = shadowCache == "on";
+    } else if (arg == "--scenario" && hasValue) {
+      options.scenario = argv[++i];
+    } else if (arg == "--model" && hasValue) {
+      options.model = argv[++i];
+    } else if (arg == "--output" && hasValue) {
+      options.output = argv[++i];
+    } else if (arg == "--trace" && hasValue) {
+      options.trace = argv[++i];
+    } else {
+      std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+      return false;
+    }
+  }
+  return options.frames > 0 && options.warmup >= 0 && options.width > 0 && options.height > 0;
+}
+
+// Orbit around the middle of the cube field, bobbing up and down, so every
+// run sees the same sequence of views
+void updateCameraPath(Camera &camera, int frame, int frameCount) {
+  const glm::vec3 center(0.0f, 0.0f, -6.0f);
+  float t = (float)frame / (float)frameCount * 2.0f * 3.14159265f;
+  camera.Position = center + glm::vec3(12.0f * std::cos(t), 3.0f * std::sin(2.0f * t), 12.0f * std::sin(t));
+  camera.LookAt(center);
+}
+
+// Nearest-rank percentile
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+  return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+}
+
+void writeSummary(std::ostream &out, const char *indent, const char *name, const std::vector<double> &values) {
+  double sum = 0.0;
+  for (double v : values) {
+    sum += v;
+  }
+  out << indent << "  \"" << name << "\": {"
+      << "\"mean\": " << (values.empty() ? 0.0 : sum / values.size())
+      << ", \"p50\": " << percentile(values, 50.0)
+      << ", \"p95\": " << percentile(values, 95.0)
+      << ", \"p99\": " << percentile(values, 99.0)
+      << ", \"max\": " << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end()))
+      << "}";
+}
+
+const char *submissionName(SubmissionMode mode) {
+  return mode == SubmissionMode::Instanced ? "instanced" : "per-object";
+}
+
+const char *pathName(RenderPath path) {
+  return path == RenderPath::Deferred ? "deferred" : "forward";
+}
+
+// Writes the summary fields of one run; the caller closes the object
+void writeRun(std::ostream &out, const std::vector<FrameSample> &samples, const char *indent) {
+  std::vector<double> cpu, gpu, frame;
+  double frustumCulled = 0.0, occluded = 0.0, visible = 0.0;
+  double packets = 0.0, unsortedStateChanges = 0.0, stateChanges = 0.0;
+  double glIssued = 0.0, glFiltered = 0.0;
+  double streamedBytes = 0.0, streamWaits = 0.0;
+  double heapAllocations = 0.0;
+  uint64_t maxHeapAllocations = 0;
+  const unsigned int cascadeCount = CascadedShadowMaps::CASCADE_COUNT;
+  double cascadeRendered[cascadeCount] = {}, cascadeCasters[cascadeCount] = {};
+  double cascadeDrawCalls[cascadeCount] = {}, cascadeGpuMs[cascadeCount] = {};
+  unsigned int cascadeTimed[cascadeCount] = {};
+  for (const FrameSample &s : samples) {
+    cpu.push_back(s.cpuMs);
+    gpu.push_back(s.gpuMs);
+    frame.push_back(s.frameMs);
+    frustumCulled += s.frustumCulled;
+    occluded += s.occluded;
+    visible += s.visible;
+    packets += s.packets;
+    unsortedStateChanges += s.unsortedStateChanges;
+    stateChanges += s.stateChanges;
+    glIssued += s.glIssued;
+    glFiltered += s.glFiltered;
+    streamedBytes += s.streamedBytes;
+    streamWaits += s.streamWaits;
+    heapAllocations += s.heapAllocations;
+    maxHeapAllocations = std::max(maxHeapAllocations, s.heapAllocations);
+    for (unsigned int c = 0; c < cascadeCount; c++) {
+      const ShadowCascadeStats &cascade = s.shadowCascades[c];
+      cascadeRendered[c] += cascade.rendered ? 1.0 : 0.0;
+      cascadeCasters[c] += cascade.casters;
+      cascadeDrawCalls[c] += cascade.drawCalls;
+      cascadeGpuMs[c] += cascade.gpuMs;
+      cascadeTimed[c] += cascade.gpuMs > 0.0 ? 1 : 0;
+    }
+  }
+  double frames = std::max<double>(1.0, (double)samples.size());
+
+  out << indent << "\"frames\": " << samples.size() << ",\n";
+  out << indent << "\"drawCalls\": " << (samples.empty() ? 0 : samples.back().drawCalls) << ",\n";
+  // Objects per frame, averaged over the run
+  out << indent << "\"objects\": {\"frustumCulled\": " << frustumCulled / frames
+      << ", \"occluded\": " << occluded / frames << ", \"visible\": " << visible / frames << "},\n";
+  // Render queue packets and state changes in recording and in sorted order
+  out << indent << "\"queue\": {\"packets\": " << packets / frames
+      << ", \"unsortedStateChanges\": " << unsortedStateChanges / frames
+      << ", \"stateChanges\": " << stateChanges / frames << "},\n";
+  // Binds the GL state cache passed on to the driver vs dropped as redundant
+  out << indent << "\"glState\": {\"issued\": " << glIssued / frames << ", \"filtered\": " << glFiltered / frames
+      << "},\n";
+  // Per-frame data written into the stream buffer, and how often a frame
+  // found its region still in use by the GPU
+  out << indent << "\"stream\": {\"bytes\": " << streamedBytes / frames << ", \"waits\": " << streamWaits / frames
+      << "},\n";
+  // Heap allocations per frame; the steady state is meant to have none
+  out << indent << "\"heapAllocations\": {\"mean\": " << heapAllocations / frames << ", \"max\": " << maxHeapAllocations
+      << "},\n";
+  // Per shadow cascade: the fraction of frames it was drawn in rather than
+  // kept from the cache, casters and draw calls per drawn frame, and its GPU
+  // time per frame overall and per draw
+  out << indent << "\"shadowCascades\": [";
+  for (unsigned int c = 0; c < cascadeCount; c++) {
+    double drawn = std::max(1.0, cascadeRendered[c]);
+    out << (c > 0 ? ", " : "") << "{\"rendered\": " << cascadeRendered[c] / frames
+        << ", \"casters\": " << cascadeCasters[c] / drawn << ", \"drawCalls\": " << cascadeDrawCalls[c] / drawn
+        << ", \"gpuMs\": " << cascadeGpuMs[c] / frames
+        << ", \"gpuMsPerDraw\": " << cascadeGpuMs[c] / std::max(1u, cascadeTimed[c]) << "}";
+  }
+  out << "],\n";
+  out << indent << "\"summary\": {\n";
+  writeSummary(out, indent, "frameMs", frame);
+  out << ",\n";
+  writeSummary(out, indent, "cpuMs", cpu);
+  out << ",\n";
+  writeSummary(out, indent, "gpuMs", gpu);
+  out << "\n" << indent << "}";
+}
+
+void writeSamples(std::ostream &out, const std::vector<FrameSample> &samples) {
+  out << "  \"samples\": [\n";
+  for (size_t i = 0; i < samples.size(); i++) {
+    const FrameSample &s = samples[i];
+    out << "    {\"frameMs\": " << s.frameMs << ", \"cpuMs\": " << s.cpuMs
+        << ", \"gpuMs\": " << s.gpuMs << ", \"drawCalls\": " << s.drawCalls
+        << ", \"frustumCulled\": " << s.frustumCulled << ", \"occluded\": " << s.occluded
+        << ", \"visible\": " << s.visible << ", \"packets\": " << s.packets
+        << ", \"unsortedStateChanges\": " << s.unsortedStateChanges << ", \"stateChanges\": " << s.stateChanges
+        << ", \"glIssued\": " << s.glIssued << ", \"glFiltered\": " << s.glFiltered
+        << ", \"streamedBytes\": " << s.streamedBytes << ", \"streamWaits\": " << s.streamWaits
+        << ", \"heapAllocations\": " << s.heapAllocations << "}"
+        << (i + 1 < samples.size() ? ",\n" : "\n");
+  }
+  out << "  ]";
+}
+
+void writeHeader(std::ostream &out, const BenchOptions &options) {
+  out << "  \"renderer\": \"" << (const char *)glGetString(GL_RENDERER) << "\",\n";
+  out << "  \"scenario\": \"" << options.scenario << "\",\n";
+  out << "  \"width\": " << options.width << ",\n";
+  out << "  \"height\": " << options.height << ",\n";
+}
+
+// One entry of a JSON array such as a scenario's runs: the fields telling
+// the entries apart and what was measured, in the order they were added.
+// Summaries of measured values, or a run of rendered frames (see
+// writeRun()), go under "summary"; an entry with neither fits on one line.
+struct Record {
+  std::vector<std::pair<const char *, std::string>> fields; // values as JSON
+  std::vector<std::pair<const char *, std::vector<double>>> summaries;
+  std::vector<FrameSample> frames;
+
+  Record &add(const char *name, const std::string &value) {
+    fields.emplace_back(name, "\"" + value + "\"");
+    return *this;
+  }
+  Record &add(const char *name, const char *value) { return add(name, std::string(value)); }
+  Record &add(const char *name, bool value) {
+    fields.emplace_back(name, value ? "true" : "false");
+    return *this;
+  }
+  template <typename T>
+    requires std::is_arithmetic_v<T>
+  Record &add(const char *name, T value) {
+    std::ostringstream text;
+    text << value;
+    fields.emplace_back(name, text.str());
+    return *this;
+  }
+  Record &summarize(const char *name, std::vector<double> values) {
+    summaries.emplace_back(name, std::move(values));
+    return *this;
+  }
+  Record &setFrames(std::vector<FrameSample> samples) {
+    frames = std::move(samples);
+    return *this;
+  }
+};
+
+// Writes records as the array name; the caller closes the object
+void writeRecords(std::ostream &out, const char *name, const std::vector<Record> &records) {
+  out << "  \"" << name << "\": [\n";
+  for (size_t i = 0; i < records.size(); i++) {
+    const Record &record = records[i];
+    bool expanded = !record.frames.empty() || !record.summaries.empty();
+    out << "    {" << (expanded ? "\n" : "");
+    for (size_t f = 0; f < record.fields.size(); f++) {
+      const auto &[field, value] = record.fields[f];
+      if (expanded) {
+        out << "      \"" << field << "\": " << value << ",\n";
+      } else {
+        out << (f > 0 ? ", " : "") << "\"" << field << "\": " << value;
+      }
+    }
+    if (!record.frames.empty()) {
+      writeRun(out, record.frames, "      ");
+    } else if (!record.summaries.empty()) {
+      out << "      \"summary\": {\n";
+      for (size_t s = 0; s < record.summaries.size(); s++) {
+        writeSummary(out, "      ", record.summaries[s].first, record.summaries[s].second);
+        out << (s + 1 < record.summaries.size() ? ",\n" : "\n");
+      }
+      out << "      }";
+    }
+    out << (expanded ? "\n    }" : "}") << (i + 1 < records.size() ? ",\n" : "\n");
+  }
+  out << "  ]";
+}
+
+// Calls step(frame) for the warmup frames and then the measured ones, and
+// returns how long each measured call took
+template <typename Step>
+std::vector<double> timeFrames(const BenchOptions &options, Step &&step) {
+  std::vector<double> times;
+  times.reserve(options.frames);
+  for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+    Clock::time_point start = Clock::now();
+    step(frame);
+    double ms = elapsedMs(start, Clock::now());
+    if (frame >= options.warmup) {
+      times.push_back(ms);
+    }
+  }
+  return times;
+}
+
+// Renders warmup + measured frames of the scene described by options with a
+// fresh Renderer and returns the measured ones
+std::vector<FrameSample> runFrames(const BenchOptions &options) {
+  glstate::setEnabled(options.stateCache);
+  Renderer renderer(options.cubes, options.lights, options.submission);
+  renderer.setRenderPath(options.path);
+  renderer.setOcclusionCulling(options.occlusion);
+  renderer.setPersistentStreaming(options.persistentStreaming);
+  renderer.setSpotlight(options.spotlight);
+  renderer.setShadows(options.shadows);
+  renderer.setShadowCaching(options.shadowCache);
+  // Measure the scene itself, not the placeholder textures
+  renderer.finishLoading();
+  Camera camera;
+
+  unsigned int queries[QUERY_LATENCY];
+  glGenQueries(QUERY_LATENCY, queries);
+  GLsync fences[FRAMES_IN_FLIGHT] = {};
+
+  int totalFrames = options.warmup + options.frames;
+  std::vector<FrameSample> samples(totalFrames);
+  Clock::time_point previousStart = Clock::now();
+
+  for (int frame = 0; frame < totalFrames; frame++) {
+    profiler::beginFrame();
+    if (frame == options.warmup && !options.trace.empty()) {
+      profiler::beginCapture();
+    }
+
+    // Throttle like a swap chain would
+    GLsync &fence = fences[frame % FRAMES_IN_FLIGHT];
+    if (fence) {
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+
+    // Collect the GPU time of the frame that last used this query
+    unsigned int query = queries[frame % QUERY_LATENCY];
+    if (frame >= QUERY_LATENCY) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+      samples[frame - QUERY_LATENCY].gpuMs = elapsed / 1.0e6;
+    }
+
+    Clock::time_point start = Clock::now();
+    if (frame > 0) {
+      samples[frame - 1].frameMs = elapsedMs(previousStart, start);
+    }
+    previousStart = start;
+
+    updateCameraPath(camera, frame, options.frames);
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    uint64_t heapAllocations = memory::getHeapAllocations();
+    renderer.render(camera, options.width, options.height);
+    samples[frame].heapAllocations = memory::getHeapAllocations() - heapAllocations;
+    glEndQuery(GL_TIME_ELAPSED);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    samples[frame].cpuMs = elapsedMs(start, Clock::now());
+    const RenderStats &stats = renderer.getStats();
+    samples[frame].drawCalls = stats.drawCalls;
+    samples[frame].frustumCulled = stats.frustumCulledObjects;
+    samples[frame].occluded = stats.occludedObjects;
+    samples[frame].visible = stats.visibleObjects;
+    samples[frame].packets = stats.queue.packets;
+    samples[frame].unsortedStateChanges = stats.queue.unsortedStateChanges;
+    samples[frame].stateChanges = stats.queue.stateChanges;
+    samples[frame].glIssued = stats.glState.issued;
+    samples[frame].glFiltered = stats.glState.filtered;
+    samples[frame].streamedBytes = stats.streamedBytes;
+    samples[frame].streamWaits = stats.streamWaits;
+    std::copy(stats.shadowCascades, stats.shadowCascades + CascadedShadowMaps::CASCADE_COUNT,
+              samples[frame].shadowCascades);
+  }
+
+  // Drain the pipeline so the last frames get their GPU and frame times
+  glFinish();
+  samples[totalFrames - 1].frameMs = elapsedMs(previousStart, Clock::now());
+  for (int frame = std::max(0, totalFrames - QUERY_LATENCY); frame < totalFrames; frame++) {
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[frame % QUERY_LATENCY], GL_QUERY_RESULT, &elapsed);
+    samples[frame].gpuMs = elapsed / 1.0e6;
+  }
+  for (GLsync fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glDeleteQueries(QUERY_LATENCY, queries);
+  if (profiler::isCapturing()) {
+    profiler::endCapture(options.trace);
+  }
+
+  samples.erase(samples.begin(), samples.begin() + options.warmup);
+  return samples;
+}
+
+void runScene(std::ostream &out, const BenchOptions &options) {
+  std::vector<FrameSample> samples = runFrames(options);
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"cubes\": " << options.cubes << ",\n";
+  out << "  \"lights\": " << options.lights << ",\n";
+  out << "  \"submission\": \"" << submissionName(options.submission) << "\",\n";
+  out << "  \"path\": \"" << pathName(options.path) << "\",\n";
+  out << "  \"occlusion\": " << (options.occlusion ? "true" : "false") << ",\n";
+  out << "  \"stateCache\": " << (options.stateCache ? "true" : "false") << ",\n";
+  out << "  \"persistentStreaming\": " << (options.persistentStreaming ? "true" : "false") << ",\n";
+  out << "  \"shadows\": " << (options.shadows ? "true" : "false") << ",\n";
+  out << "  \"shadowCache\": " << (options.shadowCache ? "true" : "false") << ",\n";
+  writeRun(out, samples, "  ");
+  out << ",\n";
+  writeSamples(out, samples);
+  out << "\n}\n";
+}
+
+// Per-object vs instanced submission as the scene grows
+void runInstancing(std::ostream &out, const BenchOptions &options) {
+  const unsigned int cubeCounts[] = {10, 1000, 100000};
+  const SubmissionMode modes[] = {SubmissionMode::PerObject, SubmissionMode::Instanced};
+
+  std::vector<Record> runs;
+  for (unsigned int cubes : cubeCounts) {
+    for (SubmissionMode mode : modes) {
+      BenchOptions run = options;
+      run.cubes = cubes;
+      run.submission = mode;
+      runs.push_back(Record{}.add("cubes", cubes).add("submission", submissionName(mode)).setFrames(runFrames(run)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// setVec3 throughput: the old std::string-keyed unordered_map cache vs the
+// reflected name lookup vs a pre-resolved UniformHandle. Sets the lit
+// shader's material color, which the directional light permutation uses.
+void runUniforms(std::ostream &out, const BenchOptions &options) {
+  Shader shader(SHADER_DIR "/vertex.glsl", SHADER_DIR "/object.fragment.glsl", nullptr,
+                shaderDefines(ShaderFeature::DirLight));
+  shader.use();
+  const int calls = 1 << 20;
+
+  std::unordered_map<std::string, GLint> legacyCache;
+  auto legacySetVec3 = [&](const std::string &name, const glm::vec3 &value) {
+    auto it = legacyCache.find(name);
+    if (it == legacyCache.end()) {
+      it = legacyCache.emplace(name, glGetUniformLocation(shader.getID(), name.c_str())).first;
+    }
+    glUniform3fv(it->second, 1, &value[0]);
+  };
+  UniformHandle handle = shader.getUniform("material.diffuseColor");
+
+  std::vector<Record> runs;
+  auto measure = [&](const char *name, auto &&setVec3) {
+    double ms = 0.0;
+    // Two passes, keep the second so caches and the driver are warm
+    for (int pass = 0; pass < 2; pass++) {
+      Clock::time_point start = Clock::now();
+      for (int i = 0; i < calls; i++) {
+        setVec3(glm::vec3((float)(i & 1), 1.0f, 1.0f));
+      }
+      glFinish();
+      ms = elapsedMs(start, Clock::now());
+    }
+    runs.push_back(Record{}
+                       .add("variant", name)
+                       .add("totalMs", ms)
+                       .add("nsPerCall", ms * 1.0e6 / calls)
+                       .add("callsPerSec", calls / (ms / 1000.0)));
+  };
+
+  measure("string-map", [&](const glm::vec3 &value) { legacySetVec3("material.diffuseColor", value); });
+  measure("name-lookup", [&](const glm::vec3 &value) { shader.setVec3("material.diffuseColor", value); });
+  measure("handle", [&](const glm::vec3 &value) { shader.setVec3(handle, value); });
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"calls\": " << calls << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// CPU light binning time, single-threaded vs the whole machine, along the
+// same camera path as the frame benchmarks
+void runLights(std::ostream &out, const BenchOptions &options) {
+  const unsigned int lightCounts[] = {1000, 10000};
+  std::vector<unsigned int> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) {
+    threadCounts.push_back(std::thread::hardware_concurrency());
+  }
+  float aspectRatio = (float)options.width / (float)options.height;
+
+  std::vector<Record> runs;
+  for (unsigned int lightCount : lightCounts) {
+    // Same distribution as the Renderer's procedural fill lights
+    std::mt19937 rng(7331);
+    std::uniform_real_distribution<float> spreadX(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> spreadY(-25.0f, 25.0f);
+    std::uniform_real_distribution<float> spreadZ(-90.0f, 5.0f);
+    std::vector<PointLight> lights(lightCount);
+    for (PointLight &light : lights) {
+      light.position = glm::vec3(spreadX(rng), spreadY(rng), spreadZ(rng));
+      light.radius = pointLightRadius(1.0f, 0.7f, 1.8f, 1.0f);
+    }
+
+    for (unsigned int threads : threadCounts) {
+      ThreadPool pool(threads);
+      LightClusters clusters(&pool);
+      Camera camera;
+      double indices = 0.0;
+      std::vector<double> binMs = timeFrames(options, [&](int frame) {
+        updateCameraPath(camera, frame, options.frames);
+        clusters.build(lights, camera, aspectRatio);
+        if (frame >= options.warmup) {
+          indices += clusters.getLightIndices().size();
+        }
+      });
+      runs.push_back(Record{}
+                         .add("lights", lightCount)
+                         .add("threads", threads)
+                         .add("clusters", LightClusters::CLUSTER_COUNT)
+                         .add("meanLightIndices", indices / options.frames)
+                         .summarize("binMs", std::move(binMs)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Frustum culling of a million objects along the camera path: testing every
+// box in a plain loop vs the BVH on one thread and on the whole machine
+void runCulling(std::ostream &out, const BenchOptions &options) {
+  const size_t objectCount = 1000000;
+  float aspectRatio = (float)options.width / (float)options.height;
+
+  // Same volume as the Renderer's procedural cubes, so a large share of the
+  // objects is in view from most of the path
+  std::mt19937 rng(4242);
+  std::uniform_real_distribution<float> spreadX(-40.0f, 40.0f);
+  std::uniform_real_distribution<float> spreadY(-25.0f, 25.0f);
+  std::uniform_real_distribution<float> spreadZ(-90.0f, 5.0f);
+  std::uniform_real_distribution<float> size(0.1f, 0.5f);
+  std::vector<Aabb> bounds(objectCount);
+  for (Aabb &box : bounds) {
+    glm::vec3 center(spreadX(rng), spreadY(rng), spreadZ(rng));
+    glm::vec3 extent(size(rng), size(rng), size(rng));
+    box = Aabb{center - extent, center + extent};
+  }
+
+  Bvh bvh;
+  Clock::time_point buildStart = Clock::now();
+  bvh.build(bounds.data(), bounds.size());
+  double buildMs = elapsedMs(buildStart, Clock::now());
+
+  std::vector<unsigned int> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) {
+    threadCounts.push_back(std::thread::hardware_concurrency());
+  }
+
+  std::vector<Record> runs;
+  std::vector<uint32_t> visible;
+  auto measure = [&](const char *name, unsigned int threads, auto &&cull) {
+    Camera camera;
+    double meanVisible = 0.0;
+    std::vector<double> cullMs = timeFrames(options, [&](int frame) {
+      updateCameraPath(camera, frame, options.frames);
+      cull(extractFrustum(camera.GetViewProjectionMatrix(aspectRatio)));
+      if (frame >= options.warmup) {
+        meanVisible += visible.size();
+      }
+    });
+    runs.push_back(Record{}
+                       .add("variant", name)
+                       .add("threads", threads)
+                       .add("meanVisible", meanVisible / options.frames)
+                       .summarize("cullMs", std::move(cullMs)));
+  };
+
+  measure("linear", 1, [&](const Frustum &frustum) {
+    visible.clear();
+    for (uint32_t i = 0; i < objectCount; i++) {
+      if (frustum.intersects(bounds[i])) {
+        visible.push_back(i);
+      }
+    }
+  });
+  for (unsigned int threads : threadCounts) {
+    ThreadPool pool(threads);
+    bvh.setThreadPool(&pool);
+    measure("bvh", threads, [&](const Frustum &frustum) { bvh.cull(frustum, visible); });
+    bvh.setThreadPool(nullptr);
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"objects\": " << objectCount << ",\n";
+  out << "  \"bvhNodes\": " << bvh.getNodeCount() << ",\n";
+  out << "  \"bvhBuildMs\": " << buildMs << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// A synthetic frame on the job system at 1 to N threads. Transforms feed
+// culling, which fans out into small draw-packet jobs, while light binning
+// runs alongside; every stage is a few milliseconds of arithmetic at one
+// thread. Also measures the cost of a single empty job.
+void runJobs(std::ostream &out, const BenchOptions &options) {
+  const size_t itemCount = 1 << 16;
+  const size_t lightCount = 1 << 14;
+  const size_t packetJobs = 256;
+  const size_t emptyJobs = 100000;
+
+  std::vector<unsigned int> threadCounts;
+  unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(hardwareThreads);
+
+  // Stand-in for real per-item work, dependent on the previous stage's output
+  auto work = [](float value, int iterations) {
+    for (int i = 0; i < iterations; i++) {
+      value = std::sin(value) * 0.5f + 1.0f;
+    }
+    return value;
+  };
+
+  std::vector<Record> runs;
+  double baseMs = 0.0;
+  std::vector<float> transforms(itemCount), visibility(itemCount), packets(itemCount), lights(lightCount);
+
+  for (unsigned int threads : threadCounts) {
+    ThreadPool pool(threads);
+    std::vector<double> frameMs = timeFrames(options, [&](int frame) {
+      JobCounter transformed, frameDone;
+      pool.submit([&] {
+        pool.parallelFor(itemCount, 1024, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            transforms[i] = work((float)(i + frame), 8);
+          }
+        });
+      }, &transformed);
+      pool.submit([&] {
+        pool.parallelFor(lightCount, 256, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            lights[i] = work((float)i, 16);
+          }
+        });
+      }, &frameDone);
+      pool.submitAfter(transformed, [&] {
+        pool.parallelFor(itemCount, 1024, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            visibility[i] = work(transforms[i], 4);
+          }
+        });
+        // Counted by the frame while this job still runs, so the frame
+        // cannot finish before they are queued
+        size_t perJob = itemCount / packetJobs;
+        for (size_t job = 0; job < packetJobs; job++) {
+          pool.submit([&, job, perJob] {
+            for (size_t i = job * perJob; i < (job + 1) * perJob; i++) {
+              packets[i] = work(visibility[i], 2);
+            }
+          }, &frameDone);
+        }
+      }, &frameDone);
+      pool.wait(frameDone);
+    });
+
+    JobCounter empty;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < emptyJobs; i++) {
+      pool.submit([] {}, &empty);
+    }
+    pool.wait(empty);
+    double jobNs = elapsedMs(start, Clock::now()) * 1e6 / emptyJobs;
+
+    double meanMs = std::accumulate(frameMs.begin(), frameMs.end(), 0.0) / frameMs.size();
+    if (runs.empty()) {
+      baseMs = meanMs;
+    }
+    runs.push_back(Record{}
+                       .add("threads", threads)
+                       .add("speedup", baseMs / meanMs)
+                       .add("emptyJobNs", jobNs)
+                       .summarize("frameMs", std::move(frameMs)));
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"items\": " << itemCount << ",\n";
+  out << "  \"packetJobs\": " << packetJobs << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Transient objects allocated one at a time and all released by the end of
+// the frame, as draw packets and per-instance data would be: the default
+// heap vs a fixed-size pool vs a linear arena that is reset every frame
+void runMemory(std::ostream &out, const BenchOptions &options) {
+  const size_t objectCount = 100000;
+
+  std::vector<Record> runs;
+  std::vector<void *> objects(objectCount);
+
+  auto measure = [&](const char *allocator, const char *object, size_t size, std::pmr::memory_resource &resource,
+                     LinearArena *arena) {
+    double heapAllocations = 0.0;
+    std::vector<double> frameMs = timeFrames(options, [&](int frame) {
+      uint64_t allocationsBefore = memory::getHeapAllocations();
+      for (size_t i = 0; i < objectCount; i++) {
+        objects[i] = resource.allocate(size, alignof(std::max_align_t));
+        // Touched, as a real object would be
+        std::memset(objects[i], (int)i, size);
+      }
+      if (arena) {
+        arena->reset();
+      } else {
+        for (size_t i = 0; i < objectCount; i++) {
+          resource.deallocate(objects[i], size, alignof(std::max_align_t));
+        }
+      }
+      if (frame >= options.warmup) {
+        heapAllocations += memory::getHeapAllocations() - allocationsBefore;
+      }
+    });
+    double meanMs = std::accumulate(frameMs.begin(), frameMs.end(), 0.0) / frameMs.size();
+    runs.push_back(Record{}
+                       .add("allocator", allocator)
+                       .add("object", object)
+                       .add("bytes", size)
+                       .add("nsPerObject", meanMs * 1e6 / objectCount)
+                       .add("heapAllocationsPerFrame", heapAllocations / options.frames)
+                       .summarize("frameMs", std::move(frameMs)));
+  };
+
+  const std::pair<const char *, size_t> objectTypes[] = {{"drawPacket", sizeof(DrawPacket)},
+                                                         {"instance", sizeof(InstanceData)}};
+  for (const auto &[object, size] : objectTypes) {
+    measure("new/delete", object, size, *std::pmr::new_delete_resource(), nullptr);
+    PoolResource pool(size, 4096);
+    measure("pool", object, size, pool, nullptr);
+    LinearArena arena(objectCount * (size + alignof(std::max_align_t)));
+    measure("arena", object, size, arena, &arena);
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"objectsPerFrame\": " << objectCount << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// World matrix updates of a million-node hierarchy with 1% of the local
+// transforms changing per frame: recomputing every node vs only the changed
+// subtrees, on one thread and on the whole machine
+void runSceneGraph(std::ostream &out, const BenchOptions &options) {
+  const uint32_t nodeCount = 1000000;
+  const uint32_t rootCount = 1000;
+  const uint32_t changesPerFrame = nodeCount / 100;
+
+  std::vector<unsigned int> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) {
+    threadCounts.push_back(std::thread::hardware_concurrency());
+  }
+
+  std::vector<Record> runs;
+  size_t levels = 0;
+
+  auto measure = [&](const char *name, unsigned int threads, bool incremental) {
+    ThreadPool pool(threads);
+    SceneGraph scene(&pool);
+    scene.reserve(nodeCount);
+    // Same tree for every variant: each node hangs below a random earlier
+    // one, which makes it a few dozen levels deep
+    std::mt19937 rng(9001);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+      uint32_t parent = i < rootCount ? SceneGraph::NO_PARENT : (uint32_t)(rng() % i);
+      scene.addNode(parent, glm::vec3(offset(rng), offset(rng), offset(rng)));
+    }
+    scene.update();
+    levels = scene.getLevelCount();
+
+    double updated = 0.0;
+    const glm::vec3 axis = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+    std::vector<double> updateMs = timeFrames(options, [&](int frame) {
+      glm::quat spin = glm::angleAxis(0.01f * (float)frame, axis);
+      if (incremental) {
+        for (uint32_t i = 0; i < changesPerFrame; i++) {
+          scene.setRotation((uint32_t)(rng() % nodeCount), spin);
+        }
+      } else {
+        // Every node touched, as if nothing tracked what changed
+        for (uint32_t i = 0; i < nodeCount; i++) {
+          scene.setRotation(i, i % 100 == 0 ? spin : scene.getRotation(i));
+        }
+      }
+      scene.update();
+      if (frame >= options.warmup) {
+        updated += scene.getUpdatedCount();
+      }
+    });
+    runs.push_back(Record{}
+                       .add("variant", name)
+                       .add("threads", threads)
+                       .add("meanUpdated", updated / options.frames)
+                       .summarize("updateMs", std::move(updateMs)));
+  };
+
+  for (unsigned int threads : threadCounts) {
+    measure("full", threads, false);
+    measure("incremental", threads, true);
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"nodes\": " << nodeCount << ",\n";
+  out << "  \"levels\": " << levels << ",\n";
+  out << "  \"changesPerFrame\": " << changesPerFrame << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Frames with and without occlusion culling as the cube field gets denser,
+// so that more and more of it hides behind the cubes nearest the camera
+void runOcclusion(std::ostream &out, const BenchOptions &options) {
+  const unsigned int cubeCounts[] = {1000, 10000, 100000};
+
+  std::vector<Record> runs;
+  for (unsigned int cubes : cubeCounts) {
+    for (bool occlusion : {false, true}) {
+      BenchOptions run = options;
+      run.cubes = cubes;
+      run.occlusion = occlusion;
+      runs.push_back(Record{}.add("cubes", cubes).add("occlusion", occlusion).setFrames(runFrames(run)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"submission\": \"" << submissionName(options.submission) << "\",\n";
+  out << "  \"path\": \"" << pathName(options.path) << "\",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Frames with the GL state cache off and on, per object at high draw counts
+// where redundant binds add up
+void runStateCache(std::ostream &out, const BenchOptions &options) {
+  const unsigned int cubeCounts[] = {1000, 10000};
+
+  std::vector<Record> runs;
+  for (unsigned int cubes : cubeCounts) {
+    for (bool stateCache : {false, true}) {
+      BenchOptions run = options;
+      run.cubes = cubes;
+      run.submission = SubmissionMode::PerObject;
+      run.stateCache = stateCache;
+      runs.push_back(Record{}.add("cubes", cubes).add("stateCache", stateCache).setFrames(runFrames(run)));
+    }
+  }
+  glstate::setEnabled(options.stateCache);
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"path\": \"" << pathName(options.path) << "\",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Per-frame instance and uniform uploads through a persistently mapped ring
+// vs unsynchronized mapping with orphaning, with occlusion culling off so
+// every cube in view is streamed
+void runStreaming(std::ostream &out, const BenchOptions &options) {
+  const unsigned int cubeCounts[] = {10000, 100000};
+
+  std::vector<Record> runs;
+  for (unsigned int cubes : cubeCounts) {
+    for (bool persistent : {false, true}) {
+      BenchOptions run = options;
+      run.cubes = cubes;
+      run.submission = SubmissionMode::Instanced;
+      run.occlusion = false;
+      run.persistentStreaming = persistent;
+      runs.push_back(Record{}.add("cubes", cubes).add("persistentStreaming", persistent).setFrames(runFrames(run)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"path\": \"" << pathName(options.path) << "\",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Clustered forward vs deferred shading as the light count grows
+void runPaths(std::ostream &out, const BenchOptions &options) {
+  const unsigned int lightCounts[] = {4, 256, 1024, 4096};
+  const RenderPath paths[] = {RenderPath::Forward, RenderPath::Deferred};
+
+  std::vector<Record> runs;
+  for (unsigned int lights : lightCounts) {
+    for (RenderPath path : paths) {
+      BenchOptions run = options;
+      run.lights = lights;
+      run.path = path;
+      runs.push_back(Record{}.add("lights", lights).add("path", pathName(path)).setFrames(runFrames(run)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"cubes\": " << options.cubes << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Startup texture loading: synchronous Texture construction vs the
+// TextureLoader on one thread and on the whole machine, decoding the images
+// or going through a TextureCache that is cold (built on load) or warm. Every
+// image in textures/ is loaded several times over to stand in for a larger
+// asset set.
+void runTextures(std::ostream &out, const BenchOptions &options) {
+  const int copies = 8;
+  std::vector<std::string> paths;
+  for (const auto &entry : std::filesystem::directory_iterator("textures")) {
+    for (int i = 0; i < copies; i++) {
+      paths.push_back(entry.path().string());
+    }
+  }
+  std::vector<unsigned int> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) {
+    threadCounts.push_back(std::thread::hardware_concurrency());
+  }
+
+  // Two passes each, keep the second so the files are in the page cache
+  double syncMs = 0.0;
+  for (int pass = 0; pass < 2; pass++) {
+    Clock::time_point start = Clock::now();
+    std::vector<Texture> textures;
+    textures.reserve(paths.size());
+    for (const std::string &path : paths) {
+      textures.emplace_back(path);
+    }
+    glFinish();
+    syncMs = elapsedMs(start, Clock::now());
+  }
+  std::vector<Record> runs;
+  runs.push_back(
+      Record{}.add("loader", "synchronous").add("threads", 1).add("returnMs", syncMs).add("residentMs", syncMs));
+
+  // cache is null for plain decoding; with clearCache every pass rebuilds the
+  // cache entries, otherwise the second pass maps the ones the first wrote
+  auto measureLoader = [&](const char *name, unsigned int threads, const TextureCache *cache, bool clearCache) {
+    double returnMs = 0.0, residentMs = 0.0;
+    TextureLoaderStats stats;
+    for (int pass = 0; pass < 2; pass++) {
+      if (cache && clearCache) {
+        for (const auto &entry : std::filesystem::directory_iterator(cache->getDirectory())) {
+          std::filesystem::remove(entry.path());
+        }
+      }
+      ThreadPool pool(threads);
+      TextureLoader loader(pool, cache);
+      std::vector<std::shared_ptr<Texture>> textures;
+      Clock::time_point start = Clock::now();
+      for (const std::string &path : paths) {
+        textures.push_back(loader.load(path));
+      }
+      returnMs = elapsedMs(start, Clock::now());
+      loader.finish();
+      glFinish();
+      residentMs = elapsedMs(start, Clock::now());
+      stats = loader.getStats();
+    }
+    runs.push_back(Record{}
+                       .add("loader", name)
+                       .add("threads", threads)
+                       .add("returnMs", returnMs)
+                       .add("residentMs", residentMs)
+                       .add("resident", stats.resident)
+                       .add("bytesUploaded", stats.bytesUploaded));
+  };
+
+  for (unsigned int threads : threadCounts) {
+    measureLoader("async", threads, nullptr, false);
+  }
+  // A scratch directory so the application's own cache is left alone
+  TextureCache cache("texcache-bench");
+  for (unsigned int threads : threadCounts) {
+    measureLoader("cache-build", threads, &cache, true);
+    measureLoader("cached", threads, &cache, false);
+  }
+  std::filesystem::remove_all(cache.getDirectory());
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"textures\": " << paths.size() << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// UV sphere as a Wavefront OBJ with separate position, texcoord and normal
+// indices, the way most exported assets look
+void writeSphereObj(const std::string &path, int segments, int rings) {
+  std::ofstream file(path);
+  for (int r = 0; r <= rings; r++) {
+    float phi = 3.14159265f * r / rings;
+    for (int s = 0; s <= segments; s++) {
+      float theta = 2.0f * 3.14159265f * s / segments;
+      glm::vec3 n(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+      file << "v " << n.x << ' ' << n.y << ' ' << n.z << '\n';
+      file << "vn " << n.x << ' ' << n.y << ' ' << n.z << '\n';
+      file << "vt " << (float)s / segments << ' ' << 1.0f - (float)r / rings << '\n';
+    }
+  }
+  auto corner = [&](int r, int s) {
+    int i = r * (segments + 1) + s + 1;
+    file << ' ' << i << '/' << i << '/' << i;
+  };
+  for (int r = 0; r < rings; r++) {
+    for (int s = 0; s < segments; s++) {
+      file << 'f';
+      corner(r, s);
+      corner(r + 1, s);
+      corner(r + 1, s + 1);
+      file << "\nf";
+      corner(r, s);
+      corner(r + 1, s + 1);
+      corner(r, s + 1);
+      file << '\n';
+    }
+  }
+}
+
+// Assimp import vs loading from the binary mesh cache, cold (import plus
+// writing the entry) and warm (mapping the entry)
+void runModels(std::ostream &out, const BenchOptions &options) {
+  std::string path = options.model;
+  bool generated = path.empty();
+  if (generated) {
+    path = (std::filesystem::temp_directory_path() / "OpenGL-Learn-Bench-sphere.obj").string();
+    writeSphereObj(path, 1024, 512);
+  }
+  const std::string cacheDirectory = "meshcache-bench";
+
+  std::vector<Record> runs;
+  size_t vertices = 0, indices = 0, meshes = 0;
+  ThreadPool pool;
+
+  // Two passes, keep the second so the source file is in the page cache.
+  // Without a pool, meshes are optimized and simplified on this thread.
+  auto measure = [&](const char *name, const std::string &cache, bool clearCache, ThreadPool *loadPool) {
+    double ms = 0.0;
+    bool fromCache = false;
+    for (int pass = 0; pass < 2; pass++) {
+      if (clearCache) {
+        std::filesystem::remove_all(cacheDirectory);
+      }
+      Clock::time_point start = Clock::now();
+      Model model(path, cache, loadPool);
+      glFinish();
+      ms = elapsedMs(start, Clock::now());
+      fromCache = model.isFromCache();
+      vertices = model.getVertexCount();
+      indices = model.getIndexCount();
+      meshes = model.getMeshes().size();
+    }
+    runs.push_back(Record{}
+                       .add("variant", name)
+                       .add("threads", loadPool ? loadPool->getThreadCount() : 1u)
+                       .add("loadMs", ms)
+                       .add("fromCache", fromCache));
+  };
+  measure("import", "", false, nullptr);
+  measure("import", "", false, &pool);
+  measure("cache-build", cacheDirectory, true, &pool);
+  measure("cached", cacheDirectory, false, &pool);
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"model\": \"" << (generated ? "generated sphere" : path) << "\",\n";
+  out << "  \"meshes\": " << meshes << ",\n";
+  out << "  \"vertices\": " << vertices << ",\n";
+  out << "  \"triangles\": " << indices / 3 << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+
+  std::filesystem::remove_all(cacheDirectory);
+  if (generated) {
+    std::filesystem::remove(path);
+  }
+}
+
+// Creating the programs the renderer builds at startup for the scene in
+// options from source: the unlit, light volume and depth programs, and the
+// lit permutations selectShaders() activates for its lights and the cube
+// material. Once without a cache, then through a cold shader cache (shared
+// stages, binaries written out) and through a warm one (binaries loaded).
+// Drivers with a shader cache of their own narrow the gap between the first
+// two.
+void runShaders(std::ostream &out, const BenchOptions &options) {
+  const char *programs[][2] = {
+      {SHADER_DIR "/vertex.glsl", SHADER_DIR "/light.fragment.glsl"},
+      {SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/light.fragment.glsl"},
+      {SHADER_DIR "/lightvolume.vertex.glsl", SHADER_DIR "/lightvolume.fragment.glsl"},
+      {SHADER_DIR "/vertex.glsl", SHADER_DIR "/depth.fragment.glsl"},
+      {SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/depth.fragment.glsl"}};
+  // Same masks as Renderer::getLightingFeatures() and the cube material
+  uint32_t lightingFeatures = ShaderFeature::DirLight | (options.shadows ? ShaderFeature::DirShadow : 0u) |
+                              (options.lights > 0 ? ShaderFeature::PointLights : 0u) |
+                              (options.spotlight ? ShaderFeature::SpotLight : 0u);
+  uint32_t objectFeatures = lightingFeatures | ShaderFeature::DiffuseMap | ShaderFeature::SpecularMap;
+  const uint32_t gbufferUsed = ShaderFeature::DiffuseMap | ShaderFeature::SpecularMap | ShaderFeature::NormalMap;
+  const uint32_t deferredUsed = ShaderFeature::DirLight | ShaderFeature::DirShadow | ShaderFeature::SpotLight;
+  struct Permutation {
+    const char *vertexPath;
+    const char *fragmentPath;
+    uint32_t usedFeatures;
+    uint32_t features;
+  };
+  const Permutation permutations[] = {
+      {SHADER_DIR "/vertex.glsl", SHADER_DIR "/object.fragment.glsl", ShaderFeature::All, objectFeatures},
+      {SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/object.fragment.glsl", ShaderFeature::All, objectFeatures},
+      {SHADER_DIR "/vertex.glsl", SHADER_DIR "/gbuffer.fragment.glsl", gbufferUsed, objectFeatures},
+      {SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/gbuffer.fragment.glsl", gbufferUsed, objectFeatures},
+      {SHADER_DIR "/deferred.vertex.glsl", SHADER_DIR "/deferred.fragment.glsl", deferredUsed, lightingFeatures}};
+  const unsigned int programCount = (unsigned int)(std::size(programs) + std::size(permutations));
+  const std::string cacheDirectory = "shadercache-bench";
+  std::filesystem::remove_all(cacheDirectory);
+
+  std::vector<Record> runs;
+  bool binarySupported = false;
+  auto measure = [&](const char *name, bool useCache) {
+    std::unique_ptr<ShaderCache> cache;
+    Clock::time_point start = Clock::now();
+    if (useCache) {
+      cache = std::make_unique<ShaderCache>(cacheDirectory);
+      binarySupported = cache->isBinarySupported();
+    }
+    std::vector<Shader> shaders;
+    shaders.reserve(std::size(programs));
+    for (const auto &program : programs) {
+      shaders.emplace_back(program[0], program[1], cache.get());
+    }
+    // Started together, then taken, as selectShaders() does
+    std::vector<std::unique_ptr<ShaderVariants>> variants;
+    for (const Permutation &permutation : permutations) {
+      variants.push_back(std::make_unique<ShaderVariants>(permutation.vertexPath, permutation.fragmentPath,
+                                                          cache.get(), permutation.usedFeatures));
+      variants.back()->prepare(permutation.features);
+    }
+    for (size_t i = 0; i < variants.size(); i++) {
+      variants[i]->get(permutations[i].features);
+    }
+    if (cache) {
+      cache->releaseStages();
+    }
+    glFinish();
+    double ms = elapsedMs(start, Clock::now());
+
+    ShaderCacheStats stats = cache ? cache->getStats() : ShaderCacheStats{};
+    runs.push_back(Record{}
+                       .add("variant", name)
+                       .add("loadMs", ms)
+                       .add("binaryHits", stats.binaryHits)
+                       .add("stagesCompiled", cache ? stats.stagesCompiled : 2 * programCount)
+                       .add("stagesShared", stats.stagesShared));
+  };
+  measure("source", false);
+  measure("cache-build", true);
+  measure("cached", true);
+  std::filesystem::remove_all(cacheDirectory);
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"programs\": " << programCount << ",\n";
+  // ShaderFeature masks of the lit permutations
+  out << "  \"objectFeatures\": " << objectFeatures << ",\n";
+  out << "  \"lightingFeatures\": " << lightingFeatures << ",\n";
+  writeRecords(out, "runs", runs);
+  out << ",\n";
+  out << "  \"binarySupported\": " << (binarySupported ? "true" : "false") << "\n}\n";
+}
+
+// Building every permutation of the forward object shader, one at a time
+// and all started before the first is waited on, which lets drivers with
+// parallel shader compile work on them side by side. Binaries stay off disk
+// so each run compiles from source. Then frame times with the spotlight
+// permutation off and on.
+void runVariants(std::ostream &out, const BenchOptions &options) {
+  const uint32_t permutations = ShaderFeature::All + 1;
+
+  std::vector<Record> builds;
+  auto measure = [&](const char *name, bool batched) {
+    ShaderCache cache("");
+    ShaderVariants variants(SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/object.fragment.glsl", &cache);
+    Clock::time_point start = Clock::now();
+    if (batched) {
+      for (uint32_t features = 0; features < permutations; features++) {
+        variants.prepare(features);
+      }
+    }
+    for (uint32_t features = 0; features < permutations; features++) {
+      variants.get(features);
+    }
+    cache.releaseStages();
+    glFinish();
+    double ms = elapsedMs(start, Clock::now());
+    builds.push_back(
+        Record{}.add("variant", name).add("buildMs", ms).add("stagesCompiled", cache.getStats().stagesCompiled));
+  };
+  measure("one-by-one", false);
+  measure("batched", true);
+
+  std::vector<Record> runs;
+  for (bool spotlight : {false, true}) {
+    BenchOptions run = options;
+    run.spotlight = spotlight;
+    runs.push_back(Record{}.add("spotlight", spotlight).setFrames(runFrames(run)));
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"permutations\": " << permutations << ",\n";
+  out << "  \"parallelCompile\": " << (glext::maxShaderCompilerThreads ? "true" : "false") << ",\n";
+  writeRecords(out, "builds", builds);
+  out << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Time to draw meshes draws times over into the framebuffer with identity
+// view and model matrices, so the vertex work dominates. The meshes should
+// lie roughly within [-2, 2]. Measured from an idle GPU to glFinish, which
+// some software rasterizers report more reliably than timer queries.
+double drawMeshesMs(const std::vector<Mesh> &meshes, int draws) {
+  Shader shader(SHADER_DIR "/vertex.glsl", SHADER_DIR "/light.fragment.glsl");
+  shader.bindUniformBlock("Camera", CAMERA_BINDING);
+  CameraBlock cameraBlock{glm::mat4(1.0f), glm::mat4(0.5f), glm::vec3(0.0f), 0.0f};
+  cameraBlock.projection[3][3] = 1.0f;
+  UniformBuffer cameraUniforms(&cameraBlock, sizeof(cameraBlock));
+  cameraUniforms.bindBase(CAMERA_BINDING);
+  shader.use();
+  shader.setMat3("normalMatrix", glm::mat3(1.0f));
+  UniformHandle model = shader.getUniform("model");
+  UniformHandle octahedralNormals = shader.getUniform("octahedralNormals");
+
+  double ms = 0.0;
+  // Two passes, keep the second so the buffers are resident
+  for (int pass = 0; pass < 2; pass++) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < draws; i++) {
+      for (const Mesh &mesh : meshes) {
+        shader.setMat4(model, mesh.getEncoding().getPositionTransform());
+        shader.setBool(octahedralNormals, mesh.getEncoding().format.normal == NormalEncoding::Octahedral);
+        mesh.draw();
+      }
+    }
+    glFinish();
+    ms = elapsedMs(start, Clock::now());
+  }
+  return ms;
+}
+
+// Vertex cache simulation and draw time of the same meshes before and
+// after optimizeMeshes(), plus the optimization time itself on one thread vs
+// the whole machine. The generated sphere has its triangles shuffled, like an
+// exporter that does not care about draw order.
+void runMeshOpt(std::ostream &out, const BenchOptions &options) {
+  std::string path = options.model;
+  bool generated = path.empty();
+  if (generated) {
+    path = (std::filesystem::temp_directory_path() / "OpenGL-Learn-Bench-sphere.obj").string();
+    writeSphereObj(path, 256, 128);
+  }
+  std::vector<MeshData> source;
+  if (!Model::import(path, source)) {
+    return;
+  }
+  if (generated) {
+    std::filesystem::remove(path);
+    std::mt19937 rng(1234);
+    for (MeshData &mesh : source) {
+      std::vector<uint32_t> order(mesh.indices.size() / 3);
+      std::iota(order.begin(), order.end(), 0);
+      std::shuffle(order.begin(), order.end(), rng);
+      std::vector<uint32_t> shuffled;
+      shuffled.reserve(mesh.indices.size());
+      for (uint32_t triangle : order) {
+        shuffled.insert(shuffled.end(), mesh.indices.begin() + triangle * 3, mesh.indices.begin() + triangle * 3 + 3);
+      }
+      mesh.indices = std::move(shuffled);
+    }
+  }
+
+  std::vector<MeshData> optimized = source;
+  std::vector<MeshOptimizationStats> stats = optimizeMeshes(optimized, nullptr);
+
+  const int draws = 50;
+  auto drawMs = [&](const std::vector<MeshData> &data) {
+    std::vector<Mesh> meshes;
+    meshes.reserve(data.size());
+    for (const MeshData &mesh : data) {
+      meshes.emplace_back(mesh);
+    }
+    return drawMeshesMs(meshes, draws);
+  };
+  double beforeMs = drawMs(source);
+  double afterMs = drawMs(optimized);
+
+  // Optimization throughput over many copies of the meshes
+  std::vector<unsigned int> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) {
+    threadCounts.push_back(std::thread::hardware_concurrency());
+  }
+  const size_t copies = 32;
+  std::vector<Record> optimize;
+  for (unsigned int threads : threadCounts) {
+    ThreadPool pool(threads);
+    std::vector<MeshData> batch;
+    batch.reserve(source.size() * copies);
+    for (size_t i = 0; i < copies; i++) {
+      batch.insert(batch.end(), source.begin(), source.end());
+    }
+    Clock::time_point start = Clock::now();
+    optimizeMeshes(batch, &pool);
+    double ms = elapsedMs(start, Clock::now());
+    optimize.push_back(Record{}.add("threads", threads).add("meshes", batch.size()).add("ms", ms));
+  }
+
+  std::vector<Record> meshes;
+  for (const MeshOptimizationStats &mesh : stats) {
+    meshes.push_back(Record{}
+                         .add("vertices", mesh.vertices)
+                         .add("triangles", mesh.triangles)
+                         .add("acmrBefore", mesh.before.acmr)
+                         .add("acmrAfter", mesh.after.acmr)
+                         .add("atvrBefore", mesh.before.atvr)
+                         .add("atvrAfter", mesh.after.atvr));
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"model\": \"" << (generated ? "generated sphere, shuffled" : path) << "\",\n";
+  out << "  \"cacheSize\": " << VERTEX_CACHE_SIZE << ",\n";
+  writeRecords(out, "meshes", meshes);
+  out << ",\n";
+  out << "  \"draws\": " << draws << ",\n";
+  out << "  \"drawMsBefore\": " << beforeMs << ",\n";
+  out << "  \"drawMsAfter\": " << afterMs << ",\n";
+  writeRecords(out, "optimize", optimize);
+  out << "\n}\n";
+}
+
+// Level of detail chains of a model: every level's triangles and error, the
+// simplification time on one thread and on all of them, then the model in
+// the scene seen from further and further away, with level selection on and
+// off
+void runLod(std::ostream &out, const BenchOptions &options) {
+  std::string path = options.model;
+  bool generated = path.empty();
+  if (generated) {
+    path = (std::filesystem::temp_directory_path() / "OpenGL-Learn-Bench-sphere.obj").string();
+    writeSphereObj(path, 512, 256);
+  }
+  std::vector<MeshData> source;
+  bool imported = Model::import(path, source);
+  if (!imported) {
+    if (generated) {
+      std::filesystem::remove(path);
+    }
+    return;
+  }
+  optimizeMeshes(source, nullptr);
+
+  std::vector<unsigned int> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) {
+    threadCounts.push_back(std::thread::hardware_concurrency());
+  }
+  std::vector<Record> simplify;
+  for (unsigned int threads : threadCounts) {
+    ThreadPool pool(threads);
+    Clock::time_point start = Clock::now();
+    generateMeshLods(source, &pool);
+    double ms = elapsedMs(start, Clock::now());
+    simplify.push_back(Record{}.add("threads", threads).add("meshes", source.size()).add("ms", ms));
+  }
+
+  ThreadPool pool;
+  Clock::time_point loadStart = Clock::now();
+  Model model(path, "", &pool);
+  glFinish();
+  double loadMs = elapsedMs(loadStart, Clock::now());
+  if (generated) {
+    std::filesystem::remove(path);
+  }
+
+  // Scaled to a unit bounding sphere in front of the cube field, so the
+  // distances mean the same for any model
+  Aabb bounds = {glm::vec3(0.0f), glm::vec3(0.0f)};
+  for (size_t m = 0; m < model.getMeshes().size(); m++) {
+    bounds.min = m == 0 ? model.getBounds(m).min : glm::min(bounds.min, model.getBounds(m).min);
+    bounds.max = m == 0 ? model.getBounds(m).max : glm::max(bounds.max, model.getBounds(m).max);
+  }
+  float radius = std::max(glm::length(bounds.max - bounds.min) * 0.5f, 1e-6f);
+  glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / radius)) *
+                        glm::translate(glm::mat4(1.0f), -(bounds.min + bounds.max) * 0.5f);
+
+  Renderer renderer(options.cubes, options.lights, options.submission);
+  renderer.setModel(&model, transform);
+  renderer.finishLoading();
+  Camera camera;
+
+  std::vector<Record> runs;
+  const float distances[] = {2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f};
+  for (float distance : distances) {
+    for (bool lod : {true, false}) {
+      renderer.setLodEnabled(lod);
+      camera.Position = glm::vec3(0.0f, 0.0f, distance);
+      camera.LookAt(glm::vec3(0.0f));
+      double triangles = 0.0, fullDetailTriangles = 0.0;
+      std::vector<double> frameMs = timeFrames(options, [&](int frame) {
+        renderer.render(camera, options.width, options.height);
+        glFinish();
+        if (frame >= options.warmup) {
+          triangles += renderer.getStats().triangles;
+          fullDetailTriangles += renderer.getStats().fullDetailTriangles;
+        }
+      });
+      runs.push_back(Record{}
+                         .add("distance", distance)
+                         .add("lod", lod)
+                         .add("triangles", triangles / options.frames)
+                         .add("fullDetailTriangles", fullDetailTriangles / options.frames)
+                         .summarize("frameMs", std::move(frameMs)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"model\": \"" << (generated ? "generated sphere" : path) << "\",\n";
+  out << "  \"loadMs\": " << loadMs << ",\n";
+  writeRecords(out, "simplify", simplify);
+  out << ",\n";
+  // Errors relative to the mesh's bounding sphere radius
+  out << "  \"meshes\": [\n";
+  for (size_t m = 0; m < model.getMeshes().size(); m++) {
+    const Aabb &meshBounds = model.getBounds(m);
+    float meshRadius = std::max(glm::length(meshBounds.max - meshBounds.min) * 0.5f, 1e-6f);
+    out << "    {\"levels\": [";
+    for (unsigned int level = 0; level < model.getLodCount(m); level++) {
+      out << (level > 0 ? ", " : "") << "{\"triangles\": " << model.getLod(m, level).getIndexCount() / 3
+          << ", \"error\": " << model.getLodErrors(m)[level] / meshRadius << "}";
+    }
+    out << "]}" << (m + 1 < model.getMeshes().size() ? ",\n" : "\n");
+  }
+  out << "  ],\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Frames without shadows, with every cascade drawn every frame, and with
+// cascade caching, along with what each cascade cost
+void runShadows(std::ostream &out, const BenchOptions &options) {
+  const unsigned int cubeCounts[] = {1000, 10000};
+  // Shadows, and whether cascades are cached
+  const std::pair<bool, bool> settings[] = {{false, false}, {true, false}, {true, true}};
+
+  std::vector<Record> runs;
+  for (unsigned int cubes : cubeCounts) {
+    for (const auto &[shadows, cache] : settings) {
+      BenchOptions run = options;
+      run.cubes = cubes;
+      run.shadows = shadows;
+      run.shadowCache = cache;
+      runs.push_back(
+          Record{}.add("cubes", cubes).add("shadows", shadows).add("shadowCache", cache).setFrames(runFrames(run)));
+    }
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"submission\": \"" << submissionName(options.submission) << "\",\n";
+  out << "  \"path\": \"" << pathName(options.path) << "\",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+// Memory, precision and draw time of the same optimized meshes in the float
+// vertex layout and the quantized ones
+void runVertexFormats(std::ostream &out, const BenchOptions &options) {
+  std::string path = options.model;
+  bool generated = path.empty();
+  if (generated) {
+    path = (std::filesystem::temp_directory_path() / "OpenGL-Learn-Bench-sphere.obj").string();
+    writeSphereObj(path, 1024, 512);
+  }
+  std::vector<MeshData> source;
+  bool imported = Model::import(path, source);
+  if (generated) {
+    std::filesystem::remove(path);
+  }
+  if (!imported) {
+    return;
+  }
+  optimizeMeshes(source, nullptr);
+
+  const std::pair<const char *, VertexFormat> formats[] = {
+      {"float", FLOAT_VERTEX_FORMAT},
+      {"half", {PositionEncoding::Half, NormalEncoding::Octahedral, TexCoordEncoding::Half}},
+      {"compact", COMPACT_VERTEX_FORMAT},
+  };
+
+  const int draws = 20;
+  size_t vertexCount = 0;
+  for (const MeshData &mesh : source) {
+    vertexCount += mesh.vertices.size();
+  }
+  std::vector<Record> runs;
+  for (const auto &[name, format] : formats) {
+    size_t vertexBytes = 0, indexBytes = 0;
+    double encodeMs = 0.0;
+    float positionError = 0.0f; // relative to the largest bounding box extent
+    float normalErrorDegrees = 0.0f;
+    float texCoordError = 0.0f;
+    std::vector<Mesh> meshes;
+    for (const MeshData &mesh : source) {
+      std::vector<uint8_t> encoded;
+      VertexEncoding encoding;
+      // Two passes, keep the second so the allocation is warm
+      for (int pass = 0; pass < 2; pass++) {
+        Clock::time_point start = Clock::now();
+        encoding = encodeVertices(mesh.vertices.data(), mesh.vertices.size(), format, encoded);
+        double ms = elapsedMs(start, Clock::now());
+        if (pass == 1) {
+          encodeMs += ms;
+        }
+      }
+
+      std::vector<MeshVertex> decoded(mesh.vertices.size());
+      decodeVertices(encoded.data(), decoded.size(), encoding, decoded.data());
+      glm::vec3 extent = encoding.positionScale * 2.0f;
+      float size = std::max({extent.x, extent.y, extent.z});
+      for (size_t i = 0; i < decoded.size(); i++) {
+        const MeshVertex &a = mesh.vertices[i];
+        const MeshVertex &b = decoded[i];
+        glm::vec3 positionDelta = glm::abs(a.position - b.position);
+        positionError = std::max(positionError, std::max({positionDelta.x, positionDelta.y, positionDelta.z}) / size);
+        float length = glm::length(a.normal);
+        if (length > 0.0f) {
+          float cosine = std::clamp(glm::dot(a.normal / length, b.normal), -1.0f, 1.0f);
+          normalErrorDegrees = std::max(normalErrorDegrees, glm::degrees(std::acos(cosine)));
+        }
+        glm::vec2 texCoordDelta = glm::abs(a.texCoords - b.texCoords);
+        texCoordError = std::max({texCoordError, texCoordDelta.x, texCoordDelta.y});
+      }
+
+      meshes.emplace_back(encoded.data(), mesh.vertices.size(), encoding, mesh.indices.data(), mesh.indices.size());
+      vertexBytes += encoded.size();
+      indexBytes += mesh.indices.size() * sizeof(uint32_t);
+    }
+    double drawMs = drawMeshesMs(meshes, draws);
+    runs.push_back(Record{}
+                       .add("format", name)
+                       .add("bytesPerVertex", format.getStride())
+                       .add("vertexBytes", vertexBytes)
+                       .add("indexBytes", indexBytes)
+                       .add("vertexMBPerDraw", vertexBytes / 1.0e6)
+                       .add("encodeMs", encodeMs)
+                       .add("encodeMVertsPerSec", vertexCount / (encodeMs * 1000.0))
+                       .add("drawMs", drawMs)
+                       .add("maxPositionError", positionError)
+                       .add("maxNormalErrorDeg", normalErrorDegrees)
+                       .add("maxTexCoordError", texCoordError));
+  }
+
+  out << "{\n";
+  writeHeader(out, options);
+  out << "  \"model\": \"" << (generated ? "generated sphere" : path) << "\",\n";
+  out << "  \"meshes\": " << source.size() << ",\n";
+  out << "  \"vertices\": " << vertexCount << ",\n";
+  out << "  \"draws\": " << draws << ",\n";
+  writeRecords(out, "runs", runs);
+  out << "\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchOptions options;
+  if (!parseArgs(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--frames N] [--warmup N] [--width W] [--height H] [--cubes N] [--lights N]"
+              << " [--submission per-object|instanced] [--path forward|deferred] [--occlusion on|off]"
+              << " [--state-cache on|off] [--stream persistent|orphan] [--spotlight on|off]"
+              << " [--shadows on|off] [--shadow-cache on|off]"
+              << " [--scenario scene|instancing|uniforms|lights|culling|occlusion|scenegraph|jobs|memory|"
+              << "statecache|streaming|paths|textures|models|shaders|variants|meshopt|vertexformat|lod|shadows]"
+              << " [--model file] [--output file.json] [--trace file.json]" << std::endl;
+    return -1;
+  }
+
+  HeadlessContext context;
+  if (!context.isValid()) {
+    return -1;
+  }
+  profiler::setThreadName("Main");
+
+  Framebuffer framebuffer(options.width, options.height);
+  if (!framebuffer.isComplete()) {
+    return -1;
+  }
+  glViewport(0, 0, options.width, options.height);
+  glEnable(GL_DEPTH_TEST);
+
+  std::ofstream file;
+  if (!options.output.empty()) {
+    file.open(options.output);
+    if (!file) {
+      std::cerr << "ERROR::BENCH::CANNOT_WRITE: " << options.output << std::endl;
+      return -1;
+    }
+  }
+  std::ostream &out = options.output.empty() ? std::cout : file;
+
+  if (options.scenario == "scene") {
+    runScene(out, options);
+  } else if (options.scenario == "instancing") {
+    runInstancing(out, options);
+  } else if (options.scenario == "uniforms") {
+    runUniforms(out, options);
+  } else if (options.scenario == "lights") {
+    runLights(out, options);
+  } else if (options.scenario == "culling") {
+    runCulling(out, options);
+  } else if (options.scenario == "occlusion") {
+    runOcclusion(out, options);
+  } else if (options.scenario == "scenegraph") {
+    runSceneGraph(out, options);
+  } else if (options.scenario == "jobs") {
+    runJobs(out, options);
+  } else if (options.scenario == "memory") {
+    runMemory(out, options);
+  } else if (options.scenario == "statecache") {
+    runStateCache(out, options);
+  } else if (options.scenario == "streaming") {
+    runStreaming(out, options);
+  } else if (options.scenario == "paths") {
+    runPaths(out, options);
+  } else if (options.scenario == "textures") {
+    runTextures(out, options);
+  } else if (options.scenario == "models") {
+    runModels(out, options);
+  } else if (options.scenario == "shaders") {
+    runShaders(out, options);
+  } else if (options.scenario == "variants") {
+    runVariants(out, options);
+  } else if (options.scenario == "meshopt") {
+    runMeshOpt(out, options);
+  } else if (options.scenario == "vertexformat") {
+    runVertexFormats(out, options);
+  } else if (options.scenario == "lod") {
+    runLod(out, options);
+  } else if (options.scenario == "shadows") {
+    runShadows(out, options);
+  } else {
+    std::cerr << "Unknown scenario: " << options.scenario << std::endl;
+    return -1;
+  }
+  profiler::shutdown();
+  return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Block compressed texture formats, encoded on the CPU in 4x4 texel blocks.
+// The values are stored in texture cache files, so do not renumber them.
+enum class BlockFormat : uint32_t {
+    None = 0, // uncompressed, tightly packed rows
+    BC1 = 1,  // RGB, 8 bytes per block (DXT1, EXT_texture_compression_s3tc)
+    BC3 = 3,  // RGBA, 16 bytes per block (DXT5, EXT_texture_compression_s3tc)
+    BC5 = 5   // RG, 16 bytes per block (RGTC2, core since GL 3.0)
+};
+
+// Bytes needed for a width x height image; partial blocks at the right and
+// bottom edges still take a whole block. channels only matters for None.
+size_t blockCompressedSize(BlockFormat format, int width, int height, int channels);
+
+// Encodes tightly packed 1-4 channel pixels into out, which must hold
+// blockCompressedSize() bytes. Missing channels read as 0, missing alpha as
+// 255; texels past the image edge repeat the last row or column.
+void compressBlocks(BlockFormat format, const unsigned char* pixels, int width, int height, int channels,
+                    unsigned char* out);
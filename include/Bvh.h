@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Frustum.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Four children of a Bvh node, boxes in structure-of-arrays form
+struct alignas(16) BvhNode {
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    int32_t child[4];  // node index, or -1 for a single object
+    uint32_t first[4]; // range in the object order below each child; count 0
+    uint32_t count[4]; // marks an unused child
+};
+
+// Static 4-wide bounding volume hierarchy over object bounds, for frustum
+// culling. Every node holds the boxes of its four children in
+// structure-of-arrays form, so one SSE pass per plane classifies all four
+// against the frustum. A child is either another node or a single object;
+// children entirely inside the frustum emit their whole object range without
+// being traversed further.
+class Bvh {
+private:
+    ThreadPool* pool;
+    std::vector<BvhNode> nodes;
+    // Objects in tree order, so every subtree covers a contiguous range
+    std::vector<uint32_t> objectOrder;
+    // Scratch of the parallel traversal, kept to avoid reallocating
+    std::vector<uint32_t> frontier;
+    std::vector<uint32_t> nextFrontier;
+    std::vector<std::vector<uint32_t>> taskVisible;
+    std::vector<std::vector<uint32_t>> taskStacks;
+
+public:
+    // pool may be null, in which case culling runs on the calling thread
+    explicit Bvh(ThreadPool* pool = nullptr);
+
+    void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+
+    // Rebuilds over count boxes; object i is reported by cull() as index i
+    void build(const Aabb* bounds, size_t count);
+
+    // Replaces visible with the indices of every object whose box touches
+    // the frustum, in no particular order
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible);
+
+    size_t getObjectCount() const { return objectOrder.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+};
@@ -16,6 +16,8 @@ const float PITCH       =  0.0f;
 const float SPEED       =  2.5f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  45.0f;
+const float NEAR_PLANE  =  0.1f;
+const float FAR_PLANE   =  100.0f;
 
 class Camera {
 public:
@@ -42,11 +44,12 @@ public:
            float yaw, float pitch);
 
     glm::mat4 GetViewMatrix() const;
-    glm::mat4 GetProjectionMatrix(float aspectRatio, float nearPlane = 0.1f, float farPlane = 100.0f) const;
-    glm::mat4 GetViewProjectionMatrix(float aspectRatio, float nearPlane = 0.1f, float farPlane = 100.0f) const;
+    glm::mat4 GetProjectionMatrix(float aspectRatio, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE) const;
+    glm::mat4 GetViewProjectionMatrix(float aspectRatio, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE) const;
     void ProcessKeyboard(Camera_Movement direction, float deltaTime);
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true);
     void ProcessMouseScroll(float yoffset);
+    void LookAt(const glm::vec3& target);
 
 private:
     void updateCameraVectors();
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Offscreen render target with an RGBA8 color and a 24-bit depth attachment.
+class Framebuffer {
+private:
+    unsigned int ID;
+    unsigned int colorRbo;
+    unsigned int depthRbo;
+    int width, height;
+
+    void release();
+
+public:
+    Framebuffer(int width, int height);
+    ~Framebuffer();
+
+    // Rule of 5 - prevent copying, allow moving
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+    Framebuffer(Framebuffer&& other) noexcept;
+    Framebuffer& operator=(Framebuffer&& other) noexcept;
+
+    void bind() const;
+    void unbind() const;
+    bool isComplete() const;
+    unsigned int getID() const { return ID; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// World-space bounds of a box transformed by an affine matrix
+Aabb transformAabb(const Aabb& box, const glm::mat4& transform);
+
+// View frustum as six inward-facing planes (xyz = unit normal, w = distance),
+// in the order left, right, bottom, top, near, far
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Conservative: boxes straddling a plane corner may pass
+    bool intersects(const Aabb& box) const;
+};
+
+// Gribb/Hartmann plane extraction from a view-projection matrix with GL clip
+// space (-w <= x, y, z <= w), e.g. Camera::GetViewProjectionMatrix()
+Frustum extractFrustum(const glm::mat4& viewProjection);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Geometry buffer for deferred shading: world-space position, normal,
+// albedo + specular intensity and depth, each in its own texture so the
+// lighting passes can read them back per pixel.
+class GBuffer {
+public:
+    // Texture units the lighting shaders expect the attachments on
+    enum Slot : unsigned int {
+        POSITION_SLOT = 5,
+        NORMAL_SLOT = 6,
+        ALBEDO_SPEC_SLOT = 7,
+        DEPTH_SLOT = 8
+    };
+
+private:
+    unsigned int ID;
+    unsigned int positionTex;
+    unsigned int normalTex;
+    unsigned int albedoSpecTex;
+    unsigned int depthTex;
+    int width, height;
+
+    void release();
+
+public:
+    GBuffer(int width, int height);
+    ~GBuffer();
+
+    // Rule of 5 - prevent copying, allow moving
+    GBuffer(const GBuffer&) = delete;
+    GBuffer& operator=(const GBuffer&) = delete;
+    GBuffer(GBuffer&& other) noexcept;
+    GBuffer& operator=(GBuffer&& other) noexcept;
+
+    void bind() const;
+    // Binds every attachment to its Slot for the lighting passes
+    void bindTextures() const;
+    bool isComplete() const;
+    unsigned int getID() const { return ID; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
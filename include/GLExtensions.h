@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Tokens past the GL 3.3 core the glad loader was generated for
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Optional entry points newer than GL 3.3, used when the context has them.
+// load() fills in the ones the context supports, by version or extension;
+// the others stay null.
+namespace glext {
+
+typedef void(APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void(APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat,
+                                             void* binary);
+typedef void(APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void(APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+// Call once the context is current, after gladLoadGLLoader, with the same
+// loader
+void load(GLADloadproc loader);
+
+// Whether the current context lists the extension
+bool hasExtension(const char* name);
+// Whether the current context is at least that version
+bool hasVersion(int major, int minor);
+
+// GL 4.4 or ARB_buffer_storage
+extern BufferStorageProc bufferStorage;
+// GL 4.1 or ARB_get_program_binary; all three or none
+extern GetProgramBinaryProc getProgramBinary;
+extern ProgramBinaryProc programBinary;
+extern ProgramParameteriProc programParameteri;
+// KHR_parallel_shader_compile or ARB_parallel_shader_compile. When set,
+// compiles and links run on driver threads and GL_COMPLETION_STATUS_KHR can
+// be queried without waiting for them.
+extern MaxShaderCompilerThreadsProc maxShaderCompilerThreads;
+
+} // namespace glext
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Calls issued to and filtered out before the driver since the last reset
+struct GLStateCounters {
+    unsigned int issued = 0;
+    unsigned int filtered = 0;
+};
+
+// Shadow copy of the context's bindings: program, active texture unit,
+// per-unit 2D and buffer textures, the array, element, uniform, texture and
+// pixel unpack buffers, vertex array and framebuffer. Binding what is already
+// bound returns without a GL call. The wrapper classes route every bind and
+// delete through here; GL code that changes bindings behind its back must
+// call invalidate() afterwards.
+//
+// GL state belongs to the context, so this does too: one current context,
+// used from one thread.
+namespace glstate {
+
+void useProgram(GLuint program);
+void activeTexture(unsigned int unit);
+// Binds to the active unit
+void bindTexture(GLenum target, GLuint texture);
+// Makes unit active first, if it is not bound there already
+void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+// GL_ELEMENT_ARRAY_BUFFER is tracked for the bound vertex array only
+void bindBuffer(GLenum target, GLuint buffer);
+// Indexed bindings are always issued; they also replace the generic binding
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void bindVertexArray(GLuint vertexArray);
+// Binds GL_FRAMEBUFFER, i.e. both the draw and the read framebuffer
+void bindFramebuffer(GLuint framebuffer);
+// Current draw framebuffer, asked from GL only if unknown
+GLuint getFramebuffer();
+
+// Deleting a bound object unbinds it, which the cache has to follow
+void deleteProgram(GLuint program);
+void deleteTextures(GLsizei count, const GLuint* textures);
+void deleteBuffers(GLsizei count, const GLuint* buffers);
+void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+void deleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+// Forgets every binding, so the next bind of each is issued
+void invalidate();
+// Disabled, every call is issued (and counted); for measuring the cache
+void setEnabled(bool enabled);
+bool isEnabled();
+
+const GLStateCounters& getCounters();
+void resetCounters();
+
+} // namespace glstate
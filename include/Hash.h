@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// FNV-1a hashes. constexpr so names known at compile time hash for free.
+constexpr uint32_t fnv1a32(std::string_view text) {
+    uint32_t hash = 2166136261u;
+    for (char c : text) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr uint64_t fnv1a64(std::string_view text, uint64_t hash = 14695981039346656037ull) {
+    for (char c : text) {
+        hash ^= (uint8_t)c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+// OpenGL 3.3 core context without a window or display server. Uses EGL on the
+// Mesa surfaceless platform when available, so it also runs on software
+// rasterizers (llvmpipe) on CI and render farm nodes. Render into a
+// Framebuffer since there is no default framebuffer.
+class HeadlessContext {
+private:
+    EGLDisplay display;
+    EGLContext context;
+    bool valid;
+
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // True once the context is current and GL functions are loaded
+    bool isValid() const { return valid; }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class Camera;
+class ThreadPool;
+
+// Point light as stored in the light texture buffer: four RGBA32F texels per
+// light, read by fetchPointLight() in shaders/object.fragment.glsl
+struct PointLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+// Distance at which the attenuated light falls below 5/256 of its peak,
+// used as the light's cutoff radius for clustering
+float pointLightRadius(float constant, float linear, float quadratic, float maxIntensity);
+
+// Offset and length of a cluster's run in the light index list
+struct LightCluster {
+    uint32_t offset;
+    uint32_t count;
+};
+
+// Clustered forward lighting: the view frustum is split into a grid of
+// screen tiles x exponential depth slices (froxels) and every point light is
+// binned into the froxels its sphere overlaps, so a fragment only evaluates
+// the lights of its own cluster. Binning runs in parallel on a ThreadPool:
+// first per light (view-space bounds), then per depth slice.
+class LightClusters {
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES_Z = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES_Z;
+
+private:
+    struct LightBounds {
+        glm::vec3 center; // view space
+        float radius;
+        int firstSlice;
+        int lastSlice;
+    };
+
+    struct TileRange {
+        uint32_t light;
+        uint8_t x0, x1, y0, y1;
+    };
+
+    ThreadPool* pool;
+    float nearPlane, farPlane;
+    float zScale, zBias;
+
+    std::vector<LightBounds> bounds;
+    std::vector<std::vector<TileRange>> sliceRanges;
+    std::vector<std::vector<uint32_t>> sliceIndices;
+    std::vector<LightCluster> clusters;
+    std::vector<uint32_t> lightIndices;
+
+    float sliceDepth(unsigned int slice) const;
+    void binSlice(unsigned int slice, float p00, float p11);
+
+public:
+    // pool may be null, in which case binning runs on the calling thread
+    explicit LightClusters(ThreadPool* pool = nullptr);
+
+    void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+    void build(const std::vector<PointLight>& lights, const Camera& camera, float aspectRatio);
+
+    const std::vector<LightCluster>& getClusters() const { return clusters; }
+    const std::vector<uint32_t>& getLightIndices() const { return lightIndices; }
+
+    // slice = log(depth) * zScale + zBias
+    float getZScale() const { return zScale; }
+    float getZBias() const { return zBias; }
+};
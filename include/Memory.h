@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Heap use through operator new since startup, on every thread, which
+// includes what standard containers and std::function allocate. Counted by
+// the replacement operators in Memory.cpp; compare two readings to see what
+// a stretch of code allocated.
+namespace memory {
+uint64_t getHeapAllocations();
+uint64_t getHeapBytes();
+} // namespace memory
+
+// Bump allocator over one block taken from upstream up front. Deallocating
+// does nothing; reset() frees everything at once. Requests that do not fit
+// are passed to upstream and counted as overflows, and are freed by reset()
+// as well. Not thread-safe.
+class LinearArena : public std::pmr::memory_resource {
+private:
+    // Placed in front of every overflow allocation
+    struct Overflow {
+        Overflow* next;
+        size_t size;
+        size_t alignment;
+    };
+
+    std::pmr::memory_resource* upstream;
+    unsigned char* buffer;
+    size_t capacity;
+    size_t head;
+    size_t peak;
+    Overflow* overflows;
+    size_t overflowCount;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    explicit LinearArena(size_t capacity, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    ~LinearArena() override;
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void reset();
+
+    size_t getCapacity() const { return capacity; }
+    size_t getUsed() const { return head; }
+    // Most bytes in use at once since construction, overflows not included
+    size_t getPeak() const { return peak; }
+    // Requests that did not fit, since construction
+    size_t getOverflowCount() const { return overflowCount; }
+};
+
+// Two linear arenas taking turns by frame: memory allocated during a frame
+// stays valid through the next one, e.g. for data the GPU or another stage
+// reads a frame late, and is reclaimed when its arena comes round again.
+class FrameArena {
+private:
+    LinearArena arenas[2];
+    unsigned int current;
+
+public:
+    explicit FrameArena(size_t capacityPerFrame,
+                        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+    // Switches to the other arena and resets it
+    void beginFrame();
+
+    LinearArena& get() { return arenas[current]; }
+    const LinearArena& get() const { return arenas[current]; }
+    // Most bytes either arena held in one frame
+    size_t getPeak() const;
+    size_t getOverflowCount() const;
+};
+
+// Blocks of one size carved out of larger chunks from upstream and recycled
+// through a free list, for objects that come and go one at a time. Requests
+// bigger or more aligned than a block go to upstream. Chunks are only
+// returned when the pool is destroyed. Not thread-safe.
+class PoolResource : public std::pmr::memory_resource {
+private:
+    struct Chunk {
+        Chunk* next;
+    };
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    std::pmr::memory_resource* upstream;
+    size_t blockSize;
+    size_t blocksPerChunk;
+    Chunk* chunks;
+    FreeBlock* freeBlocks;
+    size_t liveBlocks;
+    size_t chunkCount;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    // Blocks are aligned to max_align_t
+    PoolResource(size_t blockSize, size_t blocksPerChunk = 256,
+                 std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    ~PoolResource() override;
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    size_t getBlockSize() const { return blockSize; }
+    size_t getLiveBlocks() const { return liveBlocks; }
+    size_t getChunkCount() const { return chunkCount; }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ElementBuffer.h"
+#include "VertexBuffer.h"
+#include "VertexFormat.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Same layout as the cube vertices, so meshes work with the object shaders
+struct MeshVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+static_assert(sizeof(MeshVertex) == 8 * sizeof(float), "vertices are uploaded and cached as raw bytes");
+
+// Indexed triangle list on the CPU, as imported or read back from a cache
+struct MeshData {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Indexed triangle mesh on the GPU with its own vertex array, in any
+// VertexFormat. Draw it with getEncoding().getPositionTransform() folded into
+// the model matrix.
+class Mesh {
+private:
+    VertexBuffer vbo;
+    ElementBuffer ebo;
+    unsigned int vao;
+    size_t vertexCount;
+    VertexEncoding encoding;
+
+    void createVertexArray();
+
+public:
+    // The data is only read during construction, so it may point straight
+    // into a mapped cache file. vertexData holds vertexCount vertices in
+    // encoding.format.
+    Mesh(const void* vertexData, size_t vertexCount, const VertexEncoding& encoding, const uint32_t* indices,
+         size_t indexCount);
+    Mesh(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+    // Encodes the vertices into format first
+    explicit Mesh(const MeshData& data, const VertexFormat& format = FLOAT_VERTEX_FORMAT);
+    ~Mesh();
+
+    // Rule of 5 - prevent copying, allow moving
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+
+    void draw() const;
+    unsigned int getVao() const { return vao; }
+    size_t getVertexCount() const { return vertexCount; }
+    size_t getIndexCount() const { return ebo.getCount(); }
+    size_t getVertexBytes() const { return vertexCount * encoding.format.getStride(); }
+    const VertexEncoding& getEncoding() const { return encoding; }
+};
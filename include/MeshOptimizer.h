@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Post-transform vertex cache behaviour of an index buffer, simulated as a
+// FIFO cache. ACMR is vertex shader invocations per triangle (0.5 at best for
+// a regular grid, 3 with no reuse), ATVR is invocations per unique vertex
+// (1 at best).
+struct VertexCacheStats {
+    size_t transformed = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+// Before/after statistics of optimizeMesh()
+struct MeshOptimizationStats {
+    size_t vertices = 0;
+    size_t triangles = 0;
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// Typical size of the post-transform cache of current GPUs, as a FIFO
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Converts a non-indexed triangle list (three vertices per triangle) into an
+// indexed one, merging bitwise identical vertices
+MeshData indexVertices(const MeshVertex* vertices, size_t vertexCount);
+
+// Reorders triangles for post-transform cache reuse with Tipsify (Sander,
+// Nehab and Barczak 2007), which runs in linear time
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders clusters of a cache-optimized index buffer so outward-facing,
+// outermost clusters draw first and occlude the rest, from any view. Clusters
+// are split where the cache would have been cold anyway, plus wherever the
+// running ACMR is within threshold of the cluster's, so the vertex cache
+// efficiency drops by at most that factor.
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount,
+                      float threshold = 1.05f, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders vertices into the order the index buffer first uses them, so
+// vertex fetch walks memory forwards; unreferenced vertices are dropped
+void optimizeVertexFetch(MeshData& mesh);
+
+// Vertex cache, optionally overdraw, then vertex fetch optimization
+MeshOptimizationStats optimizeMesh(MeshData& mesh, bool overdraw = true);
+
+// optimizeMesh() over every mesh, one mesh per task on pool if given
+std::vector<MeshOptimizationStats> optimizeMeshes(std::vector<MeshData>& meshes, ThreadPool* pool,
+                                                  bool overdraw = true);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Levels per mesh, the full mesh included
+const unsigned int MAX_LOD_LEVELS = 5;
+
+// Largest simplification error a level may reach, as a fraction of the
+// diagonal of the mesh's bounding box
+const float MAX_LOD_ERROR = 0.05f;
+
+// Simplifies a mesh by quadric error metric edge collapses (Garland and
+// Heckbert 1997) until it has at most targetIndexCount indices, or the next
+// collapse would move the surface by more than maxError. Vertices are only
+// ever collapsed onto a neighbour, so the result indexes the same vertex
+// array. Open borders and attribute seams (positions shared by vertices with
+// different normals or texture coordinates) are kept in place as far as
+// the error allows. Returns the error reached, in model units.
+float simplifyMesh(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                   size_t targetIndexCount, float maxError, std::vector<uint32_t>& result);
+
+// A simplified mesh with only the vertices it uses, optimized with
+// optimizeMesh(), and its error in model units
+struct MeshLodData {
+    MeshData mesh;
+    float error = 0.0f;
+};
+
+// Levels 1 and up of mesh, each with about half the triangles of the one
+// before. The chain ends early once a level barely shrinks or would exceed
+// maxError (relative, see MAX_LOD_ERROR). All levels come out of a single
+// simplification run, so their errors are measured against the full mesh.
+std::vector<MeshLodData> generateLods(const MeshData& mesh, unsigned int levelCount = MAX_LOD_LEVELS,
+                                      float maxError = MAX_LOD_ERROR);
+
+// generateLods() over every mesh, one mesh per task on pool if given
+std::vector<std::vector<MeshLodData>> generateMeshLods(const std::vector<MeshData>& meshes, ThreadPool* pool,
+                                                       unsigned int levelCount = MAX_LOD_LEVELS,
+                                                       float maxError = MAX_LOD_ERROR);
+
+// Coarsest level whose error (errors[level], in world units) covers at most
+// threshold pixels when seen from distance. pixelsPerUnit is the projection
+// scale: viewport height / (2 * tan(fovy / 2)). Levels coarser than current
+// have to fit within threshold * (1 - hysteresis) instead, so an object
+// near a switching distance does not flip between two levels every frame.
+unsigned int selectLod(const float* errors, unsigned int levelCount, float distance, float pixelsPerUnit,
+                       float threshold, float hysteresis = 0.0f, unsigned int current = 0);
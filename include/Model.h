@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Frustum.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include <string>
+#include <vector>
+
+// A model file loaded into one Mesh per Assimp mesh, with node transforms
+// baked into the vertices. Imported meshes are optimized for the vertex
+// cache, overdraw and vertex fetch (see MeshOptimizer.h) before upload, and
+// each gets a chain of simplified levels of detail (see MeshSimplifier.h).
+//
+// Imports are cached as flat binary files in cacheDirectory: a header, a mesh
+// table with an entry per level of every mesh, and then the encoded vertex
+// and index arrays exactly as they are uploaded.
+// Later loads map the file and hand the arrays to the GPU without touching
+// Assimp. An entry is rebuilt when the source file's size or modification
+// time no longer match the ones it was built from.
+class Model {
+private:
+    std::vector<Mesh> meshes;
+    // Levels 1 and up of every mesh; the errors start with 0 for level 0
+    std::vector<std::vector<Mesh>> lods;
+    std::vector<std::vector<float>> lodErrors;
+    std::vector<Aabb> bounds;
+    std::vector<MeshOptimizationStats> optimizationStats;
+    bool loaded;
+    bool fromCache;
+
+    bool loadCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime,
+                   const VertexFormat& format);
+
+public:
+    // An empty cacheDirectory always imports and writes nothing. Meshes are
+    // optimized and simplified in parallel on pool, if given, and stored on
+    // the GPU (and in the cache) in format.
+    explicit Model(const std::string& path, const std::string& cacheDirectory = "meshcache",
+                   ThreadPool* pool = nullptr, const VertexFormat& format = COMPACT_VERTEX_FORMAT);
+
+    // Assimp import plus vertex deduplication into indexed meshes, without
+    // any GL calls; safe to call from any thread
+    static bool import(const std::string& path, std::vector<MeshData>& meshes);
+
+    bool isLoaded() const { return loaded; }
+    bool isFromCache() const { return fromCache; }
+    // Full detail meshes
+    const std::vector<Mesh>& getMeshes() const { return meshes; }
+    // Levels of detail of mesh, level 0 being getMeshes()[mesh]
+    unsigned int getLodCount(size_t mesh) const { return (unsigned int)lods[mesh].size() + 1; }
+    const Mesh& getLod(size_t mesh, unsigned int level) const {
+        return level == 0 ? meshes[mesh] : lods[mesh][level - 1];
+    }
+    // Simplification error of every level of mesh, in model units
+    const std::vector<float>& getLodErrors(size_t mesh) const { return lodErrors[mesh]; }
+    // Model space bounds of mesh, the same for all its levels
+    const Aabb& getBounds(size_t mesh) const { return bounds[mesh]; }
+    // One entry per mesh when the model was imported; empty when it came
+    // from the cache, which already holds optimized meshes
+    const std::vector<MeshOptimizationStats>& getOptimizationStats() const { return optimizationStats; }
+    // Totals over the full detail meshes
+    size_t getVertexCount() const;
+    size_t getIndexCount() const;
+    size_t getVertexBytes() const;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// Normal matrix (inverse-transpose of the upper-left 3x3) of a model matrix
+glm::mat3 normalMatrix(const glm::mat4& model);
+
+// Batched version of normalMatrix(). With SSE the matrices are transposed to
+// structure-of-arrays form and four are inverted per iteration via cofactors.
+void computeNormalMatrices(const glm::mat4* models, glm::mat3* normalMatrices, size_t count);
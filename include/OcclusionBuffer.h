@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Frustum.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Low-resolution software depth buffer for occlusion culling. A handful of
+// large occluders are rasterized into it on the CPU, it is reduced into a
+// hierarchical Z pyramid (every texel holds the farthest depth of the four
+// below it), and object bounds are then tested against the pyramid level at
+// which their screen rectangle spans at most 2x2 texels.
+//
+// Both steps are conservative: a pixel is only written where an occluder
+// triangle covers all of it, with the largest depth the triangle reaches
+// inside it, and an object is only reported hidden when its nearest point is
+// behind every texel it overlaps. Culling therefore never removes anything
+// visible; it only misses some occlusion along occluder edges.
+class OcclusionBuffer {
+private:
+    int width;
+    int height;
+    glm::mat4 viewProjection;
+    // Level 0 is the rasterized depth in [0, 1], each further level half the
+    // size of the one before, down to 1x1
+    std::vector<std::vector<float>> levels;
+    std::vector<glm::vec4> clipVertices;
+
+    void rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+public:
+    explicit OcclusionBuffer(int width = 256, int height = 128);
+
+    // Starts a frame: clears to the far plane and sets the matrix occluders
+    // and tests are projected with
+    void clear(const glm::mat4& viewProjection);
+
+    // Rasterizes a closed mesh with counter-clockwise front faces. Triangles
+    // crossing the near plane are skipped rather than clipped.
+    void rasterize(const glm::mat4& model, const glm::vec3* vertices, size_t vertexCount, const uint32_t* indices,
+                   size_t indexCount);
+
+    // Rebuilds the pyramid; call after the last occluder, before testing
+    void buildHierarchy();
+
+    // False only if box is certainly hidden behind the occluders. Safe to call
+    // from several threads at once.
+    bool isVisible(const Aabb& box) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Frame profiler with scoped CPU and GPU timers and Chrome trace export.
+//
+// CPU scopes are timed with the steady clock on whatever thread they run on
+// and appended to a ring buffer owned by that thread: it is the only writer,
+// the GL thread the only reader, so no locks are taken. GPU scopes bracket
+// the GL commands issued inside them with timestamp queries from a pool per
+// frame; a frame's results are read FRAME_LATENCY frames later, when the GPU
+// is long done with them, so reading never stalls.
+//
+// Nothing is recorded outside a capture, where a scope costs one atomic
+// load. endCapture() writes the captured scopes as Chrome trace event JSON,
+// which chrome://tracing and Perfetto (ui.perfetto.dev) open; every thread
+// gets a track, and the GPU one of its own.
+namespace profiler {
+
+constexpr unsigned int FRAME_LATENCY = 4;
+
+// Times the enclosing block on the calling thread. name is kept as a
+// pointer, so it has to outlive the capture; string literals do.
+class CpuScope {
+private:
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit CpuScope(const char* name);
+    ~CpuScope();
+
+    CpuScope(const CpuScope&) = delete;
+    CpuScope& operator=(const CpuScope&) = delete;
+};
+
+// Times the GL commands issued in the enclosing block, on the GPU. GL thread
+// only; scopes may nest, but have to close before the next beginFrame().
+class GpuScope {
+private:
+    int record;
+
+public:
+    explicit GpuScope(const char* name);
+    ~GpuScope();
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+};
+
+// Call on the GL thread once per frame, before its first scope: collects
+// the GPU scopes of FRAME_LATENCY frames ago and the CPU scopes recorded
+// since the last call
+void beginFrame();
+
+// Track name of the calling thread in traces
+void setThreadName(const std::string& name);
+
+void beginCapture();
+// Waits for the GPU scopes still in flight, then writes everything
+// recorded since beginCapture() to path; false if it cannot be written
+bool endCapture(const std::string& path);
+bool isCapturing();
+
+// Deletes the query pools; call before the GL context goes away
+void shutdown();
+
+} // namespace profiler
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Shader.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Texture;
+
+// Per-instance vertex attributes, read with a divisor of 1
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+};
+
+// A program packets draw with, and where their per-draw uniforms go. Invalid
+// handles are skipped.
+struct RenderProgram {
+    const Shader* shader;
+    UniformHandle model;
+    UniformHandle normalMatrix;
+    UniformHandle octahedralNormals;
+};
+
+// Textures for units 0 (diffuse), 1 (specular) and 5 (normal); null ones are
+// left alone
+struct RenderMaterial {
+    const Texture* diffuse;
+    const Texture* specular;
+    const Texture* normal;
+};
+
+// Indexed triangles (32-bit indices) in a vertex array
+struct RenderGeometry {
+    unsigned int vao;
+    GLsizei indexCount;
+    bool octahedralNormals;
+};
+
+// One draw call. Everything except the transform lives in the sort key, so
+// sorting packets by key groups them by state.
+struct DrawPacket {
+    uint64_t key;
+    // Source of the model and normal matrix uniforms of a per-object draw;
+    // null for an instanced one
+    const InstanceData* instance;
+    // Instanced draws take the first instanceCount entries of the vertex
+    // array's instance buffer
+    uint32_t instanceCount;
+};
+
+struct RenderQueueStats {
+    unsigned int packets = 0;
+    unsigned int unsortedStateChanges = 0; // program, material and vertex array switches in recording order
+    unsigned int stateChanges = 0;         // the same after sorting, as replayed
+};
+
+// Draw calls recorded as compact packets, possibly from several threads,
+// radix-sorted by a 64-bit state key and replayed on the GL thread.
+//
+// Programs, materials and geometry are registered up front and referred to
+// by index. Keys hold, from the most significant bit down: a layer (replayed
+// separately, e.g. opaque before unlit), then the program, the material, the
+// geometry and finally the view depth, so that packets sharing all state are
+// drawn front to back.
+class RenderQueue {
+private:
+    std::vector<RenderProgram> programs;
+    std::vector<RenderMaterial> materials;
+    std::vector<RenderGeometry> geometries;
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> sortScratch;
+    RenderQueueStats stats;
+
+public:
+    static const int LAYER_BITS = 4;
+    static const int PROGRAM_BITS = 10;
+    static const int MATERIAL_BITS = 10;
+    static const int GEOMETRY_BITS = 12;
+    static const int DEPTH_BITS = 28;
+    static_assert(LAYER_BITS + PROGRAM_BITS + MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS == 64, "keys are 64-bit");
+
+    // depth is any non-negative measure of distance to the camera
+    static uint64_t makeKey(uint32_t layer, uint32_t program, uint32_t material, uint32_t geometry, float depth);
+
+    // Indices to build keys from; they stay valid until clearStates()
+    uint32_t addProgram(const RenderProgram& program);
+    uint32_t addMaterial(const RenderMaterial& material);
+    uint32_t addGeometry(const RenderGeometry& geometry);
+    void clearStates();
+
+    // Drops the packets of the last frame
+    void clear();
+    // Appends count packets and returns the first of them. Not thread-safe
+    // itself, but the returned packets may be filled in from any thread until
+    // the next allocate().
+    DrawPacket* allocate(size_t count);
+    // Orders the packets by key, stably, and records the state changes before
+    // and after
+    void sort();
+    // Issues the packets of one layer; returns the number of draw calls
+    unsigned int execute(uint32_t layer) const;
+
+    size_t getPacketCount() const { return packets.size(); }
+    const RenderQueueStats& getStats() const { return stats; }
+};
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "Bvh.h"
+#include "ElementBuffer.h"
+#include "GLState.h"
+#include "GBuffer.h"
+#include "LightClusters.h"
+#include "Memory.h"
+#include "Model.h"
+#include "OcclusionBuffer.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "ShadowMaps.h"
+#include "StreamBuffer.h"
+#include "Texture.h"
+#include "TextureBuffer.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "UniformBlocks.h"
+#include "VertexBuffer.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+class Camera;
+
+// Screen-space error allowed for a level of detail, in pixels, and how much
+// less a coarser level has to show before it replaces the current one
+const float DEFAULT_LOD_THRESHOLD = 1.0f;
+const float DEFAULT_LOD_HYSTERESIS = 0.25f;
+
+// Texels along each side of a shadow cascade
+const int DEFAULT_SHADOW_MAP_SIZE = 2048;
+
+enum class SubmissionMode {
+    PerObject, // one uniform upload + glDrawArrays per object
+    Instanced  // one glDrawArraysInstanced per object type
+};
+
+enum class RenderPath {
+    Forward, // clustered forward shading, lights evaluated per fragment
+    Deferred // G-buffer pass, then full-screen and light volume passes
+};
+
+struct RenderStats {
+    unsigned int drawCalls = 0;
+    unsigned int objects = 0;              // cubes, lights and model meshes
+    unsigned int frustumCulledObjects = 0; // outside the view frustum
+    unsigned int occludedObjects = 0;      // in the frustum, but hidden behind occluders
+    unsigned int visibleObjects = 0;       // left after both, and drawn
+    size_t triangles = 0;                  // drawn, at the selected levels of detail
+    size_t fullDetailTriangles = 0;        // the same objects drawn at full detail
+    RenderQueueStats queue;
+    GLStateCounters glState; // binds issued to GL vs filtered as redundant
+    size_t streamedBytes = 0;     // instances and uniforms written to the stream buffer
+    unsigned int streamWaits = 0; // 1 if the frame waited for the GPU to free its stream region
+    ShadowCascadeStats shadowCascades[CascadedShadowMaps::CASCADE_COUNT];
+};
+
+// Owns the GPU resources of the cube/light scene and draws it for a camera.
+// Shared by the interactive application and the headless benchmark.
+class Renderer {
+private:
+    // Shared stages and program binaries for the shaders below; also
+    // watches their files once hot reload is on
+    ShaderCache shaderCache;
+    Shader lightShader;
+    Shader lightInstancedShader;
+    Shader lightVolumeShader;
+    // Lit shaders are built per feature mask; the permutations matching the
+    // current lights and the cube material are the active ones below
+    ShaderVariants objectShaders;
+    ShaderVariants objectInstancedShaders;
+    ShaderVariants gbufferShaders;
+    ShaderVariants gbufferInstancedShaders;
+    ShaderVariants deferredShaders;
+    uint32_t lightingFeatures;
+    Shader* objectShader;
+    Shader* objectInstancedShader;
+    Shader* gbufferShader;
+    Shader* gbufferInstancedShader;
+    Shader* deferredShader;
+    // Shadow casters only need depth: the plain and instanced vertex stages
+    // with an empty fragment stage
+    Shader depthShader;
+    Shader depthInstancedShader;
+    // Cube mesh, indexed, optimized and compacted from the plain triangle
+    // list at startup
+    VertexBuffer vbo;
+    ElementBuffer cubeEbo;
+    unsigned int objectVao;
+    unsigned int lightVao;
+    // The cube again, with its instance attributes pointed at one cascade's
+    // casters at a time
+    unsigned int shadowVao;
+
+    // Shared by texture decoding and light binning
+    ThreadPool threadPool;
+    // Backs lists that only live for a frame, so steady-state frames make
+    // no heap allocations
+    FrameArena frameArena;
+    // Maps show a placeholder until the loader has made them resident; after
+    // the first run they come precompressed from the cache
+    TextureCache textureCache;
+    TextureLoader textureLoader;
+    std::shared_ptr<Texture> diffuseMap;
+    std::shared_ptr<Texture> specularMap;
+
+    // Visible instances and the Camera and Lights blocks are written
+    // straight into a ring of per-frame regions; the instance attributes and
+    // uniform block ranges follow them around
+    std::unique_ptr<StreamBuffer> frameData;
+    size_t uniformAlignment;
+    size_t lightsOffset;
+    size_t shadowsOffset;
+    size_t frameUniformSize;
+    LightsBlock lights;
+
+    // Point lights are binned into clusters on the CPU every frame and handed
+    // to the fragment shader through texture buffers. Binning runs as a job
+    // alongside culling and draw recording, counted by lightBinning.
+    std::vector<PointLight> pointLights;
+    LightClusters lightClusters;
+    JobCounter lightBinning;
+    TextureBuffer pointLightBuffer;
+    TextureBuffer clusterBuffer;
+    TextureBuffer lightIndexBuffer;
+
+    // Deferred path; the G-buffer is created on first use and follows the
+    // viewport size
+    std::unique_ptr<GBuffer> gbuffer;
+    VertexBuffer lightVolumeVbo;
+    ElementBuffer lightVolumeEbo;
+    unsigned int lightVolumeVao;
+    unsigned int screenVao;
+
+    // Cube and light marker transforms, nodes [0, cubes) and the lights
+    // after them. They are static, so instances are built from the world
+    // matrices once up front, along with world bounds and a BVH per object
+    // type for frustum culling
+    SceneGraph scene;
+    std::vector<InstanceData> cubeInstances;
+    std::vector<InstanceData> lightInstances;
+    std::vector<Aabb> cubeBounds;
+    std::vector<Aabb> lightBounds;
+    Bvh cubeBvh;
+    Bvh lightBvh;
+    std::vector<uint32_t> visibleCubes;
+    std::vector<uint32_t> visibleLights;
+
+    // Occlusion culling against the cubes nearest the camera, rasterized on
+    // the CPU every frame
+    OcclusionBuffer occlusionBuffer;
+    std::vector<std::pair<float, uint32_t>> occluderCandidates;
+    std::vector<uint8_t> occlusionResults;
+    bool occlusionCulling;
+
+    // Optional loaded model, drawn with the cube material; not owned. Each
+    // level of each mesh has its own transform, with its position encoding
+    // folded in; a mesh's levels are consecutive in the instance and
+    // geometry lists.
+    const Model* sceneModel;
+    InstanceData sceneModelTransform;
+    std::vector<InstanceData> sceneModelInstances;
+
+    // Level of detail picked per model mesh every frame from the pixels its
+    // simplification error would cover on screen. Meshes are culled like
+    // the cubes; visibleModelMeshes indexes sceneModelLods.
+    struct ModelLod {
+        uint32_t first;      // level 0 in sceneModelInstances
+        uint32_t levelCount;
+        uint32_t level;      // drawn last frame
+        glm::vec3 center;    // world bounding sphere
+        float radius;
+        float errorScale;    // model to world units
+        Aabb bounds;         // world bounds
+    };
+    std::vector<ModelLod> sceneModelLods;
+    std::vector<uint32_t> visibleModelMeshes;
+    bool lodEnabled;
+    float lodThreshold;
+    float lodHysteresis;
+
+    // Directional light shadows; the maps are created on first use. Casters
+    // are culled per cascade on the CPU and only for cascades that are not
+    // cached; in instanced mode each cascade's cubes get their own stretch
+    // of the stream buffer.
+    std::unique_ptr<CascadedShadowMaps> shadowMaps;
+    std::vector<uint32_t> shadowCubes[CascadedShadowMaps::CASCADE_COUNT];
+    std::vector<uint32_t> shadowModelMeshes[CascadedShadowMaps::CASCADE_COUNT];
+    size_t shadowInstanceOffsets[CascadedShadowMaps::CASCADE_COUNT];
+    bool shadowPending[CascadedShadowMaps::CASCADE_COUNT]; // drawn this frame
+    bool shadows;
+    bool shadowCaching;
+
+    // Scene draws are recorded into the queue every frame and replayed
+    // sorted by state; these index its program, material and geometry tables
+    RenderQueue renderQueue;
+    uint32_t objectProgram, objectInstancedProgram, gbufferProgram, gbufferInstancedProgram;
+    uint32_t lightProgram, lightInstancedProgram;
+    uint32_t depthProgram, depthInstancedProgram;
+    uint32_t cubeMaterial, noMaterial;
+    uint32_t cubeGeometry, lightGeometry, shadowCubeGeometry;
+    std::vector<uint32_t> sceneModelGeometries;
+
+    SubmissionMode submissionMode;
+    RenderPath renderPath;
+    bool spotlight;
+    RenderStats stats;
+
+    void buildLights(unsigned int lightCount);
+    void buildInstances(unsigned int cubeCount);
+    std::pmr::vector<Shader*> getShaders(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    uint32_t getLightingFeatures() const;
+    void selectShaders();
+    void setupShaders();
+    void reloadShaders();
+    void setupMaterial(const Shader& shader) const;
+    void setupLights();
+    void uploadFrameUniforms(const Camera& camera, int width, int height);
+    void binLights(const Camera& camera, int width, int height);
+    void uploadLightClusters();
+    void cullInstances(const Camera& camera, int width, int height);
+    void rasterizeOccluders(const Camera& camera, const glm::mat4& viewProjection);
+    void removeOccluded(const std::vector<Aabb>& bounds, std::vector<uint32_t>& visible);
+    bool gatherInstances(const std::vector<InstanceData>& instances, const std::vector<uint32_t>& visible,
+                         size_t& offset);
+    void streamInstances(const std::vector<InstanceData>& instances, const std::vector<uint32_t>& visible,
+                         unsigned int vao);
+    void cullShadowCasters(const Camera& camera, int width, int height);
+    void setupRenderQueue();
+    void selectModelLods(const Camera& camera, int height);
+    void recordDraws(const Camera& camera);
+    void renderShadows(int width, int height);
+    void renderForward(const Camera& camera, int width, int height);
+    void renderDeferred(int width, int height);
+
+public:
+    // Scenes with more than the 10 showcase cubes or the 4 showcase point
+    // lights are filled up with procedurally placed ones
+    explicit Renderer(unsigned int cubeCount = 10, unsigned int lightCount = 4,
+                      SubmissionMode mode = SubmissionMode::Instanced);
+    ~Renderer();
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // width and height are the viewport size in pixels, which the light
+    // clusters are tiled over
+    void render(const Camera& camera, int width, int height);
+    // Blocks until every texture has been decoded and uploaded
+    void finishLoading() { textureLoader.finish(); }
+    // Draws model (which must outlive the Renderer or be unset) along with
+    // the cubes; null removes it
+    void setModel(const Model* model, const glm::mat4& transform = glm::mat4(1.0f));
+    void setSpotlight(bool enabled) { spotlight = enabled; }
+    // Cascaded shadows from the directional light
+    void setShadows(bool enabled) { shadows = enabled; }
+    bool getShadows() const { return shadows; }
+    // Off, every cascade is drawn every frame
+    void setShadowCaching(bool enabled) { shadowCaching = enabled; }
+    bool getShadowCaching() const { return shadowCaching; }
+    // Off, model meshes are always drawn at full detail
+    void setLodEnabled(bool enabled) { lodEnabled = enabled; }
+    bool getLodEnabled() const { return lodEnabled; }
+    // Error a level may show on screen, in pixels; a coarser level than the
+    // current one has to show a hysteresis fraction less before it is taken
+    void setLodThreshold(float pixels, float hysteresis = DEFAULT_LOD_HYSTERESIS) {
+        lodThreshold = pixels;
+        lodHysteresis = hysteresis;
+    }
+    // Watches SHADER_DIR from now on and swaps in programs whose files were
+    // saved; a program that fails to build keeps running the old version.
+    // Without parallel shader compile the new program is compiled and linked
+    // on the render thread, so the frame after a save stalls for it.
+    bool enableShaderHotReload() { return shaderCache.watch(SHADER_DIR); }
+    const ShaderCacheStats& getShaderCacheStats() const { return shaderCache.getStats(); }
+    // Persistent mapping where the context has buffer storage; off, or
+    // without it, per-frame data is mapped unsynchronized and orphaned
+    void setPersistentStreaming(bool enabled);
+    bool getPersistentStreaming() const { return frameData->isPersistent(); }
+    void setOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+    bool getOcclusionCulling() const { return occlusionCulling; }
+    void setSubmissionMode(SubmissionMode mode) { submissionMode = mode; }
+    SubmissionMode getSubmissionMode() const { return submissionMode; }
+    void setRenderPath(RenderPath path) { renderPath = path; }
+    RenderPath getRenderPath() const { return renderPath; }
+    const RenderStats& getStats() const { return stats; }
+    // Shared with loading work outside of render(), such as a Model's
+    // mesh optimization and simplification
+    ThreadPool& getThreadPool() { return threadPool; }
+    const LightClusters& getLightClusters() const { return lightClusters; }
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Transform hierarchy stored as structure of arrays: local position,
+// rotation and scale, parent and world matrix each live in an array of
+// their own, indexed by slot.
+//
+// Slots are ordered by depth, level by level, and within a level by parent,
+// so a parent always comes before its children and every level is one
+// contiguous range. update() walks the levels in order and recomputes the
+// world matrix of a node only when its local transform was set or its
+// parent's world matrix changed in the same pass; the nodes of a level are
+// independent of each other and split across the thread pool. Levels with
+// nothing to do are skipped without being scanned.
+//
+// Nodes are referred to by the index addNode() returned, which stays valid
+// when adding nodes reorders the slots.
+class SceneGraph {
+public:
+    static constexpr uint32_t NO_PARENT = 0xFFFFFFFF;
+
+private:
+    ThreadPool* pool;
+
+    // By slot
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<uint32_t> parents; // slot, or NO_PARENT for roots
+    std::vector<glm::mat4> worldMatrices;
+    // Local transform set, or, during update(), world matrix recomputed
+    std::vector<uint8_t> dirty;
+
+    // Slots [levelStarts[d], levelStarts[d + 1]) are the nodes at depth d
+    std::vector<uint32_t> levelStarts;
+    std::vector<uint8_t> levelDirty;
+
+    // Node index <-> slot
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> nodes;
+    std::vector<uint32_t> depths; // by node
+    // Nodes added since the last update(), which still have to be sorted in
+    bool layoutChanged;
+    size_t updatedCount;
+
+    void rebuildLayout();
+    void markDirty(uint32_t slot);
+    size_t updateRange(uint32_t begin, uint32_t end, bool parentsChanged);
+
+public:
+    // pool may be null, in which case updates run on the calling thread
+    explicit SceneGraph(ThreadPool* pool = nullptr);
+
+    void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+
+    // Adds a node below parent (a node index, or NO_PARENT) and returns its
+    // index; nodes are numbered in the order they are added
+    uint32_t addNode(uint32_t parent, const glm::vec3& position = glm::vec3(0.0f),
+                     const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                     const glm::vec3& scale = glm::vec3(1.0f));
+    void reserve(size_t count);
+    void clear();
+
+    void setPosition(uint32_t node, const glm::vec3& position);
+    void setRotation(uint32_t node, const glm::quat& rotation);
+    void setScale(uint32_t node, const glm::vec3& scale);
+    void setLocal(uint32_t node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+    const glm::vec3& getPosition(uint32_t node) const { return positions[slots[node]]; }
+    const glm::quat& getRotation(uint32_t node) const { return rotations[slots[node]]; }
+    const glm::vec3& getScale(uint32_t node) const { return scales[slots[node]]; }
+    uint32_t getParent(uint32_t node) const;
+
+    // Brings the world matrices of every changed subtree up to date
+    void update();
+    // As of the last update()
+    const glm::mat4& getWorldMatrix(uint32_t node) const { return worldMatrices[slots[node]]; }
+
+    size_t getNodeCount() const { return slots.size(); }
+    size_t getLevelCount() const { return levelStarts.empty() ? 0 : levelStarts.size() - 1; }
+    // World matrices the last update() recomputed
+    size_t getUpdatedCount() const { return updatedCount; }
+};
@@ -1,23 +1,93 @@
 #pragma once
 
+#include "Hash.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
+
+class ShaderCache;
+
+// Where the renderer and the benchmark load shaders from. CMake points it at
+// the source tree, so hot reload sees the files being edited rather than a
+// copy in the build directory.
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders"
+#endif
+
+// Resolved uniform location. Look handles up once after linking and pass
+// them to the setters in hot loops: no hashing, no string allocation.
+class UniformHandle {
+private:
+    GLint location;
+
+public:
+    constexpr UniformHandle() : location(-1) {}
+    constexpr explicit UniformHandle(GLint location) : location(location) {}
+
+    constexpr GLint getLocation() const { return location; }
+    constexpr bool isValid() const { return location >= 0; }
+};
+
+// Uniform name paired with its FNV-1a hash. String literals are hashed at
+// compile time; std::strings are hashed when converted.
+class UniformName {
+private:
+    std::string_view name;
+    uint32_t hash;
+
+public:
+    template <size_t N>
+    consteval UniformName(const char (&literal)[N]) : name(literal, N - 1), hash(fnv1a32(name)) {}
+    UniformName(const std::string& name) : name(name), hash(fnv1a32(name)) {}
+    explicit UniformName(std::string_view name) : name(name), hash(fnv1a32(name)) {}
+
+    std::string_view getName() const { return name; }
+    uint32_t getHash() const { return hash; }
+};
 
 class Shader {
 private:
+    struct UniformInfo {
+        uint32_t hash;
+        GLint location;
+        std::string name;
+    };
+
     unsigned int ID;
-    mutable std::unordered_map<std::string, GLint> uniformLocations;
-    
+    // Every active uniform reflected at link time, sorted by name hash
+    std::vector<UniformInfo> uniforms;
+    std::string vertexPath;
+    std::string fragmentPath;
+    // Injected after the #version line of both sources
+    std::string defines;
+    ShaderCache* cache;
+    // Replacement program of a reload, and the key to store its binary
+    // under once linked (0 if it came from the cache)
+    unsigned int pendingID;
+    uint64_t pendingKey;
+
     std::string readFile(const char* filePath) const;
-    void checkCompileErrors(unsigned int shader, const std::string& type) const;
-    GLint getUniformLocation(const std::string& name) const;
+    bool checkCompileErrors(unsigned int shader, const std::string& type) const;
+    unsigned int compileStage(GLenum type, const std::string& source) const;
+    unsigned int startLink(uint64_t& binaryKey) const;
+    bool finishLink(unsigned int program, uint64_t binaryKey) const;
+    void reflectUniforms();
+    void addUniform(std::string_view name, GLint location);
+    UniformHandle findUniform(uint32_t nameHash, std::string_view name) const;
 
 public:
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // With a cache, stages are shared with the other programs using it and
+    // the linked program is loaded from, or stored to, its binary cache.
+    // defines (whole "#define ..." lines) select a permutation of the
+    // sources; see ShaderVariants. deferLink only starts linking: there is no
+    // program until finishReload() swaps it in, which lets the driver build
+    // several at once.
+    Shader(const char* vertexPath, const char* fragmentPath, ShaderCache* cache = nullptr, std::string defines = "",
+           bool deferLink = false);
     ~Shader();
-    
+
     // Rule of 5 - prevent copying, allow moving
     Shader(const Shader&) = delete;
     Shader& operator=(const Shader&) = delete;
@@ -27,16 +97,49 @@ public:
     void use() const;
     unsigned int getID() const { return ID; }
 
-    // Uniform setters with caching
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setVec2(const std::string& name, float x, float y) const;
-    void setVec3(const std::string& name, float x, float y, float z) const;
-    void setVec3(const std::string& name, const glm::vec3& value) const;
-    void setVec4(const std::string& name, float x, float y, float z, float w) const;
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
-    
+    // Hot reload, in two steps so the driver can link in between without
+    // the frame waiting on it: reload() starts a new program from the
+    // current files, and finishReload() (a frame later, say) swaps it in if
+    // it linked, keeping the old one otherwise. Uniform values and block
+    // bindings belong to the program, so after finishReload() returns true
+    // they have to be set again and handles looked up again.
+    void reload();
+    bool finishReload();
+    bool isReloading() const { return pendingID != 0; }
+    // Whether finishReload() would return without waiting on the driver;
+    // always true without parallel shader compile
+    bool isLinkComplete() const;
+    bool usesFile(const std::string& path) const;
+
+    // Handle for an active uniform; invalid (setters ignore it) if the name
+    // is unknown or was optimized out
+    UniformHandle getUniform(UniformName name) const { return findUniform(name.getHash(), name.getName()); }
+
+    // Uniform setters by handle - use these in per-frame/per-draw code
+    void setBool(UniformHandle uniform, bool value) const;
+    void setInt(UniformHandle uniform, int value) const;
+    void setFloat(UniformHandle uniform, float value) const;
+    void setVec2(UniformHandle uniform, float x, float y) const;
+    void setVec3(UniformHandle uniform, float x, float y, float z) const;
+    void setVec3(UniformHandle uniform, const glm::vec3& value) const;
+    void setVec4(UniformHandle uniform, float x, float y, float z, float w) const;
+    void setMat3(UniformHandle uniform, const glm::mat3& mat) const;
+    void setMat4(UniformHandle uniform, const glm::mat4& mat) const;
+
+    // Uniform setters by name (hashed lookup in the reflected table)
+    void setBool(UniformName name, bool value) const { setBool(getUniform(name), value); }
+    void setInt(UniformName name, int value) const { setInt(getUniform(name), value); }
+    void setFloat(UniformName name, float value) const { setFloat(getUniform(name), value); }
+    void setVec2(UniformName name, float x, float y) const { setVec2(getUniform(name), x, y); }
+    void setVec3(UniformName name, float x, float y, float z) const { setVec3(getUniform(name), x, y, z); }
+    void setVec3(UniformName name, const glm::vec3& value) const { setVec3(getUniform(name), value); }
+    void setVec4(UniformName name, float x, float y, float z, float w) const { setVec4(getUniform(name), x, y, z, w); }
+    void setMat3(UniformName name, const glm::mat3& mat) const { setMat3(getUniform(name), mat); }
+    void setMat4(UniformName name, const glm::mat4& mat) const { setMat4(getUniform(name), mat); }
+
+    // Uniform blocks - no-op if the program does not declare the block
+    void bindUniformBlock(const std::string& blockName, unsigned int binding) const;
+
     // Convenience methods
     void setCameraUniforms(const std::string& viewName, const std::string& projectionName, 
                           const class Camera& camera, float aspectRatio) const;
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ShaderCacheStats {
+    unsigned int binaryHits = 0;     // programs loaded from a stored binary
+    unsigned int binaryMisses = 0;   // programs that had to be linked from source
+    unsigned int stagesCompiled = 0; // shader objects compiled
+    unsigned int stagesShared = 0;   // stage requests answered by one compiled earlier
+};
+
+// Speeds up program creation in two ways. Compiled shader stages are kept,
+// keyed by type and source, so a file shared by several programs (like
+// vertex.glsl) is compiled once. Linked programs are written to disk with
+// glGetProgramBinary and loaded with glProgramBinary the next time; entries
+// are keyed by a hash of both sources and the driver, so an edited shader or
+// a driver update simply misses.
+//
+// Binaries need GL 4.1 or ARB_get_program_binary with at least one binary
+// format; without them only the stage sharing remains.
+//
+// watch() additionally reports files written in a directory, for hot
+// reloading; a background thread waits on inotify (Linux only).
+class ShaderCache {
+private:
+    std::string directory;
+    bool binariesSupported;
+    uint64_t driverHash;
+    std::unordered_map<uint64_t, GLuint> stages;
+    ShaderCacheStats stats;
+
+    // Hot reload
+    int watchDescriptor;
+    std::thread watcher;
+    std::atomic<bool> stopping;
+    std::mutex watchMutex;
+    std::vector<std::pair<int, std::string>> watchedDirectories;
+    std::vector<std::string> changedFiles;
+
+    std::string entryPath(uint64_t key) const;
+    void watchLoop();
+
+public:
+    // Must be constructed with a current GL context; an empty directory keeps
+    // binaries off disk
+    explicit ShaderCache(std::string directory = "shadercache");
+    ~ShaderCache();
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Key of the program linked from these sources on this driver
+    uint64_t getProgramKey(const std::string& vertexSource, const std::string& fragmentSource) const;
+    // Loads the binary stored under key into program, leaving it linked;
+    // false if there is none or the driver rejects it
+    bool loadBinary(GLuint program, uint64_t key);
+    // Call before linking a program whose binary will be stored
+    void prepareProgram(GLuint program) const;
+    // Writes out the binary of a successfully linked program
+    void storeBinary(GLuint program, uint64_t key) const;
+
+    // Compiled stage of that type for source, or 0 if there is none yet
+    GLuint findStage(GLenum type, const std::string& source);
+    // Hands a compiled stage to the cache, which deletes it in releaseStages()
+    void addStage(GLenum type, const std::string& source, GLuint shader);
+    // Deletes the compiled stages; programs linked from them keep working
+    void releaseStages();
+
+    // Reports files closed after writing, or moved, into directory from now
+    // on. false if it cannot be watched.
+    bool watch(const std::string& directory);
+    // Paths (directory/name) changed since the last call, each once
+    std::vector<std::string> takeChangedFiles();
+
+    bool isBinarySupported() const { return binariesSupported; }
+    const ShaderCacheStats& getStats() const { return stats; }
+    const std::string& getDirectory() const { return directory; }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Shader.h"
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderCache;
+
+// Compile-time features of the lit shaders. Each bit becomes the #define
+// noted next to it, so a disabled feature costs nothing at run time instead
+// of a uniform branch.
+namespace ShaderFeature {
+constexpr uint32_t DirLight = 1u << 0;    // DIR_LIGHT: the directional light
+constexpr uint32_t PointLights = 1u << 1; // POINT_LIGHTS: clustered point lights
+constexpr uint32_t SpotLight = 1u << 2;   // SPOT_LIGHT: the camera spotlight
+constexpr uint32_t DiffuseMap = 1u << 3;  // DIFFUSE_MAP: material.diffuse, else material.diffuseColor
+constexpr uint32_t SpecularMap = 1u << 4; // SPECULAR_MAP: material.specular, else material.specularColor
+constexpr uint32_t NormalMap = 1u << 5;   // NORMAL_MAP: material.normal, in tangent space
+constexpr uint32_t DirShadow = 1u << 6;   // DIR_SHADOW (and SHADOW_CASCADES): cascaded shadow maps for the directional light
+constexpr uint32_t All = (1u << 7) - 1;
+} // namespace ShaderFeature
+
+// The #define lines for a feature mask
+std::string shaderDefines(uint32_t features);
+
+// Permutations of one vertex/fragment pair, built on demand and kept by
+// feature mask. Bits the pair does not use are dropped first, so masks that
+// only differ in them share a program.
+//
+// prepare() starts a variant without waiting for it; with parallel shader
+// compile several prepared variants build at once on driver threads, and
+// isReady() tells when one can be taken without a stall. get() returns a
+// variant, finishing or building it as needed. References stay valid for
+// the lifetime of the set.
+class ShaderVariants {
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    ShaderCache* cache;
+    uint32_t usedFeatures;
+    std::unordered_map<uint32_t, Shader> variants;
+
+public:
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, ShaderCache* cache = nullptr,
+                   uint32_t usedFeatures = ShaderFeature::All);
+
+    void prepare(uint32_t features);
+    bool isReady(uint32_t features) const;
+    Shader& get(uint32_t features);
+
+    // Every variant started so far, linked or not; for reloading
+    std::pmr::vector<Shader*> getShaders(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    uint32_t getUsedFeatures() const { return usedFeatures; }
+    size_t getCount() const { return variants.size(); }
+};
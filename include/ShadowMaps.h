@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Frustum.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Camera;
+
+// What one cascade cost in a frame
+struct ShadowCascadeStats {
+    bool rendered = false;       // false when the cached map was kept
+    unsigned int casters = 0;    // objects drawn into it
+    unsigned int drawCalls = 0;
+    double gpuMs = 0.0;          // GPU time of the cascade QUERY_FRAMES frames ago, 0 if it was kept then
+};
+
+// Cascaded shadow maps for a directional light. The view frustum up to
+// SHADOW_DISTANCE is split into CASCADE_COUNT depth slices, each covered by
+// an orthographic depth map in one layer of a texture array.
+//
+// A cascade is fit to the bounding sphere of its slice, so its size does not
+// change as the camera turns, and its center is snapped to whole texels in
+// light space, so shadow edges do not shimmer as the camera moves. Casters
+// between the light and a cascade are flattened onto its near plane with
+// depth clamping, so the depth range only has to span the sphere.
+//
+// Maps are cached: with caching on, a cascade covers a margin around its
+// slice and keeps its map until the slice moves out of it or the light
+// turns, so far cascades are only redrawn now and then. The casters have
+// to be static for that; call invalidate() when they change.
+class CascadedShadowMaps {
+public:
+    static const unsigned int CASCADE_COUNT = 4;
+    static const unsigned int QUERY_FRAMES = 4;
+    // Texture unit the lighting shaders read the maps from
+    static const unsigned int TEXTURE_SLOT = 9;
+
+private:
+    struct Cascade {
+        glm::mat4 projection;
+        glm::mat4 viewProjection; // world to the cascade's clip space
+        glm::vec3 center;         // light space, snapped to texels
+        float radius;             // half the side of the map, margin included
+        float splitDepth;         // view depth where the cascade ends
+        bool valid;               // the layer holds a map drawn with viewProjection
+        bool needsRender;
+    };
+
+    unsigned int ID;
+    unsigned int depthTexture;
+    int size;
+    bool caching;
+    glm::vec3 lightDirection;
+    glm::mat4 lightView;
+    Cascade cascades[CASCADE_COUNT];
+    ShadowCascadeStats stats[CASCADE_COUNT];
+
+    // A begin and end timestamp per cascade, for each of QUERY_FRAMES frames
+    unsigned int queries[QUERY_FRAMES][CASCADE_COUNT * 2];
+    bool queried[QUERY_FRAMES][CASCADE_COUNT];
+    unsigned int frame;
+
+    void collectQueries();
+
+public:
+    // size x size texels per cascade
+    explicit CascadedShadowMaps(int size);
+    ~CascadedShadowMaps();
+
+    CascadedShadowMaps(const CascadedShadowMaps&) = delete;
+    CascadedShadowMaps& operator=(const CascadedShadowMaps&) = delete;
+
+    // Fits the cascades to camera for this frame and decides which of them
+    // have to be drawn; lightDirection points from the light into the scene
+    void update(const Camera& camera, float aspectRatio, const glm::vec3& lightDirection);
+    // Every cascade is drawn again on the next update()
+    void invalidate();
+
+    bool needsRender(unsigned int cascade) const { return cascades[cascade].needsRender; }
+    // Everything that can cast a shadow into the cascade: its box with the
+    // near plane moved out to the light
+    Frustum getCasterFrustum(unsigned int cascade) const;
+    const glm::mat4& getViewMatrix() const { return lightView; }
+    const glm::mat4& getProjectionMatrix(unsigned int cascade) const { return cascades[cascade].projection; }
+    const glm::mat4& getViewProjectionMatrix(unsigned int cascade) const { return cascades[cascade].viewProjection; }
+    float getSplitDepth(unsigned int cascade) const { return cascades[cascade].splitDepth; }
+    // World-space size of one texel of the cascade
+    float getTexelSize(unsigned int cascade) const { return 2.0f * cascades[cascade].radius / size; }
+
+    // Binds the cascade's layer and viewport and clears it; draws up to
+    // endCascade() go into it
+    void beginCascade(unsigned int cascade);
+    void endCascade(unsigned int cascade, unsigned int casters, unsigned int drawCalls);
+
+    void bindTexture(unsigned int unit = TEXTURE_SLOT) const;
+    void setCaching(bool enabled);
+    bool getCaching() const { return caching; }
+    int getSize() const { return size; }
+    const ShadowCascadeStats* getStats() const { return stats; }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Where the bytes of an allocation go: producers write them through data,
+// GL reads them at offset into the buffer
+struct StreamAllocation {
+    void* data;
+    size_t offset;
+};
+
+// Buffer for data that is rewritten every frame, such as instance transforms
+// and per-frame uniforms. Storage is allocated once and handed out as a ring
+// of FRAME_REGIONS regions, one per frame, so the CPU fills one while the GPU
+// may still be reading the previous ones. Allocations point straight into
+// GL's memory; nothing is copied on the way.
+//
+// With buffer storage (GL 4.4 or ARB_buffer_storage) the whole buffer is
+// mapped once, persistently and coherently, and a fence at the end of each
+// frame guards its region until the GPU has read it. On plain GL 3.3 each
+// allocation maps its range unsynchronized instead, and the buffer is
+// orphaned whenever the ring wraps, so the driver supplies fresh storage
+// rather than the CPU waiting.
+class StreamBuffer {
+public:
+    static const unsigned int FRAME_REGIONS = 3;
+
+private:
+    GLenum target;
+    unsigned int ID;
+    size_t frameSize;
+    bool persistent;
+    unsigned char* persistentData;
+    bool mapped;
+    bool frameStarted;
+    unsigned int region;
+    size_t head; // bytes allocated from the current region so far
+    GLsync fences[FRAME_REGIONS];
+    unsigned int waits;
+
+    void beginFrame();
+    void release();
+
+public:
+    // frameSize is the most one frame allocates, alignment padding included.
+    // allowPersistent false takes the GL 3.3 path even where buffer storage
+    // is available, for comparison.
+    StreamBuffer(GLenum target, size_t frameSize, bool allowPersistent = true);
+    ~StreamBuffer();
+
+    // Rule of 5 - prevent copying, allow moving
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    StreamBuffer(StreamBuffer&& other) noexcept;
+    StreamBuffer& operator=(StreamBuffer&& other) noexcept;
+
+    // size bytes from the current frame's region, at an offset that is a
+    // multiple of alignment; null data if the region is full. The first
+    // allocation of a frame may wait for the GPU to release its region. The
+    // pointer is for writing only and stays valid until flush().
+    StreamAllocation allocate(size_t size, size_t alignment = 16);
+    // Done writing the last allocation; call before GL reads from it. The
+    // GL 3.3 path unmaps it here, so there is one allocation open at a time.
+    void flush();
+    // Closes the frame; call once the draws reading its allocations have
+    // been issued
+    void endFrame();
+
+    void bind() const;
+    unsigned int getID() const { return ID; }
+    size_t getFrameSize() const { return frameSize; }
+    bool isPersistent() const { return persistent; }
+    // Frames that had to wait for the GPU to release their region
+    unsigned int getWaitCount() const { return waits; }
+
+    // Required alignment of offsets bound to a uniform block
+    // (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+    static size_t getUniformOffsetAlignment();
+};
@@ -10,6 +10,12 @@ private:
 
 public:
     Texture(const std::string& imagePath, GLenum format = GL_RGB);
+    // Texture from pixels already in memory; with null pixels the storage is
+    // left undefined, to be filled with glTexSubImage2D
+    Texture(int width, int height, int channels, const void* pixels);
+    // Texture with no storage yet, whose levels the caller defines itself,
+    // e.g. with glCompressedTexImage2D
+    Texture(int width, int height, int channels);
     ~Texture();
     
     // Rule of 5 - prevent copying, allow moving
@@ -18,11 +24,18 @@ public:
     Texture(Texture&& other) noexcept;
     Texture& operator=(Texture&& other) noexcept;
 
+    // For sampling; the active texture unit is left wherever it was if the
+    // texture is already bound to slot
     void bind(unsigned int slot = 0) const;
+    // For glTex* calls, which act on the active unit: binds to that one
+    void bindForUpdate() const;
     void unbind() const;
     void setParameter(GLenum pname, GLint param);
+    void generateMipmaps();
     unsigned int getID() const { return ID; }
     int getWidth() const { return width; }
     int getHeight() const { return height; }
     int getChannels() const { return channels; }
+    // Pixel transfer format matching the channel count
+    GLenum getFormat() const;
 };
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Buffer object exposed to shaders as a samplerBuffer/usamplerBuffer, the
+// GL 3.3 way of handing shaders large arrays that do not fit in a uniform block
+class TextureBuffer {
+private:
+    unsigned int bufferID;
+    unsigned int textureID;
+    GLenum internalFormat;
+
+    void release();
+
+public:
+    TextureBuffer(GLenum internalFormat, const void* data, size_t size, GLenum usage = GL_DYNAMIC_DRAW);
+    ~TextureBuffer();
+
+    // Rule of 5 - prevent copying, allow moving
+    TextureBuffer(const TextureBuffer&) = delete;
+    TextureBuffer& operator=(const TextureBuffer&) = delete;
+    TextureBuffer(TextureBuffer&& other) noexcept;
+    TextureBuffer& operator=(TextureBuffer&& other) noexcept;
+
+    void bind(unsigned int slot) const;
+    // Reallocates the buffer storage; the texture view follows automatically
+    void setData(const void* data, size_t size, GLenum usage = GL_DYNAMIC_DRAW);
+    unsigned int getBufferID() const { return bufferID; }
+    unsigned int getTextureID() const { return textureID; }
+};
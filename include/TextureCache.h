@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include <glad/glad.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// On-disk layout of a cache entry: header, level table, then the level data
+// at 16 byte aligned offsets. Rows are bottom-up, ready for glTexImage2D.
+struct TextureFileHeader {
+    char magic[4]; // "OGLT"
+    uint32_t version;
+    uint64_t sourceHash; // FNV-1a of the source image file
+    uint32_t format;     // BlockFormat
+    uint32_t channels;   // of the uncompressed data
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t compressRequested; // TextureCache setting the entry was built with
+};
+static_assert(sizeof(TextureFileHeader) == 40, "cache files are read straight from the mapping");
+
+struct TextureFileLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+static_assert(sizeof(TextureFileLevel) == 24, "cache files are read straight from the mapping");
+
+// A full mip chain mapped from a cache file
+class CachedTexture {
+private:
+    MappedFile file;
+    const TextureFileHeader* header;
+    const TextureFileLevel* levels;
+
+public:
+    CachedTexture(MappedFile&& file);
+
+    BlockFormat getFormat() const { return (BlockFormat)header->format; }
+    int getWidth() const { return (int)header->width; }
+    int getHeight() const { return (int)header->height; }
+    int getChannels() const { return (int)header->channels; }
+    int getLevelCount() const { return (int)header->levelCount; }
+    size_t getLevelSize(int level) const { return (size_t)levels[level].size; }
+
+    // Defines one mip level of the texture bound to GL_TEXTURE_2D, straight
+    // from the mapped file
+    void uploadLevel(int level) const;
+};
+
+// Converts source images into precompressed mip chains on first load and
+// memory-maps them on every load after that. Entries are named after the
+// source path and record a hash of the source contents, so an edited image
+// is rebuilt the next time it is loaded.
+class TextureCache {
+private:
+    std::string directory;
+    bool compress;
+    bool s3tcSupported;
+
+    std::string entryPath(const std::string& imagePath) const;
+    bool build(const MappedFile& source, const std::string& cachePath, uint64_t sourceHash) const;
+
+public:
+    // Must be constructed with a current GL context to check for S3TC support;
+    // with compress false, or without S3TC for colour images, the mip chain
+    // is stored uncompressed
+    explicit TextureCache(std::string directory = "texcache", bool compress = true);
+
+    // Safe to call from any thread. Returns null if the source image cannot
+    // be read.
+    std::unique_ptr<CachedTexture> load(const std::string& imagePath) const;
+
+    const std::string& getDirectory() const { return directory; }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Texture.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TextureLoaderStats {
+    unsigned int requested = 0;
+    unsigned int resident = 0;
+    unsigned int failed = 0;
+    size_t bytesUploaded = 0;
+};
+
+// Decodes images on a thread pool and streams them to the GPU through pixel
+// buffer objects, a few megabytes per frame. load() returns at once with a
+// 1x1 grey placeholder; once every row of the image has been uploaded the
+// real texture is swapped into the same Texture object.
+//
+// With a TextureCache the workers map precompressed mip chains instead, and
+// those are uploaded a level at a time straight from the mapping.
+//
+// load(), update() and finish() must be called from the thread that owns the
+// GL context. The pool and the cache must outlive the loader.
+class TextureLoader {
+private:
+    // Written by a worker, read by the GL thread once done is set
+    struct Decode {
+        std::string path;
+        int width = 0, height = 0, channels = 0;
+        unsigned char* pixels = nullptr;
+        std::unique_ptr<CachedTexture> cached; // instead of pixels
+        bool done = false; // guarded by TextureLoader::mutex
+
+        ~Decode();
+    };
+
+    struct Job {
+        std::shared_ptr<Texture> texture;
+        std::shared_ptr<Decode> decode;
+        std::unique_ptr<Texture> staging; // created when the upload starts
+        int nextRow = 0;   // uncompressed
+        int nextLevel = 0; // cached
+        bool failed = false;
+    };
+
+    static constexpr int PBO_COUNT = 3;
+
+    ThreadPool& pool;
+    const TextureCache* cache;
+    size_t uploadBudget;
+
+    std::mutex mutex;
+    std::condition_variable decoded;
+    unsigned int decodesInFlight; // guarded by mutex
+
+    // GL thread only
+    std::vector<Job> decoding;
+    std::deque<Job> uploads;
+    unsigned int pbos[PBO_COUNT];
+    unsigned int nextPbo;
+    TextureLoaderStats stats;
+
+    void collectDecoded();
+    void upload(size_t budget);
+    // Each uploads part of the front job and returns the bytes it took
+    size_t uploadRows(Job& job, size_t budget);
+    size_t uploadLevel(Job& job);
+
+public:
+    // uploadBudget is the number of bytes update() streams per call; an image
+    // row that does not fit is still uploaded so every call makes progress
+    explicit TextureLoader(ThreadPool& pool, const TextureCache* cache = nullptr, size_t uploadBudget = 4 << 20);
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    std::shared_ptr<Texture> load(const std::string& imagePath);
+
+    // Call once per frame: moves finished decodes into the upload queue and
+    // streams up to uploadBudget bytes of them
+    void update();
+    // Blocks until every requested texture is resident (or failed)
+    void finish();
+
+    bool isIdle() const { return decoding.empty() && uploads.empty(); }
+    const TextureLoaderStats& getStats() const { return stats; }
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// Move-only void() callable for jobs. Callables up to INLINE_SIZE bytes,
+// which covers lambdas capturing a few pointers, are stored in place, so
+// queuing a job does not allocate; bigger ones go to the heap.
+class JobFunction {
+private:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    void (*invoke)(void* storage);
+    // Moves the callable into to and destroys it in from; with a null to
+    // it only destroys
+    void (*manage)(void* from, void* to);
+
+public:
+    JobFunction() : invoke(nullptr), manage(nullptr) {}
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, JobFunction>>>
+    JobFunction(F&& f) {
+        using T = std::decay_t<F>;
+        if constexpr (sizeof(T) <= INLINE_SIZE && alignof(T) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<T>) {
+            new (storage) T(std::forward<F>(f));
+            invoke = [](void* p) { (*(T*)p)(); };
+            manage = [](void* from, void* to) {
+                if (to) {
+                    new (to) T(std::move(*(T*)from));
+                }
+                ((T*)from)->~T();
+            };
+        } else {
+            *(T**)storage = new T(std::forward<F>(f));
+            invoke = [](void* p) { (**(T**)p)(); };
+            manage = [](void* from, void* to) {
+                if (to) {
+                    *(T**)to = *(T**)from;
+                } else {
+                    delete *(T**)from;
+                }
+            };
+        }
+    }
+
+    JobFunction(JobFunction&& other) noexcept : invoke(other.invoke), manage(other.manage) {
+        if (invoke) {
+            manage(other.storage, storage);
+            other.invoke = nullptr;
+        }
+    }
+
+    JobFunction& operator=(JobFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            invoke = other.invoke;
+            manage = other.manage;
+            if (invoke) {
+                manage(other.storage, storage);
+                other.invoke = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~JobFunction() { reset(); }
+
+    void reset() {
+        if (invoke) {
+            manage(storage, nullptr);
+            invoke = nullptr;
+        }
+    }
+
+    void operator()() { invoke(storage); }
+    explicit operator bool() const { return invoke != nullptr; }
+};
+
+// Non-owning reference to a void(size_t begin, size_t end) callable, for
+// parallelFor(): it only has to outlive the call, so nothing is copied
+class RangeFunction {
+private:
+    const void* object;
+    void (*invoke)(const void* object, size_t begin, size_t end);
+
+public:
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, RangeFunction>>>
+    RangeFunction(const F& f)
+        : object(&f), invoke([](const void* p, size_t begin, size_t end) { (*(const F*)p)(begin, end); }) {}
+
+    void operator()(size_t begin, size_t end) const { invoke(object, begin, end); }
+};
+
+// Jobs submitted with it that have not finished yet. Waiting on a counter
+// keeps the thread running other jobs instead of blocking it, and jobs can
+// be chained to run once a counter drops to zero. A counter may be reused
+// once it has been waited for, and has to outlive the wait.
+class JobCounter {
+private:
+    friend class ThreadPool;
+    struct Continuation {
+        JobFunction task;
+        JobCounter* counter;
+    };
+
+    std::atomic<size_t> pending{0};
+    std::mutex mutex;
+    std::vector<Continuation> continuations;
+
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Work-stealing job system. Every worker owns a deque: jobs it submits go
+// to the back of its own, where it takes them from again, newest first, so
+// a job's children tend to run on the core that has their data in cache;
+// idle workers steal the oldest jobs from the front of the others. Threads
+// outside the pool share one more deque.
+//
+// Background jobs (texture decoding and the like) sit in a FIFO of their
+// own that only idle workers take from, so a frame never waits behind one.
+class ThreadPool {
+private:
+    struct Job {
+        JobFunction task;
+        JobCounter* counter = nullptr;
+    };
+    // Ring buffer of jobs; it grows when full and never shrinks, so once it
+    // has seen a frame's worth of jobs it stops allocating
+    struct WorkQueue {
+        std::mutex mutex;
+        std::vector<Job> jobs;
+        size_t first = 0;
+        size_t count = 0;
+
+        void pushBack(Job&& job);
+        bool popBack(Job& job);
+        bool popFront(Job& job);
+    };
+
+    std::vector<std::thread> workers;
+    // One per worker, then the one shared by outside threads
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    WorkQueue background;
+    std::atomic<size_t> queuedJobs;
+    std::atomic<size_t> queuedBackground;
+    // Idle workers and waits with nothing left to run sleep here
+    std::mutex sleepMutex;
+    std::condition_variable available;
+    std::atomic<unsigned int> sleepers;
+    std::atomic<bool> stopping;
+
+    size_t homeQueue() const;
+    void push(Job job);
+    bool popJob(size_t home, bool allowBackground, Job& job);
+    void runJob(Job& job);
+    void finishJob(JobCounter* counter);
+    void wakeSleepers(bool all);
+    void workerLoop(size_t index);
+
+public:
+    // threadCount counts the calling thread too, so 1 means "run inline"
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int getThreadCount() const { return (unsigned int)workers.size() + 1; }
+
+    // Queues a job, counted by counter if there is one; runs inline if the
+    // pool has no workers
+    void submit(JobFunction task, JobCounter* counter = nullptr);
+    // Queues a job once every job counted by dependency has finished; it is
+    // counted by counter right away
+    void submitAfter(JobCounter& dependency, JobFunction task, JobCounter* counter = nullptr);
+    // Queues a job that may take a while and nothing in the frame waits for
+    void submitBackground(JobFunction task);
+
+    // Runs other jobs until every job counted by counter has finished
+    void wait(JobCounter& counter);
+
+    // Calls fn(begin, end) over [0, count) in chunks of at most grainSize,
+    // spread across the workers and the calling thread. Returns once every
+    // chunk has run; safe to call from inside a job.
+    void parallelFor(size_t count, size_t grainSize, RangeFunction fn);
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ShadowMaps.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// CPU mirrors of the std140 uniform blocks declared in shaders/. std140 pads
+// a vec3 to 16 bytes unless a scalar follows it, so every vec3 below is
+// paired with a float (or explicit padding) and structs are 16-byte aligned.
+// Keep the member order in sync with the GLSL declarations.
+
+// Uniform block binding points shared by every program
+enum UniformBinding : unsigned int {
+    CAMERA_BINDING = 0,
+    LIGHTS_BINDING = 1,
+    SHADOWS_BINDING = 2
+};
+
+namespace std140 {
+
+// Rounds an offset up to the next multiple of alignment
+inline size_t alignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// GLSL bool is 4 bytes in std140
+using Bool = int32_t;
+
+} // namespace std140
+
+// layout(std140) uniform Camera
+struct alignas(16) CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float pad0;
+};
+
+struct alignas(16) DirLightStd140 {
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct alignas(16) SpotLightStd140 {
+    glm::vec3 spotDir;
+    float phi;
+    glm::vec3 ambient;
+    float phiOuter;
+    glm::vec3 diffuse;
+    std140::Bool enabled;
+    glm::vec3 specular;
+    float pad0;
+};
+
+// layout(std140) uniform Lights. Point lights are not part of the block;
+// they live in texture buffers indexed through the light clusters
+// (see include/LightClusters.h).
+struct alignas(16) LightsBlock {
+    DirLightStd140 dirLight;
+    SpotLightStd140 spotLight;
+    glm::uvec4 clusterDims;   // tiles x, tiles y, depth slices, point light count
+    glm::vec4 clusterParams;  // zScale, zBias, tiles x / width, tiles y / height
+};
+
+// layout(std140) uniform Shadows, see include/ShadowMaps.h
+struct alignas(16) ShadowsBlock {
+    glm::mat4 cascadeMatrices[CascadedShadowMaps::CASCADE_COUNT]; // world to each cascade's clip space
+    glm::vec4 cascadeSplits;                                      // view depth where each cascade ends
+    glm::vec4 cascadeTexelSizes;                                  // world-space texel size of each cascade
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock does not match std140");
+static_assert(offsetof(LightsBlock, spotLight) == 64, "LightsBlock does not match std140");
+static_assert(offsetof(LightsBlock, clusterDims) == 128, "LightsBlock does not match std140");
+static_assert(sizeof(LightsBlock) == 160, "LightsBlock does not match std140");
+static_assert(CascadedShadowMaps::CASCADE_COUNT == 4, "cascadeSplits and cascadeTexelSizes hold one cascade per lane");
+static_assert(sizeof(ShadowsBlock) == 288, "ShadowsBlock does not match std140");
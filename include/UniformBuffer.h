@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+class UniformBuffer {
+private:
+    unsigned int ID;
+    size_t size;
+
+public:
+    UniformBuffer(const void* data, size_t size, GLenum usage = GL_DYNAMIC_DRAW);
+    ~UniformBuffer();
+
+    // Rule of 5 - prevent copying, allow moving
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    UniformBuffer(UniformBuffer&& other) noexcept;
+    UniformBuffer& operator=(UniformBuffer&& other) noexcept;
+
+    void bind() const;
+    void unbind() const;
+    void setData(const void* data, size_t size, GLenum usage = GL_DYNAMIC_DRAW);
+    void setSubData(size_t offset, const void* data, size_t size);
+
+    // Attach the whole buffer, or a range of it, to a uniform block binding point
+    void bindBase(unsigned int binding) const;
+    void bindRange(unsigned int binding, size_t offset, size_t size) const;
+
+    unsigned int getID() const { return ID; }
+    size_t getSize() const { return size; }
+
+    // Required alignment of bindRange offsets (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+    static size_t getOffsetAlignment();
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MeshVertex;
+
+// How each vertex attribute is stored in a vertex buffer. Every encoding maps
+// onto attributes 0 (position), 1 (normal) and 2 (texcoords) of the object
+// shaders, which decode them in shaders/vertex.glsl and
+// shaders/instanced.vertex.glsl.
+enum class PositionEncoding : uint8_t {
+    Float,  // 3 x float, 12 bytes
+    Half,   // 3 x half + padding, 8 bytes; exact for small integer-ish coordinates
+    Snorm16 // 3 x 16-bit normalized over the mesh bounds + padding, 8 bytes
+};
+
+enum class NormalEncoding : uint8_t {
+    Float,     // 3 x float, 12 bytes
+    Octahedral // octahedral map as 2 x 16-bit normalized, 4 bytes
+};
+
+enum class TexCoordEncoding : uint8_t {
+    Float, // 2 x float, 8 bytes
+    Half   // 2 x half, 4 bytes
+};
+
+struct VertexFormat {
+    PositionEncoding position = PositionEncoding::Float;
+    NormalEncoding normal = NormalEncoding::Float;
+    TexCoordEncoding texCoords = TexCoordEncoding::Float;
+
+    size_t getStride() const;
+    bool operator==(const VertexFormat& other) const {
+        return position == other.position && normal == other.normal && texCoords == other.texCoords;
+    }
+};
+
+// Byte for byte the MeshVertex layout, 32 bytes
+const VertexFormat FLOAT_VERTEX_FORMAT = {PositionEncoding::Float, NormalEncoding::Float, TexCoordEncoding::Float};
+// 16 bytes; needs the position transform of its VertexEncoding
+const VertexFormat COMPACT_VERTEX_FORMAT = {PositionEncoding::Snorm16, NormalEncoding::Octahedral,
+                                            TexCoordEncoding::Half};
+
+// A vertex buffer's format plus what it takes to undo the position
+// quantization: decoded = encoded * positionScale + positionOffset
+struct VertexEncoding {
+    VertexFormat format;
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+
+    // Fold into the model matrix, so shaders need no extra uniforms. Normals
+    // are unaffected and keep the model's normal matrix.
+    glm::mat4 getPositionTransform() const;
+};
+
+// Encodes vertices into out (resized to count * stride). With SSE2 four
+// vertices are converted per iteration in structure-of-arrays form.
+VertexEncoding encodeVertices(const MeshVertex* vertices, size_t count, const VertexFormat& format,
+                              std::vector<uint8_t>& out);
+
+// CPU inverse of encodeVertices(), for checking the precision of a format
+void decodeVertices(const void* data, size_t count, const VertexEncoding& encoding, MeshVertex* out);
+
+// Points attributes 0-2 at the buffer bound to GL_ARRAY_BUFFER, in the
+// current vertex array
+void setVertexAttributes(const VertexFormat& format);
@@ -0,0 +1,156 @@
+#version 330 core
+// Deferred lighting, full-screen pass: directional light and spotlight for
+// every covered pixel. Also restores the scene depth from the G-buffer so
+// the light volumes and forward-drawn light cubes can depth test against it.
+// DIR_LIGHT and SPOT_LIGHT select the lights, DIR_SHADOW shadows the
+// directional light (see include/ShaderVariants.h).
+
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 spotDir;
+    float phi;
+
+    vec3 ambient;
+    float phiOuter;
+    vec3 diffuse;
+    bool enabled; // unused, SPOT_LIGHT decides
+    vec3 specular;
+};
+
+layout(std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    uvec4 clusterDims;
+    vec4 clusterParams;
+};
+
+#ifdef DIR_SHADOW
+// Cascaded shadow maps of the directional light (see include/ShadowMaps.h);
+// SHADOW_CASCADES is injected with DIR_SHADOW
+layout(std140) uniform Shadows {
+    mat4 cascadeMatrices[SHADOW_CASCADES]; // world to each cascade's clip space
+    vec4 cascadeSplits;                    // view depth where each cascade ends
+    vec4 cascadeTexelSizes;                // world-space texel size of each cascade
+};
+
+uniform sampler2DArrayShadow shadowMap;
+#endif
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+uniform float shininess;
+
+out vec4 FragColor;
+
+float CalcDirShadow(vec3 normal, vec3 lightDir, vec3 fragPos);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMap, float shadow);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMap);
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, coord, 0).r;
+    // nothing was drawn here, keep the clear color
+    if (depth == 1.0)
+        discard;
+
+    vec3 fragPos = texelFetch(gPosition, coord, 0).rgb;
+    vec3 norm = texelFetch(gNormal, coord, 0).rgb;
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, coord, 0);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = vec3(0.0);
+#ifdef DIR_LIGHT
+    float shadow = CalcDirShadow(norm, normalize(-dirLight.direction), fragPos);
+    result += CalcDirLight(dirLight, norm, viewDir, albedoSpec.rgb, albedoSpec.a, shadow);
+#endif
+#ifdef SPOT_LIGHT
+    result += CalcSpotLight(spotLight, norm, viewDir, albedoSpec.rgb, albedoSpec.a);
+#endif
+
+    FragColor = vec4(result, 1.0);
+    gl_FragDepth = depth;
+}
+
+float CalcDirShadow(vec3 normal, vec3 lightDir, vec3 fragPos)
+{
+#ifdef DIR_SHADOW
+    // first cascade whose slice reaches past this fragment
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = int(dot(vec4(greaterThan(vec4(depth), cascadeSplits)), vec4(1.0)));
+    if (cascade >= SHADOW_CASCADES)
+        return 1.0;
+    // look up from a little above the surface, more so where the light
+    // grazes it, so surfaces do not shadow themselves
+    float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 offsetPos = fragPos + normal * (cascadeTexelSizes[cascade] * 1.5 * slope);
+    // orthographic, so w is 1
+    vec3 coords = (cascadeMatrices[cascade] * vec4(offsetPos, 1.0)).xyz * 0.5 + 0.5;
+    // the comparison sampler filters the 2x2 results
+    return texture(shadowMap, vec4(coords.xy, float(cascade), coords.z));
+#else
+    return 1.0;
+#endif
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMap, float shadow)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMap;
+    // shadow leaves the ambient term alone
+    return (ambient + shadow * (diffuse + specular));
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMap)
+{
+    float theta = dot(viewDir, normalize(-light.spotDir));
+
+    vec3 ambient = vec3(0.0);
+    vec3 diffuse = vec3(0.0);
+    vec3 specular = vec3(0.0);
+
+    if (theta > light.phiOuter) {
+        // diffuse shading
+        float diff = max(dot(normal, viewDir), 0.0);
+        // specular shading
+        vec3 reflectDir = reflect(-viewDir, normal);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+        // combine results
+        ambient = light.ambient * albedo;
+        diffuse = light.diffuse * diff * albedo;
+        specular = light.specular * spec * specularMap;
+
+        // Scale for smoothing
+        float epsilon = light.phi - light.phiOuter;
+        float intensity = clamp((theta - light.phiOuter) / epsilon, 0.0, 1.0);
+
+        ambient *= intensity;
+        diffuse *= intensity;
+        specular *= intensity;
+    }
+
+    return (ambient + diffuse + specular);
+}
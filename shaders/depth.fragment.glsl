@@ -0,0 +1,7 @@
+#version 330 core
+// Shadow casters (see include/ShadowMaps.h): only the depth written by the
+// fixed-function stages is kept, so there is no material work to do
+
+void main()
+{
+}
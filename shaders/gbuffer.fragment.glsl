@@ -0,0 +1,60 @@
+#version 330 core
+// Geometry pass of the deferred path: writes surface attributes to the
+// G-buffer (see include/GBuffer.h), lighting happens in later passes.
+// DIFFUSE_MAP, SPECULAR_MAP and NORMAL_MAP as in object.fragment.glsl.
+layout(location = 0) out vec3 gPosition;
+layout(location = 1) out vec3 gNormal;
+layout(location = 2) out vec4 gAlbedoSpec;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    sampler2D normal;
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float shininess;
+};
+
+uniform Material material;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+vec3 PerturbNormal(vec3 normal);
+
+void main()
+{
+    gPosition = FragPos;
+    gNormal = PerturbNormal(normalize(Normal));
+#ifdef DIFFUSE_MAP
+    gAlbedoSpec.rgb = texture(material.diffuse, TexCoords).rgb;
+#else
+    gAlbedoSpec.rgb = material.diffuseColor;
+#endif
+#ifdef SPECULAR_MAP
+    gAlbedoSpec.a = texture(material.specular, TexCoords).r;
+#else
+    gAlbedoSpec.a = material.specularColor.r;
+#endif
+}
+
+vec3 PerturbNormal(vec3 normal)
+{
+#ifdef NORMAL_MAP
+    // Same derivative tangent frame as object.fragment.glsl
+    vec3 dp1 = dFdx(FragPos);
+    vec3 dp2 = dFdy(FragPos);
+    vec2 duv1 = dFdx(TexCoords);
+    vec2 duv2 = dFdy(TexCoords);
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+    float scale = inversesqrt(max(max(dot(tangent, tangent), dot(bitangent, bitangent)), 1e-20));
+    vec3 mapped = texture(material.normal, TexCoords).xyz * 2.0 - 1.0;
+    return normalize(mat3(tangent * scale, bitangent * scale, normal) * mapped);
+#else
+    return normal;
+#endif
+}
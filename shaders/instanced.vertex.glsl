@@ -0,0 +1,39 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+// per-instance attributes (divisor 1)
+layout(location = 3) in mat4 aModel;
+layout(location = 7) in mat3 aNormalMatrix;
+
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// Same vertex decoding as shaders/vertex.glsl
+uniform bool octahedralNormals = false;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+
+vec3 decodeNormal(vec3 normal)
+{
+    if (!octahedralNormals) {
+        return normal;
+    }
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+    Normal = aNormalMatrix * decodeNormal(aNormal);
+    TexCoords = aTexCoords;
+}
@@ -0,0 +1,82 @@
+#version 330 core
+// Deferred point light accumulation, additively blended over the
+// full-screen pass for the pixels covered by a light volume
+
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+struct PointLight {
+    vec3 position;
+    float radius;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+uniform samplerBuffer pointLightData;
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform float shininess;
+
+flat in int LightIndex;
+
+out vec4 FragColor;
+
+PointLight FetchPointLight(int index);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMap);
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec3 fragPos = texelFetch(gPosition, coord, 0).rgb;
+    PointLight light = FetchPointLight(LightIndex);
+    if (length(light.position - fragPos) > light.radius)
+        discard;
+
+    vec3 norm = texelFetch(gNormal, coord, 0).rgb;
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, coord, 0);
+    vec3 viewDir = normalize(viewPos - fragPos);
+    FragColor = vec4(CalcPointLight(light, norm, fragPos, viewDir, albedoSpec.rgb, albedoSpec.a), 1.0);
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 t0 = texelFetch(pointLightData, index * 4);
+    vec4 t1 = texelFetch(pointLightData, index * 4 + 1);
+    vec4 t2 = texelFetch(pointLightData, index * 4 + 2);
+    vec4 t3 = texelFetch(pointLightData, index * 4 + 3);
+    return PointLight(t0.xyz, t0.w, t1.xyz, t1.w, t2.xyz, t2.w, t3.xyz, t3.w);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMap)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance +
+                light.quadratic * (distance * distance));
+    // fade to zero at the light radius, as in the forward path
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMap;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+// Deferred point light volumes: the unit cube scaled to enclose each light's
+// cutoff sphere, one instance per light
+layout(location = 0) in vec3 aPos;
+
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// four texels per light, see include/LightClusters.h
+uniform samplerBuffer pointLightData;
+
+flat out int LightIndex;
+
+void main()
+{
+    vec4 positionRadius = texelFetch(pointLightData, gl_InstanceID * 4);
+    vec3 worldPos = positionRadius.xyz + aPos * 2.0 * positionRadius.w;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+    LightIndex = gl_InstanceID;
+}
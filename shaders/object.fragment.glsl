@@ -1,12 +1,29 @@
 #version 330 core
+// Built as permutations (see include/ShaderVariants.h): the defines
+// DIR_LIGHT, POINT_LIGHTS and SPOT_LIGHT choose the lights evaluated, and
+// DIFFUSE_MAP, SPECULAR_MAP and NORMAL_MAP the material textures sampled.
+// Without a map the material color is used; without a normal map the
+// interpolated normal. DIR_SHADOW shadows the directional light.
 struct Material {
     sampler2D diffuse;
     sampler2D specular;
+    sampler2D normal;
+    vec3 diffuseColor;
+    vec3 specularColor;
     float shininess;
 };
 
 uniform Material material;
 
+// Camera and light state come from std140 uniform blocks shared across
+// programs (see include/UniformBlocks.h). vec3 members are paired with a
+// scalar to fill their 16-byte std140 slot.
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
 struct DirLight {
     vec3 direction;
 
@@ -14,38 +31,55 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };
-uniform DirLight dirLight;
 
 struct PointLight {
     vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
+    float radius;
 
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;
+    float quadratic;
 };
-#define NR_POINT_LIGHTS 4
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 
 struct SpotLight {
     vec3 spotDir;
+    float phi;
 
     vec3 ambient;
+    float phiOuter;
     vec3 diffuse;
+    bool enabled; // unused, SPOT_LIGHT decides
     vec3 specular;
+};
 
-    float phi;
-    float phiOuter;
+layout(std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    uvec4 clusterDims;   // tiles x, tiles y, depth slices, point light count
+    vec4 clusterParams;  // zScale, zBias, tiles x / width, tiles y / height
+};
 
-    bool enabled;
+#ifdef DIR_SHADOW
+// Cascaded shadow maps of the directional light (see include/ShadowMaps.h);
+// SHADOW_CASCADES is injected with DIR_SHADOW
+layout(std140) uniform Shadows {
+    mat4 cascadeMatrices[SHADOW_CASCADES]; // world to each cascade's clip space
+    vec4 cascadeSplits;                    // view depth where each cascade ends
+    vec4 cascadeTexelSizes;                // world-space texel size of each cascade
 };
 
-uniform SpotLight spotLight;
+uniform sampler2DArrayShadow shadowMap;
+#endif
 
-uniform vec3 viewPos;
+// Clustered point lights (see include/LightClusters.h): every light is four
+// texels in pointLightData, lightClusters holds an (offset, count) run into
+// lightIndices for each screen tile x depth slice
+uniform samplerBuffer pointLightData;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
 
 in vec2 TexCoords;
 in vec3 Normal;
@@ -53,31 +87,118 @@ in vec3 FragPos;
 
 out vec4 FragColor;
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+// Material colors at this fragment
+vec3 albedo;
+vec3 specularColor;
+
+int ClusterIndex();
+PointLight FetchPointLight(int index);
+vec3 PerturbNormal(vec3 normal);
+float CalcDirShadow(vec3 normal, vec3 lightDir, vec3 fragPos);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
 {
     // properties
-    vec3 norm = normalize(Normal);
+#ifdef DIFFUSE_MAP
+    albedo = vec3(texture(material.diffuse, TexCoords));
+#else
+    albedo = material.diffuseColor;
+#endif
+#ifdef SPECULAR_MAP
+    specularColor = vec3(texture(material.specular, TexCoords));
+#else
+    specularColor = material.specularColor;
+#endif
+    vec3 surfaceNormal = normalize(Normal);
+    vec3 norm = PerturbNormal(surfaceNormal);
     vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 result = vec3(0.0);
 
     // phase 1: Directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: Point lights
-    for (int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
-
-    // phase 3: Spot light
-    if (spotLight.enabled == true) {
-        result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#ifdef DIR_LIGHT
+    float shadow = CalcDirShadow(surfaceNormal, normalize(-dirLight.direction), FragPos);
+    result += CalcDirLight(dirLight, norm, viewDir, shadow);
+#endif
+    // phase 2: Point lights of this fragment's cluster
+#ifdef POINT_LIGHTS
+    uvec2 cluster = texelFetch(lightClusters, ClusterIndex()).xy;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int index = int(texelFetch(lightIndices, int(cluster.x + i)).x);
+        result += CalcPointLight(FetchPointLight(index), norm, FragPos, viewDir);
     }
+#endif
+    // phase 3: Spot light
+#ifdef SPOT_LIGHT
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#endif
 
     FragColor = vec4(result, 1.0);
 }
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 PerturbNormal(vec3 normal)
+{
+#ifdef NORMAL_MAP
+    // Tangent frame from screen-space derivatives, so meshes need no
+    // tangent attribute
+    vec3 dp1 = dFdx(FragPos);
+    vec3 dp2 = dFdy(FragPos);
+    vec2 duv1 = dFdx(TexCoords);
+    vec2 duv2 = dFdy(TexCoords);
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+    float scale = inversesqrt(max(max(dot(tangent, tangent), dot(bitangent, bitangent)), 1e-20));
+    vec3 mapped = texture(material.normal, TexCoords).xyz * 2.0 - 1.0;
+    return normalize(mat3(tangent * scale, bitangent * scale, normal) * mapped);
+#else
+    return normal;
+#endif
+}
+
+int ClusterIndex()
+{
+    // depth slices are exponential: slice = log(depth) * zScale + zBias
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    float slice = clamp(log(depth) * clusterParams.x + clusterParams.y, 0.0, float(clusterDims.z - 1u));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterParams.zw), clusterDims.xy - 1u);
+    return int((uint(slice) * clusterDims.y + tile.y) * clusterDims.x + tile.x);
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 t0 = texelFetch(pointLightData, index * 4);
+    vec4 t1 = texelFetch(pointLightData, index * 4 + 1);
+    vec4 t2 = texelFetch(pointLightData, index * 4 + 2);
+    vec4 t3 = texelFetch(pointLightData, index * 4 + 3);
+    return PointLight(t0.xyz, t0.w, t1.xyz, t1.w, t2.xyz, t2.w, t3.xyz, t3.w);
+}
+
+float CalcDirShadow(vec3 normal, vec3 lightDir, vec3 fragPos)
+{
+#ifdef DIR_SHADOW
+    // first cascade whose slice reaches past this fragment
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = int(dot(vec4(greaterThan(vec4(depth), cascadeSplits)), vec4(1.0)));
+    if (cascade >= SHADOW_CASCADES)
+        return 1.0;
+    // look up from a little above the surface, more so where the light
+    // grazes it, so surfaces do not shadow themselves
+    float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 offsetPos = fragPos + normal * (cascadeTexelSizes[cascade] * 1.5 * slope);
+    // orthographic, so w is 1
+    vec3 coords = (cascadeMatrices[cascade] * vec4(offsetPos, 1.0)).xyz * 0.5 + 0.5;
+    // the comparison sampler filters the 2x2 results
+    return texture(shadowMap, vec4(coords.xy, float(cascade), coords.z));
+#else
+    return 1.0;
+#endif
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
@@ -86,10 +207,11 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    // shadow leaves the ambient term alone
+    return (ambient + shadow * (diffuse + specular));
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -104,10 +226,13 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance +
                 light.quadratic * (distance * distance));
+    // fade to zero at the cluster radius so the cutoff leaves no seams
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -129,9 +254,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
         vec3 reflectDir = reflect(-viewDir, normal);
         float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
         // combine results
-        ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-        diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-        specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+        ambient = light.ambient * albedo;
+        diffuse = light.diffuse * diff * albedo;
+        specular = light.specular * spec * specularColor;
 
         // Scale for smoothing
         float epsilon = light.phi - light.phiOuter;
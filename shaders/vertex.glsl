@@ -3,18 +3,41 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
 
-uniform mat4 view;
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
 uniform mat4 model;
-uniform mat4 projection;
+// inverse-transpose of model, computed once per object on the CPU
+uniform mat3 normalMatrix;
+
+// Normals arrive as (x, y, 0) octahedral coordinates instead of vectors;
+// see include/VertexFormat.h. Positions need no decoding here: half floats
+// and normalized shorts are expanded by the vertex fetch, and the snorm
+// dequantization is folded into the model matrix.
+uniform bool octahedralNormals = false;
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
+vec3 decodeNormal(vec3 normal)
+{
+    if (!octahedralNormals) {
+        return normal;
+    }
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * decodeNormal(aNormal);
     TexCoords = aTexCoords;
 }
@@ -0,0 +1,204 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+struct Block {
+    unsigned char texels[16][4];
+};
+
+Block fetchBlock(const unsigned char* pixels, int width, int height, int channels, int blockX, int blockY) {
+    Block block;
+    for (int y = 0; y < 4; y++) {
+        int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int sx = std::min(blockX * 4 + x, width - 1);
+            const unsigned char* src = pixels + ((size_t)sy * width + sx) * channels;
+            unsigned char* dst = block.texels[y * 4 + x];
+            for (int c = 0; c < 4; c++) {
+                dst[c] = c < channels ? src[c] : (c == 3 ? 255 : 0);
+            }
+        }
+    }
+    return block;
+}
+
+void writeLE(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+uint16_t packRGB565(const float color[3]) {
+    int r = std::clamp((int)std::lround(color[0] * 31.0f / 255.0f), 0, 31);
+    int g = std::clamp((int)std::lround(color[1] * 63.0f / 255.0f), 0, 63);
+    int b = std::clamp((int)std::lround(color[2] * 31.0f / 255.0f), 0, 31);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints are the extremes of the texels along their principal axis, which
+// keeps gradients that run diagonally through RGB space intact
+void encodeColorBlock(const Block& block, unsigned char* out) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (const auto& texel : block.texels) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += texel[c] / 16.0f;
+        }
+    }
+    float covariance[6] = {}; // rr rg rb gg gb bb
+    for (const auto& texel : block.texels) {
+        float d[3] = {texel[0] - mean[0], texel[1] - mean[1], texel[2] - mean[2]};
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+    // A few power iterations are plenty for a 3x3 matrix
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int i = 0; i < 4; i++) {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        float length = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2])});
+        if (length < 1e-6f) {
+            break;
+        }
+        for (int c = 0; c < 3; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float minProjection = INFINITY, maxProjection = -INFINITY;
+    for (const auto& texel : block.texels) {
+        float projection = (texel[0] - mean[0]) * axis[0] + (texel[1] - mean[1]) * axis[1] +
+                           (texel[2] - mean[2]) * axis[2];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float axisLengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++) {
+        high[c] = mean[c] + axis[c] * maxProjection / axisLengthSq;
+        low[c] = mean[c] + axis[c] * minProjection / axisLengthSq;
+    }
+
+    // color0 > color1 selects the opaque four color mode
+    uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int error = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = block.texels[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    writeLE(out, color0, 2);
+    writeLE(out + 2, color1, 2);
+    writeLE(out + 4, indices, 4);
+}
+
+// BC4 block of one channel, used for BC3 alpha and both BC5 channels
+void encodeChannelBlock(const Block& block, int channel, unsigned char* out) {
+    int low = 255, high = 0;
+    for (const auto& texel : block.texels) {
+        low = std::min(low, (int)texel[channel]);
+        high = std::max(high, (int)texel[channel]);
+    }
+    uint64_t indices = 0;
+    if (high != low) {
+        // alpha0 > alpha1 selects eight interpolated values
+        int palette[8] = {high, low};
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * high + i * low) / 7;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = 256;
+            for (int p = 0; p < 8; p++) {
+                int error = std::abs(block.texels[i][channel] - palette[p]);
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    out[0] = (unsigned char)high;
+    out[1] = (unsigned char)low;
+    writeLE(out + 2, indices, 6);
+}
+
+size_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+} // namespace
+
+size_t blockCompressedSize(BlockFormat format, int width, int height, int channels) {
+    if (format == BlockFormat::None) {
+        return (size_t)width * height * channels;
+    }
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+void compressBlocks(BlockFormat format, const unsigned char* pixels, int width, int height, int channels,
+                    unsigned char* out) {
+    if (format == BlockFormat::None) {
+        std::memcpy(out, pixels, blockCompressedSize(format, width, height, channels));
+        return;
+    }
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            Block block = fetchBlock(pixels, width, height, channels, bx, by);
+            switch (format) {
+            case BlockFormat::BC1:
+                encodeColorBlock(block, out);
+                break;
+            case BlockFormat::BC3:
+                encodeChannelBlock(block, 3, out);
+                encodeColorBlock(block, out + 8);
+                break;
+            case BlockFormat::BC5:
+                encodeChannelBlock(block, 0, out);
+                encodeChannelBlock(block, 1, out + 8);
+                break;
+            case BlockFormat::None:
+                break;
+            }
+            out += blockBytes(format);
+        }
+    }
+}
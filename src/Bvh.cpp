@@ -0,0 +1,252 @@
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Partially visible subtrees handed out per thread, so that uneven ones
+// even out
+const size_t TASKS_PER_THREAD = 8;
+
+// Frustum planes broadcast once per cull
+struct CullPlanes {
+    glm::vec4 planes[6];
+#ifdef BVH_SSE
+    __m128 x[6], y[6], z[6], w[6];
+#endif
+
+    explicit CullPlanes(const Frustum& frustum) {
+        for (int p = 0; p < 6; p++) {
+            planes[p] = frustum.planes[p];
+#ifdef BVH_SSE
+            x[p] = _mm_set1_ps(planes[p].x);
+            y[p] = _mm_set1_ps(planes[p].y);
+            z[p] = _mm_set1_ps(planes[p].z);
+            w[p] = _mm_set1_ps(planes[p].w);
+#endif
+        }
+    }
+};
+
+// Classifies the four children of node: objects and children entirely inside
+// the frustum go to visible, partially visible subtrees to next
+void visitNode(const BvhNode& node, const CullPlanes& planes, const uint32_t* objectOrder,
+               std::vector<uint32_t>& visible, std::vector<uint32_t>& next) {
+    int visibleMask = 0;
+    int partialMask = 0;
+
+#ifdef BVH_SSE
+    __m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+    __m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+    __m128 outside = _mm_setzero_ps();
+    __m128 partial = _mm_setzero_ps();
+    for (int p = 0; p < 6; p++) {
+        // The plane is the same for all four boxes, so its corner choice is
+        // too: the one furthest along the normal decides "outside", the
+        // nearest one "fully inside"
+        const glm::vec4& plane = planes.planes[p];
+        __m128 farX = plane.x >= 0.0f ? maxX : minX, nearX = plane.x >= 0.0f ? minX : maxX;
+        __m128 farY = plane.y >= 0.0f ? maxY : minY, nearY = plane.y >= 0.0f ? minY : maxY;
+        __m128 farZ = plane.z >= 0.0f ? maxZ : minZ, nearZ = plane.z >= 0.0f ? minZ : maxZ;
+        __m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], farX), _mm_mul_ps(planes.y[p], farY)),
+                                        _mm_add_ps(_mm_mul_ps(planes.z[p], farZ), planes.w[p]));
+        __m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], nearX), _mm_mul_ps(planes.y[p], nearY)),
+                                         _mm_add_ps(_mm_mul_ps(planes.z[p], nearZ), planes.w[p]));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, _mm_setzero_ps()));
+        partial = _mm_or_ps(partial, _mm_cmplt_ps(nearDistance, _mm_setzero_ps()));
+    }
+    visibleMask = ~_mm_movemask_ps(outside) & 0xf;
+    partialMask = _mm_movemask_ps(partial);
+#else
+    for (int k = 0; k < 4; k++) {
+        bool outside = false, partial = false;
+        for (const glm::vec4& plane : planes.planes) {
+            float farDistance = plane.x * (plane.x >= 0.0f ? node.maxX[k] : node.minX[k]) +
+                                plane.y * (plane.y >= 0.0f ? node.maxY[k] : node.minY[k]) +
+                                plane.z * (plane.z >= 0.0f ? node.maxZ[k] : node.minZ[k]) + plane.w;
+            float nearDistance = plane.x * (plane.x >= 0.0f ? node.minX[k] : node.maxX[k]) +
+                                 plane.y * (plane.y >= 0.0f ? node.minY[k] : node.maxY[k]) +
+                                 plane.z * (plane.z >= 0.0f ? node.minZ[k] : node.maxZ[k]) + plane.w;
+            outside |= farDistance < 0.0f;
+            partial |= nearDistance < 0.0f;
+        }
+        visibleMask |= (!outside) << k;
+        partialMask |= partial << k;
+    }
+#endif
+
+    for (int k = 0; k < 4; k++) {
+        if (!(visibleMask & (1 << k)) || node.count[k] == 0) {
+            continue;
+        }
+        if (node.child[k] >= 0 && (partialMask & (1 << k))) {
+            next.push_back((uint32_t)node.child[k]);
+        } else {
+            visible.insert(visible.end(), objectOrder + node.first[k], objectOrder + node.first[k] + node.count[k]);
+        }
+    }
+}
+
+void traverse(const std::vector<BvhNode>& nodes, const CullPlanes& planes, const uint32_t* objectOrder,
+              std::vector<uint32_t>& stack, std::vector<uint32_t>& visible) {
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        visitNode(nodes[index], planes, objectOrder, visible, stack);
+    }
+}
+
+// Objects are partitioned by value rather than through an index array, so
+// the median splits stay in cache
+struct BuildItem {
+    Aabb box;
+    uint32_t object;
+};
+
+// Median split of items[begin, end) along the widest axis of the box centers
+uint32_t split(BuildItem* items, uint32_t begin, uint32_t end) {
+    glm::vec3 lower = items[begin].box.min + items[begin].box.max, upper = lower;
+    for (uint32_t i = begin + 1; i < end; i++) {
+        glm::vec3 center = items[i].box.min + items[i].box.max;
+        lower = glm::min(lower, center);
+        upper = glm::max(upper, center);
+    }
+    glm::vec3 extent = upper - lower;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(items + begin, items + middle, items + end, [axis](const BuildItem& a, const BuildItem& b) {
+        return a.box.min[axis] + a.box.max[axis] < b.box.min[axis] + b.box.max[axis];
+    });
+    return middle;
+}
+
+void buildNode(std::vector<BvhNode>& nodes, uint32_t nodeIndex, BuildItem* items, uint32_t begin, uint32_t end) {
+    // Up to four objects become children directly; larger ranges are split
+    // in two, twice
+    uint32_t ranges[5];
+    uint32_t rangeCount;
+    if (end - begin <= 4) {
+        rangeCount = end - begin;
+        for (uint32_t k = 0; k <= rangeCount; k++) {
+            ranges[k] = begin + k;
+        }
+    } else {
+        uint32_t middle = split(items, begin, end);
+        ranges[0] = begin;
+        ranges[1] = split(items, begin, middle);
+        ranges[2] = middle;
+        ranges[3] = split(items, middle, end);
+        ranges[4] = end;
+        rangeCount = 4;
+    }
+
+    BvhNode node = {};
+    for (uint32_t k = 0; k < rangeCount; k++) {
+        Aabb box = items[ranges[k]].box;
+        for (uint32_t i = ranges[k] + 1; i < ranges[k + 1]; i++) {
+            box.min = glm::min(box.min, items[i].box.min);
+            box.max = glm::max(box.max, items[i].box.max);
+        }
+        node.minX[k] = box.min.x;
+        node.minY[k] = box.min.y;
+        node.minZ[k] = box.min.z;
+        node.maxX[k] = box.max.x;
+        node.maxY[k] = box.max.y;
+        node.maxZ[k] = box.max.z;
+        node.first[k] = ranges[k];
+        node.count[k] = ranges[k + 1] - ranges[k];
+        node.child[k] = -1;
+    }
+
+    // Children are appended before recursing, which may reallocate nodes
+    for (uint32_t k = 0; k < rangeCount; k++) {
+        if (node.count[k] > 1) {
+            node.child[k] = (int32_t)nodes.size();
+            nodes.emplace_back();
+        }
+    }
+    nodes[nodeIndex] = node;
+    for (uint32_t k = 0; k < rangeCount; k++) {
+        if (node.child[k] >= 0) {
+            buildNode(nodes, (uint32_t)node.child[k], items, ranges[k], ranges[k + 1]);
+        }
+    }
+}
+
+} // namespace
+
+Bvh::Bvh(ThreadPool* pool) : pool(pool) {}
+
+void Bvh::build(const Aabb* bounds, size_t count) {
+    nodes.clear();
+    objectOrder.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<BuildItem> items(count);
+    for (size_t i = 0; i < count; i++) {
+        items[i] = BuildItem{bounds[i], (uint32_t)i};
+    }
+    // A 4-wide tree has about a third as many nodes as objects
+    nodes.reserve(count / 3 + 1);
+    nodes.emplace_back();
+    buildNode(nodes, 0, items.data(), 0, (uint32_t)count);
+    for (size_t i = 0; i < count; i++) {
+        objectOrder[i] = items[i].object;
+    }
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) {
+    visible.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    CullPlanes planes(frustum);
+
+    if (!pool || pool->getThreadCount() == 1) {
+        frontier.assign(1, 0);
+        traverse(nodes, planes, objectOrder.data(), frontier, visible);
+        return;
+    }
+
+    // Expand the top levels breadth first until there are enough partially
+    // visible subtrees to spread over the threads
+    size_t taskTarget = pool->getThreadCount() * TASKS_PER_THREAD;
+    frontier.assign(1, 0);
+    while (!frontier.empty() && frontier.size() < taskTarget) {
+        nextFrontier.clear();
+        for (uint32_t index : frontier) {
+            visitNode(nodes[index], planes, objectOrder.data(), visible, nextFrontier);
+        }
+        frontier.swap(nextFrontier);
+    }
+    if (frontier.empty()) {
+        return;
+    }
+
+    taskVisible.resize(std::max(taskVisible.size(), frontier.size()));
+    taskStacks.resize(std::max(taskStacks.size(), frontier.size()));
+    pool->parallelFor(frontier.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            taskVisible[t].clear();
+            taskStacks[t].assign(1, frontier[t]);
+            traverse(nodes, planes, objectOrder.data(), taskStacks[t], taskVisible[t]);
+        }
+    });
+
+    size_t total = visible.size();
+    for (size_t t = 0; t < frontier.size(); t++) {
+        total += taskVisible[t].size();
+    }
+    visible.reserve(total);
+    for (size_t t = 0; t < frontier.size(); t++) {
+        visible.insert(visible.end(), taskVisible[t].begin(), taskVisible[t].end());
+    }
+}
@@ -77,6 +77,14 @@ void Camera::ProcessMouseScroll(float yoffset)
         Zoom = 45.0f;
 }
 
+void Camera::LookAt(const glm::vec3& target)
+{
+    glm::vec3 direction = glm::normalize(target - Position);
+    Yaw   = glm::degrees(atan2(direction.z, direction.x));
+    Pitch = glm::degrees(asin(direction.y));
+    updateCameraVectors();
+}
+
 void Camera::updateCameraVectors()
 {
     glm::vec3 front;
@@ -1,4 +1,5 @@
 #include "ElementBuffer.h"
+#include "GLState.h"
 
 ElementBuffer::ElementBuffer(const unsigned int* indices, size_t count, GLenum usage) 
     : ID(0), count(count) {
@@ -9,7 +10,7 @@ ElementBuffer::ElementBuffer(const unsigned int* indices, size_t count, GLenum u
 
 ElementBuffer::~ElementBuffer() {
     if (ID != 0) {
-        glDeleteBuffers(1, &ID);
+        glstate::deleteBuffers(1, &ID);
     }
 }
 
@@ -22,7 +23,7 @@ ElementBuffer::ElementBuffer(ElementBuffer&& other) noexcept
 ElementBuffer& ElementBuffer::operator=(ElementBuffer&& other) noexcept {
     if (this != &other) {
         if (ID != 0) {
-            glDeleteBuffers(1, &ID);
+            glstate::deleteBuffers(1, &ID);
         }
         ID = other.ID;
         count = other.count;
@@ -33,11 +34,11 @@ ElementBuffer& ElementBuffer::operator=(ElementBuffer&& other) noexcept {
 }
 
 void ElementBuffer::bind() const {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+    glstate::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
 }
 
 void ElementBuffer::unbind() const {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glstate::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void ElementBuffer::setData(const unsigned int* indices, size_t count, GLenum usage) {
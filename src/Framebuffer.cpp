@@ -0,0 +1,72 @@
+#include "Framebuffer.h"
+#include "GLState.h"
+#include <iostream>
+
+Framebuffer::Framebuffer(int width, int height)
+    : ID(0), colorRbo(0), depthRbo(0), width(width), height(height) {
+    glGenFramebuffers(1, &ID);
+    bind();
+
+    glGenRenderbuffers(1, &colorRbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRbo);
+
+    glGenRenderbuffers(1, &depthRbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRbo);
+
+    if (!isComplete()) {
+        std::cerr << "ERROR::FRAMEBUFFER::INCOMPLETE: " << width << "x" << height << std::endl;
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+}
+
+Framebuffer::~Framebuffer() {
+    release();
+}
+
+Framebuffer::Framebuffer(Framebuffer&& other) noexcept
+    : ID(other.ID), colorRbo(other.colorRbo), depthRbo(other.depthRbo),
+      width(other.width), height(other.height) {
+    other.ID = 0;
+    other.colorRbo = 0;
+    other.depthRbo = 0;
+}
+
+Framebuffer& Framebuffer::operator=(Framebuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        ID = other.ID;
+        colorRbo = other.colorRbo;
+        depthRbo = other.depthRbo;
+        width = other.width;
+        height = other.height;
+        other.ID = 0;
+        other.colorRbo = 0;
+        other.depthRbo = 0;
+    }
+    return *this;
+}
+
+void Framebuffer::release() {
+    if (ID != 0) {
+        glstate::deleteFramebuffers(1, &ID);
+        glDeleteRenderbuffers(1, &colorRbo);
+        glDeleteRenderbuffers(1, &depthRbo);
+        ID = 0;
+    }
+}
+
+void Framebuffer::bind() const {
+    glstate::bindFramebuffer(ID);
+}
+
+void Framebuffer::unbind() const {
+    glstate::bindFramebuffer(0);
+}
+
+bool Framebuffer::isComplete() const {
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
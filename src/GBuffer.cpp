@@ -0,0 +1,102 @@
+#include "GBuffer.h"
+#include "GLState.h"
+#include <iostream>
+
+namespace {
+
+unsigned int createAttachment(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glstate::bindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    // Read back with texelFetch, one texel per pixel
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+} // namespace
+
+GBuffer::GBuffer(int width, int height)
+    : ID(0), positionTex(0), normalTex(0), albedoSpecTex(0), depthTex(0), width(width), height(height) {
+    glGenFramebuffers(1, &ID);
+    bind();
+
+    // Positions need full float precision: half floats are already ~0.06
+    // units apart 100 units from the origin
+    positionTex = createAttachment(GL_RGB32F, GL_RGB, GL_FLOAT, width, height);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, positionTex, 0);
+    normalTex = createAttachment(GL_RGB16F, GL_RGB, GL_FLOAT, width, height);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTex, 0);
+    albedoSpecTex = createAttachment(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, albedoSpecTex, 0);
+    depthTex = createAttachment(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTex, 0);
+
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, drawBuffers);
+
+    if (!isComplete()) {
+        std::cerr << "ERROR::GBUFFER::INCOMPLETE: " << width << "x" << height << std::endl;
+    }
+    glstate::bindTexture(GL_TEXTURE_2D, 0);
+}
+
+GBuffer::~GBuffer() {
+    release();
+}
+
+GBuffer::GBuffer(GBuffer&& other) noexcept
+    : ID(other.ID), positionTex(other.positionTex), normalTex(other.normalTex),
+      albedoSpecTex(other.albedoSpecTex), depthTex(other.depthTex),
+      width(other.width), height(other.height) {
+    other.ID = 0;
+    other.positionTex = 0;
+    other.normalTex = 0;
+    other.albedoSpecTex = 0;
+    other.depthTex = 0;
+}
+
+GBuffer& GBuffer::operator=(GBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        ID = other.ID;
+        positionTex = other.positionTex;
+        normalTex = other.normalTex;
+        albedoSpecTex = other.albedoSpecTex;
+        depthTex = other.depthTex;
+        width = other.width;
+        height = other.height;
+        other.ID = 0;
+        other.positionTex = 0;
+        other.normalTex = 0;
+        other.albedoSpecTex = 0;
+        other.depthTex = 0;
+    }
+    return *this;
+}
+
+void GBuffer::release() {
+    if (ID != 0) {
+        glstate::deleteFramebuffers(1, &ID);
+        const unsigned int textures[] = {positionTex, normalTex, albedoSpecTex, depthTex};
+        glstate::deleteTextures(4, textures);
+        ID = 0;
+    }
+}
+
+void GBuffer::bind() const {
+    glstate::bindFramebuffer(ID);
+}
+
+void GBuffer::bindTextures() const {
+    const unsigned int textures[] = {positionTex, normalTex, albedoSpecTex, depthTex};
+    const Slot slots[] = {POSITION_SLOT, NORMAL_SLOT, ALBEDO_SPEC_SLOT, DEPTH_SLOT};
+    for (int i = 0; i < 4; i++) {
+        glstate::bindTexture(slots[i], GL_TEXTURE_2D, textures[i]);
+    }
+}
+
+bool GBuffer::isComplete() const {
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
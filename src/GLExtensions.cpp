@@ -0,0 +1,57 @@
+#include "GLExtensions.h"
+#include <cstring>
+
+namespace glext {
+
+BufferStorageProc bufferStorage = nullptr;
+GetProgramBinaryProc getProgramBinary = nullptr;
+ProgramBinaryProc programBinary = nullptr;
+ProgramParameteriProc programParameteri = nullptr;
+MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+
+void load(GLADloadproc loader) {
+    // Loaders may hand out pointers for anything, so the context has to
+    // advertise the function first
+    bufferStorage = hasVersion(4, 4) || hasExtension("GL_ARB_buffer_storage")
+                        ? (BufferStorageProc)loader("glBufferStorage")
+                        : nullptr;
+
+    getProgramBinary = nullptr;
+    programBinary = nullptr;
+    programParameteri = nullptr;
+    if (hasVersion(4, 1) || hasExtension("GL_ARB_get_program_binary")) {
+        getProgramBinary = (GetProgramBinaryProc)loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc)loader("glProgramBinary");
+        programParameteri = (ProgramParameteriProc)loader("glProgramParameteri");
+        if (!getProgramBinary || !programBinary || !programParameteri) {
+            getProgramBinary = nullptr;
+            programBinary = nullptr;
+            programParameteri = nullptr;
+        }
+    }
+
+    // Same entry point under either name
+    maxShaderCompilerThreads = nullptr;
+    if (hasExtension("GL_KHR_parallel_shader_compile")) {
+        maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+    } else if (hasExtension("GL_ARB_parallel_shader_compile")) {
+        maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+    }
+}
+
+bool hasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hasVersion(int major, int minor) {
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+} // namespace glext
@@ -0,0 +1,276 @@
+#include "GLState.h"
+
+namespace {
+
+// Binding not known to the cache; never a valid object name in practice
+const GLuint UNKNOWN = ~0u;
+// Texture units tracked; binds to higher ones are always issued
+const unsigned int MAX_UNITS = 32;
+
+enum TextureTarget { TEXTURE_2D, TEXTURE_2D_ARRAY, TEXTURE_BUFFER, TEXTURE_TARGET_COUNT };
+enum BufferTarget {
+    ARRAY_BUFFER,
+    ELEMENT_ARRAY_BUFFER,
+    UNIFORM_BUFFER,
+    TEXTURE_BUFFER_BUFFER,
+    PIXEL_UNPACK_BUFFER,
+    BUFFER_TARGET_COUNT
+};
+
+struct State {
+    bool enabled = true;
+    GLuint program = UNKNOWN;
+    unsigned int activeUnit = UNKNOWN;
+    GLuint textures[MAX_UNITS][TEXTURE_TARGET_COUNT];
+    GLuint buffers[BUFFER_TARGET_COUNT];
+    GLuint vertexArray = UNKNOWN;
+    GLuint framebuffer = UNKNOWN;
+    GLStateCounters counters;
+
+    State() { invalidateBindings(); }
+
+    void invalidateBindings() {
+        program = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (auto& unit : textures) {
+            for (GLuint& texture : unit) {
+                texture = UNKNOWN;
+            }
+        }
+        for (GLuint& buffer : buffers) {
+            buffer = UNKNOWN;
+        }
+        vertexArray = UNKNOWN;
+        framebuffer = UNKNOWN;
+    }
+};
+
+State& state() {
+    static State instance;
+    return instance;
+}
+
+int textureTarget(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return TEXTURE_2D;
+    case GL_TEXTURE_2D_ARRAY:
+        return TEXTURE_2D_ARRAY;
+    case GL_TEXTURE_BUFFER:
+        return TEXTURE_BUFFER;
+    default:
+        return -1;
+    }
+}
+
+int bufferTarget(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER:
+        return ARRAY_BUFFER;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return ELEMENT_ARRAY_BUFFER;
+    case GL_UNIFORM_BUFFER:
+        return UNIFORM_BUFFER;
+    case GL_TEXTURE_BUFFER:
+        return TEXTURE_BUFFER_BUFFER;
+    case GL_PIXEL_UNPACK_BUFFER:
+        return PIXEL_UNPACK_BUFFER;
+    default:
+        return -1;
+    }
+}
+
+// Records value as bound; true if the call has to be issued
+bool update(GLuint& cached, GLuint value) {
+    State& s = state();
+    if (s.enabled && cached == value) {
+        s.counters.filtered++;
+        return false;
+    }
+    cached = value;
+    s.counters.issued++;
+    return true;
+}
+
+} // namespace
+
+namespace glstate {
+
+void useProgram(GLuint program) {
+    if (update(state().program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void activeTexture(unsigned int unit) {
+    if (update(state().activeUnit, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void bindTexture(GLenum target, GLuint texture) {
+    State& s = state();
+    int index = textureTarget(target);
+    if (index < 0 || s.activeUnit >= MAX_UNITS) {
+        // Untracked, or the unit is unknown: whatever it now holds is too
+        if (index >= 0) {
+            for (auto& unit : s.textures) {
+                unit[index] = UNKNOWN;
+            }
+        }
+        s.counters.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (update(s.textures[s.activeUnit][index], texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+    State& s = state();
+    int index = textureTarget(target);
+    if (s.enabled && index >= 0 && unit < MAX_UNITS && s.textures[unit][index] == texture) {
+        // Saves the unit switch as well, unless it was active anyway
+        s.counters.filtered += s.activeUnit == unit ? 1 : 2;
+        return;
+    }
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void bindBuffer(GLenum target, GLuint buffer) {
+    State& s = state();
+    int index = bufferTarget(target);
+    if (index < 0) {
+        s.counters.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (update(s.buffers[index], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    State& s = state();
+    int generic = bufferTarget(target);
+    if (generic >= 0) {
+        s.buffers[generic] = buffer;
+    }
+    s.counters.issued++;
+    glBindBufferBase(target, index, buffer);
+}
+
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    State& s = state();
+    int generic = bufferTarget(target);
+    if (generic >= 0) {
+        s.buffers[generic] = buffer;
+    }
+    s.counters.issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void bindVertexArray(GLuint vertexArray) {
+    State& s = state();
+    if (update(s.vertexArray, vertexArray)) {
+        glBindVertexArray(vertexArray);
+        // The element buffer binding is part of the vertex array
+        s.buffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+    }
+}
+
+void bindFramebuffer(GLuint framebuffer) {
+    if (update(state().framebuffer, framebuffer)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+GLuint getFramebuffer() {
+    State& s = state();
+    if (s.framebuffer == UNKNOWN) {
+        GLint framebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+        s.framebuffer = (GLuint)framebuffer;
+    }
+    return s.framebuffer;
+}
+
+void deleteProgram(GLuint program) {
+    State& s = state();
+    // A current program is only deleted once it is no longer in use
+    if (s.program == program) {
+        s.program = UNKNOWN;
+    }
+    glDeleteProgram(program);
+}
+
+void deleteTextures(GLsizei count, const GLuint* textures) {
+    State& s = state();
+    for (GLsizei i = 0; i < count; i++) {
+        for (auto& unit : s.textures) {
+            for (GLuint& texture : unit) {
+                if (texture == textures[i]) {
+                    texture = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void deleteBuffers(GLsizei count, const GLuint* buffers) {
+    State& s = state();
+    for (GLsizei i = 0; i < count; i++) {
+        for (GLuint& buffer : s.buffers) {
+            if (buffer == buffers[i]) {
+                buffer = 0;
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays) {
+    State& s = state();
+    for (GLsizei i = 0; i < count; i++) {
+        if (s.vertexArray == vertexArrays[i]) {
+            s.vertexArray = 0;
+            s.buffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+        }
+    }
+    glDeleteVertexArrays(count, vertexArrays);
+}
+
+void deleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+    State& s = state();
+    for (GLsizei i = 0; i < count; i++) {
+        if (s.framebuffer == framebuffers[i]) {
+            s.framebuffer = 0;
+        }
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+void invalidate() {
+    state().invalidateBindings();
+}
+
+void setEnabled(bool enabled) {
+    state().enabled = enabled;
+}
+
+bool isEnabled() {
+    return state().enabled;
+}
+
+const GLStateCounters& getCounters() {
+    return state().counters;
+}
+
+void resetCounters() {
+    state().counters = GLStateCounters{};
+}
+
+} // namespace glstate
@@ -0,0 +1,73 @@
+#include "HeadlessContext.h"
+#include "GLExtensions.h"
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include <iostream>
+
+HeadlessContext::HeadlessContext()
+    : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), valid(false) {
+    // Prefer the surfaceless platform so no X11/Wayland connection is needed
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "ERROR::EGL::INITIALIZE_FAILED" << std::endl;
+        return;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "ERROR::EGL::OPENGL_API_UNAVAILABLE" << std::endl;
+        return;
+    }
+
+    // EGL_SURFACE_TYPE defaults to EGL_WINDOW_BIT, which surfaceless has none of
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        std::cerr << "ERROR::EGL::NO_CONFIG" << std::endl;
+        return;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "ERROR::EGL::CONTEXT_CREATION_FAILED" << std::endl;
+        return;
+    }
+
+    // Requires EGL_KHR_surfaceless_context
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "ERROR::EGL::MAKE_CURRENT_FAILED" << std::endl;
+        return;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return;
+    }
+    glext::load((GLADloadproc)eglGetProcAddress);
+    valid = true;
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (display != EGL_NO_DISPLAY) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
+    }
+}
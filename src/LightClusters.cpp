@@ -0,0 +1,163 @@
+#include "LightClusters.h"
+#include "Camera.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+float pointLightRadius(float constant, float linear, float quadratic, float maxIntensity) {
+    // Solve constant + linear * d + quadratic * d^2 = maxIntensity * 256 / 5
+    float threshold = maxIntensity * 256.0f / 5.0f;
+    if (quadratic <= 0.0f) {
+        return linear > 0.0f ? (threshold - constant) / linear : FAR_PLANE;
+    }
+    return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * (constant - threshold))) / (2.0f * quadratic);
+}
+
+LightClusters::LightClusters(ThreadPool* pool)
+    : pool(pool), nearPlane(NEAR_PLANE), farPlane(FAR_PLANE), zScale(0.0f), zBias(0.0f),
+      sliceRanges(SLICES_Z), sliceIndices(SLICES_Z), clusters(CLUSTER_COUNT) {
+}
+
+float LightClusters::sliceDepth(unsigned int slice) const {
+    return nearPlane * std::pow(farPlane / nearPlane, (float)slice / SLICES_Z);
+}
+
+void LightClusters::build(const std::vector<PointLight>& lights, const Camera& camera, float aspectRatio) {
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = camera.GetProjectionMatrix(aspectRatio, nearPlane, farPlane);
+    float p00 = projection[0][0];
+    float p11 = projection[1][1];
+
+    float logRange = std::log(farPlane / nearPlane);
+    zScale = SLICES_Z / logRange;
+    zBias = -(float)SLICES_Z * std::log(nearPlane) / logRange;
+
+    auto parallelFor = [this](size_t count, size_t grain, RangeFunction fn) {
+        if (pool) {
+            pool->parallelFor(count, grain, fn);
+        } else if (count > 0) {
+            fn(0, count);
+        }
+    };
+
+    // 1. View-space bounds and depth slice range of every light
+    bounds.resize(lights.size());
+    parallelFor(lights.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            LightBounds& b = bounds[i];
+            b.center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            b.radius = lights[i].radius;
+
+            float depth = -b.center.z;
+            float minDepth = depth - b.radius;
+            float maxDepth = depth + b.radius;
+            if (maxDepth < nearPlane || minDepth > farPlane) {
+                b.firstSlice = 1;
+                b.lastSlice = 0;
+                continue;
+            }
+            auto slice = [&](float d) {
+                return std::clamp((int)std::floor(std::log(d) * zScale + zBias), 0, (int)SLICES_Z - 1);
+            };
+            b.firstSlice = slice(std::max(minDepth, nearPlane));
+            b.lastSlice = slice(std::min(maxDepth, farPlane));
+        }
+    });
+
+    // 2. Bin lights into the tiles of each slice
+    parallelFor(SLICES_Z, 1, [&](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; slice++) {
+            binSlice((unsigned int)slice, p00, p11);
+        }
+    });
+
+    // 3. Concatenate the per-slice index lists
+    uint32_t sliceOffsets[SLICES_Z];
+    uint32_t total = 0;
+    for (unsigned int slice = 0; slice < SLICES_Z; slice++) {
+        sliceOffsets[slice] = total;
+        total += (uint32_t)sliceIndices[slice].size();
+    }
+    lightIndices.resize(total);
+    parallelFor(SLICES_Z, 1, [&](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; slice++) {
+            const std::vector<uint32_t>& indices = sliceIndices[slice];
+            if (!indices.empty()) {
+                std::memcpy(lightIndices.data() + sliceOffsets[slice], indices.data(), indices.size() * sizeof(uint32_t));
+            }
+            LightCluster* sliceClusters = clusters.data() + slice * TILES_X * TILES_Y;
+            for (unsigned int tile = 0; tile < TILES_X * TILES_Y; tile++) {
+                sliceClusters[tile].offset += sliceOffsets[slice];
+            }
+        }
+    });
+}
+
+void LightClusters::binSlice(unsigned int slice, float p00, float p11) {
+    float sliceNear = sliceDepth(slice);
+    float sliceFar = sliceDepth(slice + 1);
+
+    std::vector<TileRange>& ranges = sliceRanges[slice];
+    ranges.clear();
+    LightCluster* sliceClusters = clusters.data() + slice * TILES_X * TILES_Y;
+    for (unsigned int tile = 0; tile < TILES_X * TILES_Y; tile++) {
+        sliceClusters[tile] = LightCluster{0, 0};
+    }
+
+    auto toTile = [](float ndc, unsigned int tiles) {
+        return (uint8_t)std::clamp((int)std::floor((ndc * 0.5f + 0.5f) * tiles), 0, (int)tiles - 1);
+    };
+
+    for (uint32_t i = 0; i < (uint32_t)bounds.size(); i++) {
+        const LightBounds& b = bounds[i];
+        if ((int)slice < b.firstSlice || (int)slice > b.lastSlice) {
+            continue;
+        }
+
+        // Project the corners of the sphere's bounding box, with depth
+        // clamped to this slice; x/d is extremal at the corners
+        float depth = -b.center.z;
+        float d0 = std::max(sliceNear, depth - b.radius);
+        float d1 = std::min(sliceFar, depth + b.radius);
+        float x0 = b.center.x - b.radius, x1 = b.center.x + b.radius;
+        float y0 = b.center.y - b.radius, y1 = b.center.y + b.radius;
+
+        float minX = std::min({p00 * x0 / d0, p00 * x0 / d1, p00 * x1 / d0, p00 * x1 / d1});
+        float maxX = std::max({p00 * x0 / d0, p00 * x0 / d1, p00 * x1 / d0, p00 * x1 / d1});
+        float minY = std::min({p11 * y0 / d0, p11 * y0 / d1, p11 * y1 / d0, p11 * y1 / d1});
+        float maxY = std::max({p11 * y0 / d0, p11 * y0 / d1, p11 * y1 / d0, p11 * y1 / d1});
+        if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) {
+            continue;
+        }
+
+        TileRange range{i, toTile(minX, TILES_X), toTile(maxX, TILES_X), toTile(minY, TILES_Y), toTile(maxY, TILES_Y)};
+        for (unsigned int y = range.y0; y <= range.y1; y++) {
+            for (unsigned int x = range.x0; x <= range.x1; x++) {
+                sliceClusters[y * TILES_X + x].count++;
+            }
+        }
+        ranges.push_back(range);
+    }
+
+    // Prefix sum of counts gives each cluster's run, then scatter
+    uint32_t offset = 0;
+    for (unsigned int tile = 0; tile < TILES_X * TILES_Y; tile++) {
+        sliceClusters[tile].offset = offset;
+        offset += sliceClusters[tile].count;
+    }
+
+    std::vector<uint32_t>& indices = sliceIndices[slice];
+    indices.resize(offset);
+    uint32_t cursor[TILES_X * TILES_Y];
+    for (unsigned int tile = 0; tile < TILES_X * TILES_Y; tile++) {
+        cursor[tile] = sliceClusters[tile].offset;
+    }
+    for (const TileRange& range : ranges) {
+        for (unsigned int y = range.y0; y <= range.y1; y++) {
+            for (unsigned int x = range.x0; x <= range.x1; x++) {
+                indices[cursor[y * TILES_X + x]++] = range.light;
+            }
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : data(nullptr), size(0), fileHandle(nullptr), mappingHandle(nullptr) {}
+
+MappedFile::MappedFile(const std::string& path) : MappedFile() {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    fileHandle = file;
+    LARGE_INTEGER fileSize;
+    // Empty files cannot be mapped
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        release();
+        return;
+    }
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        release();
+        return;
+    }
+    data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    size = data ? (size_t)fileSize.QuadPart : 0;
+    if (!data) {
+        release();
+    }
+}
+
+void MappedFile::release() {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    data = nullptr;
+    size = 0;
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(other.data), size(other.size), fileHandle(other.fileHandle), mappingHandle(other.mappingHandle) {
+    other.data = nullptr;
+    other.size = 0;
+    other.fileHandle = nullptr;
+    other.mappingHandle = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+    }
+    return *this;
+}
+
+#else
+
+MappedFile::MappedFile() : data(nullptr), size(0), fd(-1) {}
+
+MappedFile::MappedFile(const std::string& path) : MappedFile() {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    // Empty files cannot be mapped
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        release();
+        return;
+    }
+    void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        release();
+        return;
+    }
+    data = (const unsigned char*)mapping;
+    size = (size_t)info.st_size;
+}
+
+void MappedFile::release() {
+    if (data) {
+        munmap((void*)data, size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    data = nullptr;
+    size = 0;
+    fd = -1;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : data(other.data), size(other.size), fd(other.fd) {
+    other.data = nullptr;
+    other.size = 0;
+    other.fd = -1;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        std::swap(fd, other.fd);
+    }
+    return *this;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    release();
+}
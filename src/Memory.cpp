@@ -0,0 +1,193 @@
+#include "Memory.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+std::atomic<uint64_t> heapAllocations{0};
+std::atomic<uint64_t> heapBytes{0};
+
+// alignedForm is true for the align_val_t operators, whose memory is freed
+// by the aligned operator delete; on Windows that has to be _aligned_free,
+// so those always come from _aligned_malloc there
+void* countedAlloc(size_t size, size_t alignment, bool alignedForm) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    heapBytes.fetch_add(size, std::memory_order_relaxed);
+    size = std::max<size_t>(size, 1);
+    void* p;
+#ifdef _WIN32
+    if (alignedForm) {
+        p = _aligned_malloc(size, alignment);
+    } else {
+        p = std::malloc(size);
+    }
+#else
+    (void)alignedForm;
+    if (alignment <= alignof(std::max_align_t)) {
+        p = std::malloc(size);
+    } else {
+        // aligned_alloc wants a multiple of the alignment
+        p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+#endif
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+// The array and nothrow forms forward to these by default
+void* operator new(size_t size) {
+    return countedAlloc(size, alignof(std::max_align_t), false);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return countedAlloc(size, (size_t)alignment, true);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+
+namespace memory {
+
+uint64_t getHeapAllocations() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t getHeapBytes() {
+    return heapBytes.load(std::memory_order_relaxed);
+}
+
+} // namespace memory
+
+LinearArena::LinearArena(size_t capacity, std::pmr::memory_resource* upstream)
+    : upstream(upstream), buffer((unsigned char*)upstream->allocate(capacity, alignof(std::max_align_t))),
+      capacity(capacity), head(0), peak(0), overflows(nullptr), overflowCount(0) {}
+
+LinearArena::~LinearArena() {
+    reset();
+    upstream->deallocate(buffer, capacity, alignof(std::max_align_t));
+}
+
+void* LinearArena::do_allocate(size_t bytes, size_t alignment) {
+    // Aligned by address: the buffer itself is only max_align_t aligned
+    uintptr_t base = (uintptr_t)buffer;
+    size_t offset = alignUp(base + head, alignment) - base;
+    if (offset + bytes <= capacity) {
+        head = offset + bytes;
+        peak = std::max(peak, head);
+        return buffer + offset;
+    }
+
+    overflowCount++;
+    alignment = std::max(alignment, alignof(Overflow));
+    size_t headerSize = alignUp(sizeof(Overflow), alignment);
+    auto* overflow = (Overflow*)upstream->allocate(headerSize + bytes, alignment);
+    *overflow = Overflow{overflows, headerSize + bytes, alignment};
+    overflows = overflow;
+    return (unsigned char*)overflow + headerSize;
+}
+
+void LinearArena::reset() {
+    while (overflows) {
+        Overflow* next = overflows->next;
+        upstream->deallocate(overflows, overflows->size, overflows->alignment);
+        overflows = next;
+    }
+    head = 0;
+}
+
+FrameArena::FrameArena(size_t capacityPerFrame, std::pmr::memory_resource* upstream)
+    : arenas{LinearArena(capacityPerFrame, upstream), LinearArena(capacityPerFrame, upstream)}, current(0) {}
+
+void FrameArena::beginFrame() {
+    current ^= 1;
+    arenas[current].reset();
+}
+
+size_t FrameArena::getPeak() const {
+    return std::max(arenas[0].getPeak(), arenas[1].getPeak());
+}
+
+size_t FrameArena::getOverflowCount() const {
+    return arenas[0].getOverflowCount() + arenas[1].getOverflowCount();
+}
+
+PoolResource::PoolResource(size_t blockSize, size_t blocksPerChunk, std::pmr::memory_resource* upstream)
+    : upstream(upstream),
+      blockSize(alignUp(std::max(blockSize, sizeof(FreeBlock)), alignof(std::max_align_t))),
+      blocksPerChunk(std::max<size_t>(blocksPerChunk, 1)), chunks(nullptr), freeBlocks(nullptr), liveBlocks(0),
+      chunkCount(0) {}
+
+PoolResource::~PoolResource() {
+    size_t chunkSize = alignof(std::max_align_t) + blockSize * blocksPerChunk;
+    while (chunks) {
+        Chunk* next = chunks->next;
+        upstream->deallocate(chunks, chunkSize, alignof(std::max_align_t));
+        chunks = next;
+    }
+}
+
+void* PoolResource::do_allocate(size_t bytes, size_t alignment) {
+    if (bytes > blockSize || alignment > alignof(std::max_align_t)) {
+        return upstream->allocate(bytes, alignment);
+    }
+    if (!freeBlocks) {
+        // The chunk header takes one alignment unit, keeping the blocks aligned
+        size_t chunkSize = alignof(std::max_align_t) + blockSize * blocksPerChunk;
+        auto* chunk = (Chunk*)upstream->allocate(chunkSize, alignof(std::max_align_t));
+        chunk->next = chunks;
+        chunks = chunk;
+        chunkCount++;
+        unsigned char* blocks = (unsigned char*)chunk + alignof(std::max_align_t);
+        // Threaded back to front, so blocks are handed out in address order
+        for (size_t i = blocksPerChunk; i-- > 0;) {
+            auto* block = (FreeBlock*)(blocks + i * blockSize);
+            block->next = freeBlocks;
+            freeBlocks = block;
+        }
+    }
+    FreeBlock* block = freeBlocks;
+    freeBlocks = block->next;
+    liveBlocks++;
+    return block;
+}
+
+void PoolResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    if (bytes > blockSize || alignment > alignof(std::max_align_t)) {
+        upstream->deallocate(p, bytes, alignment);
+        return;
+    }
+    auto* block = (FreeBlock*)p;
+    block->next = freeBlocks;
+    freeBlocks = block;
+    liveBlocks--;
+}
@@ -0,0 +1,65 @@
+#include "Mesh.h"
+#include "GLState.h"
+#include <utility>
+
+Mesh::Mesh(const void* vertexData, size_t vertexCount, const VertexEncoding& encoding, const uint32_t* indices,
+           size_t indexCount)
+    : vbo(vertexData, vertexCount * encoding.format.getStride()), ebo(indices, indexCount), vao(0),
+      vertexCount(vertexCount), encoding(encoding) {
+    createVertexArray();
+}
+
+Mesh::Mesh(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+    : Mesh(vertices, vertexCount, VertexEncoding{FLOAT_VERTEX_FORMAT}, indices, indexCount) {}
+
+Mesh::Mesh(const MeshData& data, const VertexFormat& format)
+    : vbo(nullptr, 0), ebo(data.indices.data(), data.indices.size()), vao(0), vertexCount(data.vertices.size()) {
+    std::vector<uint8_t> encoded;
+    encoding = encodeVertices(data.vertices.data(), data.vertices.size(), format, encoded);
+    vbo.setData(encoded.data(), encoded.size());
+    createVertexArray();
+}
+
+void Mesh::createVertexArray() {
+    glGenVertexArrays(1, &vao);
+    glstate::bindVertexArray(vao);
+    vbo.bind();
+    ebo.bind();
+    setVertexAttributes(encoding.format);
+    glstate::bindVertexArray(0);
+}
+
+Mesh::~Mesh() {
+    if (vao != 0) {
+        glstate::deleteVertexArrays(1, &vao);
+    }
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+    : vbo(std::move(other.vbo)), ebo(std::move(other.ebo)), vao(other.vao), vertexCount(other.vertexCount),
+      encoding(other.encoding) {
+    other.vao = 0;
+    other.vertexCount = 0;
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+    if (this != &other) {
+        if (vao != 0) {
+            glstate::deleteVertexArrays(1, &vao);
+        }
+        vbo = std::move(other.vbo);
+        ebo = std::move(other.ebo);
+        vao = other.vao;
+        vertexCount = other.vertexCount;
+        encoding = other.encoding;
+
+        other.vao = 0;
+        other.vertexCount = 0;
+    }
+    return *this;
+}
+
+void Mesh::draw() const {
+    glstate::bindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, (GLsizei)ebo.getCount(), GL_UNSIGNED_INT, 0);
+}
@@ -0,0 +1,324 @@
+#include "MeshOptimizer.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+// Vertices are deduplicated by their exact bit pattern
+struct VertexHash {
+    size_t operator()(const MeshVertex& vertex) const {
+        return (size_t)fnv1a64(std::string_view((const char*)&vertex, sizeof(MeshVertex)));
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const MeshVertex& a, const MeshVertex& b) const {
+        return std::memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+    }
+};
+
+// FIFO post-transform cache; a vertex's entry time tells whether it is
+// still among the last cacheSize misses
+class FifoCache {
+private:
+    std::vector<size_t> insertedAt;
+    size_t misses;
+    unsigned int cacheSize;
+
+public:
+    FifoCache(size_t vertexCount, unsigned int cacheSize)
+        : insertedAt(vertexCount, 0), misses(cacheSize + 1), cacheSize(cacheSize) {}
+
+    // Returns true on a miss
+    bool access(uint32_t vertex) {
+        if (misses - insertedAt[vertex] > cacheSize) {
+            insertedAt[vertex] = misses++;
+            return true;
+        }
+        return false;
+    }
+
+    // Evicts everything in constant time
+    void reset() { misses += cacheSize + 1; }
+};
+
+// Triangles around each vertex, as offsets into one flat array
+struct Adjacency {
+    std::vector<uint32_t> offsets; // vertexCount + 1
+    std::vector<uint32_t> triangles;
+
+    Adjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+        : offsets(vertexCount + 1, 0), triangles(indexCount) {
+        for (size_t i = 0; i < indexCount; i++) {
+            offsets[indices[i] + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++) {
+            triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+        }
+    }
+};
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned int cacheSize) {
+    VertexCacheStats stats;
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    size_t unique = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        stats.transformed += cache.access(indices[i]);
+        if (!used[indices[i]]) {
+            used[indices[i]] = true;
+            unique++;
+        }
+    }
+    stats.acmr = indexCount ? (float)stats.transformed / (float)(indexCount / 3) : 0.0f;
+    stats.atvr = unique ? (float)stats.transformed / (float)unique : 0.0f;
+    return stats;
+}
+
+MeshData indexVertices(const MeshVertex* vertices, size_t vertexCount) {
+    MeshData mesh;
+    std::unordered_map<MeshVertex, uint32_t, VertexHash, VertexEqual> unique;
+    unique.reserve(vertexCount);
+    mesh.indices.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        auto [it, inserted] = unique.try_emplace(vertices[i], (uint32_t)mesh.vertices.size());
+        if (inserted) {
+            mesh.vertices.push_back(vertices[i]);
+        }
+        mesh.indices.push_back(it->second);
+    }
+    return mesh;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    Adjacency adjacency(indices, indexCount, vertexCount);
+
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+
+    size_t timestamp = cacheSize + 1;
+    size_t cursor = 0; // scan position for vertices with triangles left
+    int64_t fanning = indices[0];
+
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++) {
+            uint32_t triangle = adjacency.triangles[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[triangle * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timestamp++;
+                }
+            }
+        }
+
+        // Next fan: the candidate that stays in cache longest while still
+        // having all of its triangles emitted before it leaves
+        fanning = -1;
+        size_t bestPriority = 0;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            size_t priority = 0;
+            if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = timestamp - cacheTime[v];
+            }
+            if (fanning < 0 || priority > bestPriority) {
+                fanning = v;
+                bestPriority = priority;
+            }
+        }
+
+        // Dead end: back up to a recently used vertex, then scan forward
+        while (fanning < 0 && !deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) {
+                fanning = v;
+            }
+        }
+        while (fanning < 0 && cursor < vertexCount) {
+            if (live[cursor] > 0) {
+                fanning = (int64_t)cursor;
+            }
+            cursor++;
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount,
+                      float threshold, unsigned int cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // 1. Hard boundaries: triangles whose three vertices all miss the cache
+    std::vector<size_t> hardClusters;
+    {
+        FifoCache cache(vertexCount, cacheSize);
+        for (size_t t = 0; t < triangleCount; t++) {
+            int misses = cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) +
+                         cache.access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3) {
+                hardClusters.push_back(t);
+            }
+        }
+        hardClusters.push_back(triangleCount);
+    }
+
+    // 2. Soft boundaries inside each hard cluster, wherever the running ACMR
+    // is already close to what the whole cluster achieves
+    std::vector<size_t> clusters;
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+        size_t begin = hardClusters[c], end = hardClusters[c + 1];
+        cache.reset();
+        size_t clusterMisses = 0;
+        for (size_t i = begin * 3; i < end * 3; i++) {
+            clusterMisses += cache.access(indices[i]);
+        }
+        float clusterAcmr = (float)clusterMisses / (float)(end - begin);
+
+        cache.reset();
+        size_t misses = 0, start = begin;
+        clusters.push_back(begin);
+        for (size_t t = begin; t < end; t++) {
+            misses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) +
+                      cache.access(indices[t * 3 + 2]);
+            float acmr = (float)misses / (float)(t + 1 - start);
+            if (t + 1 < end && acmr <= clusterAcmr * threshold) {
+                clusters.push_back(t + 1);
+                cache.reset();
+                misses = 0;
+                start = t + 1;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // 3. Sort key per cluster: how far its area-weighted centroid lies out
+    // along its average normal, relative to the mesh centroid
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++) {
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& p = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, p - a);
+            float area = glm::length(normal);
+            centroids[c] += (a + b + p) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f) {
+            centroids[c] /= areas[c];
+        }
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+    std::vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c : order) {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(MeshData& mesh) {
+    const uint32_t unassigned = ~0u;
+    std::vector<uint32_t> remap(mesh.vertices.size(), unassigned);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == unassigned) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+MeshOptimizationStats optimizeMesh(MeshData& mesh, bool overdraw) {
+    MeshOptimizationStats stats;
+    stats.vertices = mesh.vertices.size();
+    stats.triangles = mesh.indices.size() / 3;
+    stats.before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+    optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    if (overdraw) {
+        optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+    }
+    optimizeVertexFetch(mesh);
+
+    stats.after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    return stats;
+}
+
+std::vector<MeshOptimizationStats> optimizeMeshes(std::vector<MeshData>& meshes, ThreadPool* pool, bool overdraw) {
+    std::vector<MeshOptimizationStats> stats(meshes.size());
+    auto optimizeRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            stats[i] = optimizeMesh(meshes[i], overdraw);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(meshes.size(), 1, optimizeRange);
+    } else {
+        optimizeRange(0, meshes.size());
+    }
+    return stats;
+}
@@ -0,0 +1,480 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// Border and seam edges resist being moved this much more than the
+// surface around them
+const double BORDER_WEIGHT = 10.0;
+
+// A level has to lose at least this share of the triangles of the one
+// before, or the chain stops
+const float MIN_LOD_REDUCTION = 0.2f;
+
+// Coarser levels than this are not worth a draw call of their own
+const size_t MIN_LOD_TRIANGLES = 32;
+
+const uint32_t NO_VERTEX = UINT32_MAX;
+
+// Sum of squared distances to a set of weighted planes, as the symmetric
+// 4x4 matrix of Garland and Heckbert
+struct Quadric {
+    double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    // Plane n.p + d = 0 with unit normal n
+    static Quadric plane(const glm::vec3& n, float d, double weight) {
+        Quadric q;
+        q.a00 = weight * n.x * n.x;
+        q.a11 = weight * n.y * n.y;
+        q.a22 = weight * n.z * n.z;
+        q.a01 = weight * n.x * n.y;
+        q.a02 = weight * n.x * n.z;
+        q.a12 = weight * n.y * n.z;
+        q.b0 = weight * n.x * d;
+        q.b1 = weight * n.y * d;
+        q.b2 = weight * n.z * d;
+        q.c = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00;
+        a11 += other.a11;
+        a22 += other.a22;
+        a01 += other.a01;
+        a02 += other.a02;
+        a12 += other.a12;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // Weighted mean squared distance of p to the planes
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double sum = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                     2 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0 ? std::max(sum, 0.0) / weight : 0.0;
+    }
+};
+
+// Collapses edges of one mesh in passes. Vertices at the same position
+// (wedges) move together: positions are represented by their first vertex,
+// which holds the quadric, and every wedge is remapped to a wedge of the
+// target that shares a triangle edge with it.
+class Simplifier {
+private:
+    const MeshVertex* vertices;
+    size_t vertexCount;
+    std::vector<uint32_t> positionOf;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> indices;
+    double maxCost;
+
+    // Rebuilt every pass. borderEdges flags the edge leaving each corner of
+    // a triangle when no neighbouring triangle has it running the other way.
+    std::vector<uint32_t> triangleOffsets;
+    std::vector<uint32_t> triangles;
+    std::vector<uint8_t> borderEdges;
+    std::vector<uint8_t> locked;
+    std::vector<uint8_t> onBorder;
+    std::vector<uint8_t> touched;
+    std::vector<uint32_t> collapseTo;
+
+    struct Candidate {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<std::pair<uint32_t, uint32_t>> wedgeMap;
+
+    const glm::vec3& position(uint32_t vertex) const { return vertices[vertex].position; }
+
+    void weldPositions();
+    void addQuadrics();
+    void buildTopology();
+    bool canCollapse(uint32_t from, uint32_t to, bool borderEdge) const;
+    bool tryCollapse(uint32_t from, uint32_t to, size_t& removedTriangles);
+    size_t runPass(size_t targetTriangles, double maxError);
+
+public:
+    Simplifier(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+
+    // Continues until at most targetIndexCount indices are left or nothing
+    // else fits under maxError
+    void run(size_t targetIndexCount, float maxError);
+
+    const std::vector<uint32_t>& getIndices() const { return indices; }
+    float getError() const { return (float)std::sqrt(maxCost); }
+};
+
+Simplifier::Simplifier(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+    : vertices(vertices), vertexCount(vertexCount), indices(indices, indices + indexCount / 3 * 3), maxCost(0.0) {
+    weldPositions();
+    addQuadrics();
+    touched.assign(vertexCount, 0);
+    collapseTo.resize(vertexCount);
+}
+
+void Simplifier::weldPositions() {
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0);
+    auto less = [&](uint32_t a, uint32_t b) {
+        const glm::vec3& pa = position(a);
+        const glm::vec3& pb = position(b);
+        if (pa.x != pb.x) {
+            return pa.x < pb.x;
+        }
+        if (pa.y != pb.y) {
+            return pa.y < pb.y;
+        }
+        if (pa.z != pb.z) {
+            return pa.z < pb.z;
+        }
+        return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    positionOf.resize(vertexCount);
+    for (size_t begin = 0, end; begin < vertexCount; begin = end) {
+        end = begin + 1;
+        while (end < vertexCount && position(order[end]) == position(order[begin])) {
+            end++;
+        }
+        for (size_t i = begin; i < end; i++) {
+            positionOf[order[i]] = order[begin];
+        }
+    }
+}
+
+void Simplifier::addQuadrics() {
+    quadrics.assign(vertexCount, Quadric());
+    buildTopology();
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const glm::vec3& p0 = position(indices[i]);
+        glm::vec3 normal = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+        float doubleArea = glm::length(normal);
+        if (doubleArea == 0.0f) {
+            continue;
+        }
+        normal /= doubleArea;
+        Quadric face = Quadric::plane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+        for (int k = 0; k < 3; k++) {
+            quadrics[positionOf[indices[i + k]]] += face;
+        }
+
+        // Borders get a plane through the edge, perpendicular to the face,
+        // that holds them in place
+        for (int k = 0; k < 3; k++) {
+            if (!borderEdges[i + k]) {
+                continue;
+            }
+            uint32_t from = indices[i + k];
+            uint32_t to = indices[i + (k + 1) % 3];
+            glm::vec3 edge = position(to) - position(from);
+            float length = glm::length(edge);
+            if (length == 0.0f) {
+                continue;
+            }
+            glm::vec3 side = glm::normalize(glm::cross(edge, normal));
+            Quadric border = Quadric::plane(side, -glm::dot(side, position(from)), length * length * BORDER_WEIGHT);
+            quadrics[positionOf[from]] += border;
+            quadrics[positionOf[to]] += border;
+        }
+    }
+}
+
+void Simplifier::buildTopology() {
+    // Triangles around every position
+    triangleOffsets.assign(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        triangleOffsets[positionOf[index] + 1]++;
+    }
+    std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+    triangles.resize(indices.size());
+    std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        triangles[fill[positionOf[indices[i]]]++] = (uint32_t)(i / 3);
+    }
+
+    // The twin of an edge is in one of the few triangles around its end
+    borderEdges.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t from = indices[i + k];
+            uint32_t to = indices[i + (k + 1) % 3];
+            bool twin = false;
+            uint32_t end = positionOf[to];
+            for (uint32_t t = triangleOffsets[end]; t < triangleOffsets[end + 1] && !twin; t++) {
+                const uint32_t* corners = &indices[triangles[t] * 3];
+                for (int j = 0; j < 3; j++) {
+                    twin |= corners[j] == to && corners[(j + 1) % 3] == from;
+                }
+            }
+            borderEdges[i + k] = !twin;
+        }
+    }
+
+    // A wedge on a border or seam has one border edge leaving and one
+    // arriving; anything else (corners, non-manifold fans, poles) stays
+    std::vector<uint8_t> wedgeBorders(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (borderEdges[i]) {
+            uint32_t from = indices[i];
+            uint32_t to = indices[i % 3 == 2 ? i - 2 : i + 1];
+            wedgeBorders[from] = (uint8_t)std::min(wedgeBorders[from] + 1, 255);
+            wedgeBorders[to] = (uint8_t)std::min(wedgeBorders[to] + 1, 255);
+        }
+    }
+    locked.assign(vertexCount, 0);
+    onBorder.assign(vertexCount, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (wedgeBorders[v] != 0 && wedgeBorders[v] != 2) {
+            locked[positionOf[v]] = 1;
+        }
+        if (wedgeBorders[v] != 0) {
+            onBorder[positionOf[v]] = 1;
+        }
+    }
+}
+
+bool Simplifier::canCollapse(uint32_t from, uint32_t to, bool borderEdge) const {
+    // Border positions only slide along the border
+    return !locked[from] && (!onBorder[from] || borderEdge) && from != to;
+}
+
+bool Simplifier::tryCollapse(uint32_t from, uint32_t to, size_t& removedTriangles) {
+    const glm::vec3& target = position(to);
+    wedgeMap.clear();
+    size_t removed = 0;
+    for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+        const uint32_t* corners = &indices[triangles[t] * 3];
+        int fromCorner = -1, toCorner = -1;
+        for (int k = 0; k < 3; k++) {
+            uint32_t p = positionOf[corners[k]];
+            if (p == from) {
+                fromCorner = k;
+            } else if (p == to) {
+                toCorner = k;
+            }
+        }
+        if (toCorner >= 0) {
+            // Degenerates; its edge pairs a wedge of from with one of to
+            uint32_t wedge = corners[fromCorner];
+            auto it = std::find_if(wedgeMap.begin(), wedgeMap.end(), [&](const auto& entry) {
+                return entry.first == wedge;
+            });
+            if (it == wedgeMap.end()) {
+                wedgeMap.emplace_back(wedge, corners[toCorner]);
+            } else if (it->second != corners[toCorner]) {
+                return false;
+            }
+            removed++;
+            continue;
+        }
+        // Any other triangle must not fold over
+        glm::vec3 p[3] = {position(corners[0]), position(corners[1]), position(corners[2])};
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        p[fromCorner] = target;
+        glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+        if (glm::dot(before, after) <= 0.0f) {
+            return false;
+        }
+    }
+    // Every wedge still in use needs a wedge of the target on its side of
+    // the seam
+    for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+        const uint32_t* corners = &indices[triangles[t] * 3];
+        for (int k = 0; k < 3; k++) {
+            if (positionOf[corners[k]] == from &&
+                std::none_of(wedgeMap.begin(), wedgeMap.end(), [&](const auto& e) { return e.first == corners[k]; })) {
+                return false;
+            }
+        }
+    }
+
+    for (const auto& [wedge, targetWedge] : wedgeMap) {
+        collapseTo[wedge] = targetWedge;
+    }
+    quadrics[to] += quadrics[from];
+    // The neighbourhood is frozen for the rest of the pass, which keeps the
+    // fold-over tests above valid
+    for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+        for (int k = 0; k < 3; k++) {
+            touched[positionOf[indices[triangles[t] * 3 + k]]] = 1;
+        }
+    }
+    removedTriangles += removed;
+    return true;
+}
+
+size_t Simplifier::runPass(size_t targetTriangles, double maxError) {
+    buildTopology();
+
+    candidates.clear();
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = indices[i + k];
+            uint32_t b = indices[i + (k + 1) % 3];
+            uint32_t pa = positionOf[a];
+            uint32_t pb = positionOf[b];
+            bool border = borderEdges[i + k];
+            // Interior edges are seen from both sides; take them once
+            if (pa == pb || (!border && pa > pb)) {
+                continue;
+            }
+            Candidate best{NO_VERTEX, NO_VERTEX, 0.0};
+            for (int direction = 0; direction < 2; direction++) {
+                uint32_t from = direction ? pb : pa;
+                uint32_t to = direction ? pa : pb;
+                if (!canCollapse(from, to, border)) {
+                    continue;
+                }
+                Quadric merged = quadrics[from];
+                merged += quadrics[to];
+                double cost = merged.error(position(to));
+                if (best.from == NO_VERTEX || cost < best.cost) {
+                    best = Candidate{from, to, cost};
+                }
+            }
+            if (best.from != NO_VERTEX) {
+                candidates.push_back(best);
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+
+    std::iota(collapseTo.begin(), collapseTo.end(), 0);
+    std::fill(touched.begin(), touched.end(), 0);
+    size_t triangleCount = indices.size() / 3;
+    size_t removed = 0;
+    size_t collapses = 0;
+    for (const Candidate& candidate : candidates) {
+        if (candidate.cost > maxError * maxError || triangleCount - removed <= targetTriangles) {
+            break;
+        }
+        if (touched[candidate.from] || touched[candidate.to]) {
+            continue;
+        }
+        if (tryCollapse(candidate.from, candidate.to, removed)) {
+            maxCost = std::max(maxCost, candidate.cost);
+            collapses++;
+        }
+    }
+
+    // Remap, dropping the triangles that collapsed
+    size_t write = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        uint32_t a = collapseTo[indices[i]];
+        uint32_t b = collapseTo[indices[i + 1]];
+        uint32_t c = collapseTo[indices[i + 2]];
+        if (a != b && b != c && a != c) {
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+    }
+    indices.resize(write);
+    return collapses;
+}
+
+void Simplifier::run(size_t targetIndexCount, float maxError) {
+    size_t targetTriangles = targetIndexCount / 3;
+    while (indices.size() / 3 > targetTriangles) {
+        if (runPass(targetTriangles, maxError) == 0) {
+            break;
+        }
+    }
+}
+
+} // namespace
+
+float simplifyMesh(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                   size_t targetIndexCount, float maxError, std::vector<uint32_t>& result) {
+    Simplifier simplifier(vertices, vertexCount, indices, indexCount);
+    simplifier.run(targetIndexCount, maxError);
+    result = simplifier.getIndices();
+    return simplifier.getError();
+}
+
+std::vector<MeshLodData> generateLods(const MeshData& mesh, unsigned int levelCount, float maxError) {
+    std::vector<MeshLodData> levels;
+    if (mesh.vertices.empty()) {
+        return levels;
+    }
+    glm::vec3 lower = mesh.vertices[0].position;
+    glm::vec3 upper = lower;
+    for (const MeshVertex& vertex : mesh.vertices) {
+        lower = glm::min(lower, vertex.position);
+        upper = glm::max(upper, vertex.position);
+    }
+    float errorLimit = maxError * glm::length(upper - lower);
+
+    Simplifier simplifier(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+    size_t previousCount = mesh.indices.size();
+    for (unsigned int level = 1; level < levelCount; level++) {
+        size_t target = previousCount / 6 * 3;
+        if (target / 3 < MIN_LOD_TRIANGLES) {
+            break;
+        }
+        simplifier.run(target, errorLimit);
+        size_t count = simplifier.getIndices().size();
+        if ((float)count > (float)previousCount * (1.0f - MIN_LOD_REDUCTION)) {
+            break;
+        }
+        MeshLodData lod;
+        lod.mesh.vertices = mesh.vertices;
+        lod.mesh.indices = simplifier.getIndices();
+        lod.error = simplifier.getError();
+        // Vertex fetch optimization drops the vertices it no longer uses
+        optimizeMesh(lod.mesh);
+        levels.push_back(std::move(lod));
+        previousCount = count;
+    }
+    return levels;
+}
+
+std::vector<std::vector<MeshLodData>> generateMeshLods(const std::vector<MeshData>& meshes, ThreadPool* pool,
+                                                       unsigned int levelCount, float maxError) {
+    std::vector<std::vector<MeshLodData>> lods(meshes.size());
+    auto generateRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            lods[i] = generateLods(meshes[i], levelCount, maxError);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(meshes.size(), 1, generateRange);
+    } else {
+        generateRange(0, meshes.size());
+    }
+    return lods;
+}
+
+unsigned int selectLod(const float* errors, unsigned int levelCount, float distance, float pixelsPerUnit,
+                       float threshold, float hysteresis, unsigned int current) {
+    if (distance <= 0.0f) {
+        return 0;
+    }
+    for (unsigned int level = levelCount; level-- > 1;) {
+        float pixels = errors[level] * pixelsPerUnit / distance;
+        float limit = level > current ? threshold * (1.0f - hysteresis) : threshold;
+        if (pixels <= limit) {
+            return level;
+        }
+    }
+    return 0;
+}
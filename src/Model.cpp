@@ -0,0 +1,332 @@
+#include "Model.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const char MAGIC[4] = {'O', 'G', 'L', 'M'};
+// Bump whenever the layout or the import settings change
+const uint32_t VERSION = 4;
+
+struct ModelFileHeader {
+    char magic[4]; // "OGLM"
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime; // last write time of the source, in file clock ticks
+    uint32_t meshCount; // table entries, every level of every mesh
+    uint32_t reserved;
+};
+static_assert(sizeof(ModelFileHeader) == 32, "cache files are read straight from the mapping");
+
+// Vertices are stored encoded, ready to upload. A mesh's levels follow each
+// other in order, so every entry with lod 0 starts the next mesh.
+struct ModelFileMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint8_t positionEncoding;
+    uint8_t normalEncoding;
+    uint8_t texCoordEncoding;
+    uint8_t lod;
+    float lodError;
+    float positionOffset[3];
+    float positionScale[3];
+    float boundsMin[3];
+    float boundsMax[3];
+};
+static_assert(sizeof(ModelFileMesh) == 80, "cache files are read straight from the mapping");
+
+struct EncodedMesh {
+    VertexEncoding encoding;
+    std::vector<uint8_t> vertices;
+    const std::vector<uint32_t>* indices;
+    unsigned int lod;
+    float lodError;
+    Aabb bounds;
+};
+
+Aabb computeBounds(const std::vector<MeshVertex>& vertices) {
+    Aabb box{glm::vec3(0.0f), glm::vec3(0.0f)};
+    if (!vertices.empty()) {
+        box.min = box.max = vertices[0].position;
+    }
+    for (const MeshVertex& vertex : vertices) {
+        box.min = glm::min(box.min, vertex.position);
+        box.max = glm::max(box.max, vertex.position);
+    }
+    return box;
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool writeCache(const std::string& cachePath, const std::vector<EncodedMesh>& meshes, uint64_t sourceSize,
+                int64_t sourceTime) {
+    ModelFileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.meshCount = (uint32_t)meshes.size();
+
+    // Arrays start on 16 byte boundaries so the mapping can be read in place
+    std::vector<ModelFileMesh> table(meshes.size());
+    size_t offset = alignUp(sizeof(ModelFileHeader) + table.size() * sizeof(ModelFileMesh), 16);
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const VertexEncoding& encoding = meshes[i].encoding;
+        table[i] = {};
+        table[i].vertexOffset = offset;
+        table[i].vertexCount = (uint32_t)(meshes[i].vertices.size() / encoding.format.getStride());
+        offset = alignUp(offset + meshes[i].vertices.size(), 16);
+        table[i].indexOffset = offset;
+        table[i].indexCount = (uint32_t)meshes[i].indices->size();
+        offset = alignUp(offset + meshes[i].indices->size() * sizeof(uint32_t), 16);
+        table[i].positionEncoding = (uint8_t)encoding.format.position;
+        table[i].normalEncoding = (uint8_t)encoding.format.normal;
+        table[i].texCoordEncoding = (uint8_t)encoding.format.texCoords;
+        table[i].lod = (uint8_t)meshes[i].lod;
+        table[i].lodError = meshes[i].lodError;
+        for (int c = 0; c < 3; c++) {
+            table[i].positionOffset[c] = encoding.positionOffset[c];
+            table[i].positionScale[c] = encoding.positionScale[c];
+            table[i].boundsMin[c] = meshes[i].bounds.min[c];
+            table[i].boundsMax[c] = meshes[i].bounds.max[c];
+        }
+    }
+
+    // Written under a temporary name and renamed into place, so a reader on
+    // another thread or process never maps a half-written entry
+    std::ostringstream tempPath;
+    tempPath << cachePath << '.' << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+    {
+        std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+        const char padding[16] = {};
+        auto writeAt = [&](uint64_t position, const void* data, size_t size) {
+            file.write(padding, (std::streamsize)(position - (uint64_t)file.tellp()));
+            file.write((const char*)data, (std::streamsize)size);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(sizeof(header), table.data(), table.size() * sizeof(ModelFileMesh));
+        for (size_t i = 0; i < meshes.size(); i++) {
+            writeAt(table[i].vertexOffset, meshes[i].vertices.data(), meshes[i].vertices.size());
+            writeAt(table[i].indexOffset, meshes[i].indices->data(), meshes[i].indices->size() * sizeof(uint32_t));
+        }
+        if (!file) {
+            std::cerr << "ERROR::MODEL_CACHE::CANNOT_WRITE: " << tempPath.str() << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath.str(), cachePath, error);
+    if (error) {
+        std::cerr << "ERROR::MODEL_CACHE::CANNOT_WRITE: " << cachePath << std::endl;
+        std::filesystem::remove(tempPath.str(), error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Model::Model(const std::string& path, const std::string& cacheDirectory, ThreadPool* pool,
+             const VertexFormat& format)
+    : loaded(false), fromCache(false) {
+    std::error_code error;
+    uint64_t sourceSize = std::filesystem::file_size(path, error);
+    int64_t sourceTime = error ? 0 : (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    if (error) {
+        std::cerr << "ERROR::MODEL::FAILED_TO_LOAD: " << path << std::endl;
+        return;
+    }
+
+    std::string cachePath;
+    if (!cacheDirectory.empty()) {
+        std::ostringstream name;
+        name << std::hex << fnv1a64(path) << ".mesh";
+        cachePath = (std::filesystem::path(cacheDirectory) / name.str()).string();
+        if (loadCache(cachePath, sourceSize, sourceTime, format)) {
+            loaded = fromCache = true;
+            return;
+        }
+    }
+
+    std::vector<MeshData> data;
+    if (!import(path, data)) {
+        return;
+    }
+    optimizationStats = optimizeMeshes(data, pool);
+    std::vector<std::vector<MeshLodData>> lodData = generateMeshLods(data, pool);
+
+    std::vector<EncodedMesh> encoded;
+    meshes.reserve(data.size());
+    lods.resize(data.size());
+    lodErrors.resize(data.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        bounds.push_back(computeBounds(data[i].vertices));
+        lodErrors[i].push_back(0.0f);
+        for (size_t level = 0; level <= lodData[i].size(); level++) {
+            const MeshData& levelData = level == 0 ? data[i] : lodData[i][level - 1].mesh;
+            EncodedMesh entry;
+            entry.encoding = encodeVertices(levelData.vertices.data(), levelData.vertices.size(), format,
+                                            entry.vertices);
+            entry.indices = &levelData.indices;
+            entry.lod = (unsigned int)level;
+            entry.lodError = level == 0 ? 0.0f : lodData[i][level - 1].error;
+            entry.bounds = bounds[i];
+            Mesh mesh(entry.vertices.data(), levelData.vertices.size(), entry.encoding, levelData.indices.data(),
+                      levelData.indices.size());
+            if (level == 0) {
+                meshes.push_back(std::move(mesh));
+            } else {
+                lods[i].push_back(std::move(mesh));
+                lodErrors[i].push_back(entry.lodError);
+            }
+            encoded.push_back(std::move(entry));
+        }
+    }
+    loaded = true;
+
+    if (!cachePath.empty()) {
+        std::filesystem::create_directories(cacheDirectory, error);
+        writeCache(cachePath, encoded, sourceSize, sourceTime);
+    }
+}
+
+bool Model::loadCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime,
+                      const VertexFormat& format) {
+    MappedFile file(cachePath);
+    if (!file.isOpen() || file.getSize() < sizeof(ModelFileHeader)) {
+        return false;
+    }
+    const auto* header = (const ModelFileHeader*)file.getData();
+    const auto* table = (const ModelFileMesh*)(file.getData() + sizeof(ModelFileHeader));
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+        header->sourceSize != sourceSize || header->sourceTime != sourceTime ||
+        file.getSize() < sizeof(ModelFileHeader) + header->meshCount * sizeof(ModelFileMesh)) {
+        return false;
+    }
+    // Entries encoded in another format are rebuilt
+    std::vector<VertexEncoding> encodings(header->meshCount);
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        // Levels have to continue the mesh before them
+        if (table[i].lod != 0 && (i == 0 || table[i].lod != table[i - 1].lod + 1)) {
+            return false;
+        }
+        VertexEncoding& encoding = encodings[i];
+        encoding.format.position = (PositionEncoding)table[i].positionEncoding;
+        encoding.format.normal = (NormalEncoding)table[i].normalEncoding;
+        encoding.format.texCoords = (TexCoordEncoding)table[i].texCoordEncoding;
+        encoding.positionOffset = glm::vec3(table[i].positionOffset[0], table[i].positionOffset[1],
+                                            table[i].positionOffset[2]);
+        encoding.positionScale = glm::vec3(table[i].positionScale[0], table[i].positionScale[1],
+                                           table[i].positionScale[2]);
+        if (!(encoding.format == format) ||
+            table[i].vertexOffset + table[i].vertexCount * format.getStride() > file.getSize() ||
+            table[i].indexOffset + table[i].indexCount * sizeof(uint32_t) > file.getSize()) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        Mesh mesh(file.getData() + table[i].vertexOffset, table[i].vertexCount, encodings[i],
+                  (const uint32_t*)(file.getData() + table[i].indexOffset), table[i].indexCount);
+        if (table[i].lod == 0) {
+            meshes.push_back(std::move(mesh));
+            lods.emplace_back();
+            lodErrors.push_back({0.0f});
+            bounds.push_back(Aabb{glm::vec3(table[i].boundsMin[0], table[i].boundsMin[1], table[i].boundsMin[2]),
+                                  glm::vec3(table[i].boundsMax[0], table[i].boundsMax[1], table[i].boundsMax[2])});
+        } else {
+            lods.back().push_back(std::move(mesh));
+            lodErrors.back().push_back(table[i].lodError);
+        }
+    }
+    return true;
+}
+
+bool Model::import(const std::string& path, std::vector<MeshData>& meshes) {
+    Assimp::Importer importer;
+    // Points and lines are split into meshes of their own and skipped below
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+                                                       aiProcess_PreTransformVertices | aiProcess_SortByPType);
+    if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode) {
+        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    meshes.clear();
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+        const aiMesh* mesh = scene->mMeshes[m];
+        if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE)) {
+            continue;
+        }
+
+        // Most importers emit one vertex per face corner; sharing identical
+        // ones shrinks the vertex buffer and lets the post-transform cache work
+        std::vector<MeshVertex> corners;
+        corners.reserve((size_t)mesh->mNumFaces * 3);
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+            const aiFace& face = mesh->mFaces[f];
+            if (face.mNumIndices != 3) {
+                continue;
+            }
+            for (unsigned int k = 0; k < 3; k++) {
+                unsigned int i = face.mIndices[k];
+                // glm vectors are uninitialized by default, and every byte
+                // takes part in the comparison
+                MeshVertex vertex{glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z),
+                                  glm::vec3(0.0f), glm::vec2(0.0f)};
+                if (mesh->HasNormals()) {
+                    vertex.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                }
+                if (mesh->HasTextureCoords(0)) {
+                    vertex.texCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                }
+                corners.push_back(vertex);
+            }
+        }
+        MeshData data = indexVertices(corners.data(), corners.size());
+        if (!data.indices.empty()) {
+            meshes.push_back(std::move(data));
+        }
+    }
+    return true;
+}
+
+size_t Model::getVertexCount() const {
+    size_t count = 0;
+    for (const Mesh& mesh : meshes) {
+        count += mesh.getVertexCount();
+    }
+    return count;
+}
+
+size_t Model::getIndexCount() const {
+    size_t count = 0;
+    for (const Mesh& mesh : meshes) {
+        count += mesh.getIndexCount();
+    }
+    return count;
+}
+
+size_t Model::getVertexBytes() const {
+    size_t bytes = 0;
+    for (const Mesh& mesh : meshes) {
+        bytes += mesh.getVertexBytes();
+    }
+    return bytes;
+}
@@ -0,0 +1,68 @@
+#include "NormalMatrix.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NORMAL_MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
+// For a 3x3 matrix with columns a, b, c the inverse-transpose has columns
+// (b x c, c x a, a x b) / det, where det = a . (b x c)
+glm::mat3 normalMatrix(const glm::mat4& model) {
+    glm::vec3 a(model[0]);
+    glm::vec3 b(model[1]);
+    glm::vec3 c(model[2]);
+
+    glm::vec3 bc = glm::cross(b, c);
+    glm::vec3 ca = glm::cross(c, a);
+    glm::vec3 ab = glm::cross(a, b);
+    float invDet = 1.0f / glm::dot(a, bc);
+
+    return glm::mat3(bc * invDet, ca * invDet, ab * invDet);
+}
+
+void computeNormalMatrices(const glm::mat4* models, glm::mat3* normalMatrices, size_t count) {
+    size_t i = 0;
+
+#ifdef NORMAL_MATRIX_SSE
+    for (; i + 4 <= count; i += 4) {
+        const glm::mat4* m = models + i;
+
+        // Element (col, row) of all four matrices in one register
+        __m128 e[3][3];
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                e[col][row] = _mm_setr_ps(m[0][col][row], m[1][col][row], m[2][col][row], m[3][col][row]);
+            }
+        }
+
+        auto cross = [](const __m128* u, const __m128* v, __m128* out) {
+            out[0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+            out[1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+            out[2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+        };
+
+        __m128 cof[3][3];
+        cross(e[1], e[2], cof[0]);
+        cross(e[2], e[0], cof[1]);
+        cross(e[0], e[1], cof[2]);
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[0][0], cof[0][0]), _mm_mul_ps(e[0][1], cof[0][1])),
+                                _mm_mul_ps(e[0][2], cof[0][2]));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        alignas(16) float lanes[4];
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                _mm_store_ps(lanes, _mm_mul_ps(cof[col][row], invDet));
+                for (int k = 0; k < 4; k++) {
+                    normalMatrices[i + k][col][row] = lanes[k];
+                }
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        normalMatrices[i] = normalMatrix(models[i]);
+    }
+}
@@ -0,0 +1,178 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : width(width), height(height), viewProjection(1.0f) {
+    int levelWidth = width, levelHeight = height;
+    while (true) {
+        levels.emplace_back((size_t)levelWidth * levelHeight, 1.0f);
+        if (levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+        levelWidth = std::max(1, (levelWidth + 1) / 2);
+        levelHeight = std::max(1, (levelHeight + 1) / 2);
+    }
+}
+
+void OcclusionBuffer::clear(const glm::mat4& matrix) {
+    viewProjection = matrix;
+    std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+}
+
+void OcclusionBuffer::rasterize(const glm::mat4& model, const glm::vec3* vertices, size_t vertexCount,
+                                const uint32_t* indices, size_t indexCount) {
+    glm::mat4 modelViewProjection = viewProjection * model;
+    clipVertices.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        clipVertices[i] = modelViewProjection * glm::vec4(vertices[i], 1.0f);
+    }
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const glm::vec4& a = clipVertices[indices[i]];
+        const glm::vec4& b = clipVertices[indices[i + 1]];
+        const glm::vec4& c = clipVertices[indices[i + 2]];
+        // In front of the near plane; dropping an occluder is always safe
+        if (a.z < -a.w || b.z < -b.w || c.z < -c.w) {
+            continue;
+        }
+        rasterizeTriangle(a, b, c);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    // Pixel coordinates, with depth mapped to [0, 1] like the depth buffer
+    glm::vec3 v[3];
+    const glm::vec4* clip[3] = {&a, &b, &c};
+    for (int i = 0; i < 3; i++) {
+        float invW = 1.0f / clip[i]->w;
+        v[i] = glm::vec3((clip[i]->x * invW * 0.5f + 0.5f) * width, (clip[i]->y * invW * 0.5f + 0.5f) * height,
+                         clip[i]->z * invW * 0.5f + 0.5f);
+    }
+
+    // Twice the signed area; back faces are hidden by the front ones
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if (area <= 0.0f) {
+        return;
+    }
+
+    // Only pixels entirely inside the triangle are written
+    float minX = std::min({v[0].x, v[1].x, v[2].x}), maxX = std::max({v[0].x, v[1].x, v[2].x});
+    float minY = std::min({v[0].y, v[1].y, v[2].y}), maxY = std::max({v[0].y, v[1].y, v[2].y});
+    int x0 = (int)std::ceil(std::clamp(minX, 0.0f, (float)width));
+    int x1 = (int)std::floor(std::clamp(maxX, 0.0f, (float)width)) - 1;
+    int y0 = (int)std::ceil(std::clamp(minY, 0.0f, (float)height));
+    int y1 = (int)std::floor(std::clamp(maxY, 0.0f, (float)height)) - 1;
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+
+    // Edge function i, opposite vertex i, is edgeX * x + edgeY * y + edgeC
+    // and positive inside. Shifting it by half the pixel's extent along the
+    // edge normal makes it test the pixel's innermost corner rather than its
+    // center, i.e. full coverage.
+    float edgeX[3], edgeY[3], edgeC[3];
+    for (int i = 0; i < 3; i++) {
+        const glm::vec3& p = v[(i + 1) % 3];
+        const glm::vec3& q = v[(i + 2) % 3];
+        edgeX[i] = p.y - q.y;
+        edgeY[i] = q.x - p.x;
+        edgeC[i] = p.x * q.y - p.y * q.x - 0.5f * (std::abs(edgeX[i]) + std::abs(edgeY[i]));
+    }
+
+    // Depth is linear in screen space; its largest value over a pixel is at
+    // the center plus half the slope in each direction
+    float invArea = 1.0f / area;
+    float depthX = (edgeX[0] * v[0].z + edgeX[1] * v[1].z + edgeX[2] * v[2].z) * invArea;
+    float depthY = (edgeY[0] * v[0].z + edgeY[1] * v[1].z + edgeY[2] * v[2].z) * invArea;
+    float depthAt00 = v[0].z - depthX * v[0].x - depthY * v[0].y + 0.5f * (std::abs(depthX) + std::abs(depthY));
+    float maxDepth = std::max({v[0].z, v[1].z, v[2].z});
+
+    std::vector<float>& depth = levels[0];
+    for (int y = y0; y <= y1; y++) {
+        float centerX = x0 + 0.5f, centerY = y + 0.5f;
+        float e0 = edgeX[0] * centerX + edgeY[0] * centerY + edgeC[0];
+        float e1 = edgeX[1] * centerX + edgeY[1] * centerY + edgeC[1];
+        float e2 = edgeX[2] * centerX + edgeY[2] * centerY + edgeC[2];
+        float z = depthAt00 + depthX * centerX + depthY * centerY;
+        float* row = &depth[(size_t)y * width];
+        for (int x = x0; x <= x1; x++) {
+            if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                row[x] = std::min(row[x], std::min(z, maxDepth));
+            }
+            e0 += edgeX[0];
+            e1 += edgeX[1];
+            e2 += edgeX[2];
+            z += depthX;
+        }
+    }
+}
+
+void OcclusionBuffer::buildHierarchy() {
+    int sourceWidth = width, sourceHeight = height;
+    for (size_t level = 1; level < levels.size(); level++) {
+        int levelWidth = std::max(1, (sourceWidth + 1) / 2);
+        int levelHeight = std::max(1, (sourceHeight + 1) / 2);
+        const std::vector<float>& source = levels[level - 1];
+        std::vector<float>& target = levels[level];
+        for (int y = 0; y < levelHeight; y++) {
+            // Odd sizes repeat the last row or column
+            int sy0 = 2 * y, sy1 = std::min(2 * y + 1, sourceHeight - 1);
+            for (int x = 0; x < levelWidth; x++) {
+                int sx0 = 2 * x, sx1 = std::min(2 * x + 1, sourceWidth - 1);
+                target[(size_t)y * levelWidth + x] =
+                    std::max(std::max(source[(size_t)sy0 * sourceWidth + sx0], source[(size_t)sy0 * sourceWidth + sx1]),
+                             std::max(source[(size_t)sy1 * sourceWidth + sx0], source[(size_t)sy1 * sourceWidth + sx1]));
+            }
+        }
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+}
+
+bool OcclusionBuffer::isVisible(const Aabb& box) const {
+    glm::vec2 lower(FLT_MAX), upper(-FLT_MAX);
+    float nearest = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 clip = viewProjection * glm::vec4(corner & 1 ? box.max.x : box.min.x,
+                                                    corner & 2 ? box.max.y : box.min.y,
+                                                    corner & 4 ? box.max.z : box.min.z, 1.0f);
+        // Boxes crossing the near plane surround the camera
+        if (clip.z < -clip.w) {
+            return true;
+        }
+        float invW = 1.0f / clip.w;
+        glm::vec2 pixel((clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height);
+        lower = glm::min(lower, pixel);
+        upper = glm::max(upper, pixel);
+        nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+    }
+
+    // Every pixel the rectangle touches; ones entirely off screen are left to
+    // frustum culling
+    if (upper.x < 0.0f || upper.y < 0.0f || lower.x >= (float)width || lower.y >= (float)height) {
+        return true;
+    }
+    int x0 = (int)std::max(lower.x, 0.0f), x1 = (int)std::min(upper.x, (float)width - 1.0f);
+    int y0 = (int)std::max(lower.y, 0.0f), y1 = (int)std::min(upper.y, (float)height - 1.0f);
+
+    // Coarsest useful level: the rectangle covers at most 2x2 texels there
+    size_t level = 0;
+    while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+    int levelWidth = width, levelHeight = height;
+    for (size_t i = 0; i < level; i++) {
+        levelWidth = std::max(1, (levelWidth + 1) / 2);
+        levelHeight = std::max(1, (levelHeight + 1) / 2);
+    }
+    const std::vector<float>& depth = levels[level];
+    for (int y = y0 >> level; y <= std::min(y1 >> level, levelHeight - 1); y++) {
+        for (int x = x0 >> level; x <= std::min(x1 >> level, levelWidth - 1); x++) {
+            if (nearest <= depth[(size_t)y * levelWidth + x]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
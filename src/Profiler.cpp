@@ -0,0 +1,324 @@
+#include "Profiler.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace profiler {
+
+namespace {
+
+// CPU scopes a thread can record between two beginFrame() calls
+const uint64_t RING_CAPACITY = 1 << 14;
+// Track of the GPU scopes; threads are numbered from 1
+const uint32_t GPU_TRACK = 0;
+
+struct CpuEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// One thread's scopes. The owning thread only moves head, the reader only
+// tail, so neither needs a lock.
+struct ThreadBuffer {
+    CpuEvent events[RING_CAPACITY];
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    // Set when the thread is gone; the reader frees the buffer once drained
+    std::atomic<bool> exited{false};
+    uint32_t track = 0;
+    std::string name; // guarded by registryMutex
+};
+
+// The calling thread's buffer, created by its first scope in a capture
+struct ThreadSlot {
+    ThreadBuffer* buffer = nullptr;
+    std::string name;
+
+    ~ThreadSlot() {
+        if (buffer) {
+            buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    uint32_t track;
+};
+
+// Indices into the frame's queries; endQuery stays 0 while the scope is open
+struct GpuRecord {
+    const char* name;
+    uint32_t beginQuery;
+    uint32_t endQuery;
+};
+
+struct GpuFrame {
+    std::vector<GLuint> queries;
+    uint32_t usedQueries = 0;
+    std::vector<GpuRecord> records;
+    // CPU clock minus GPU clock, measured as the frame began
+    int64_t clockOffset = 0;
+};
+
+std::atomic<bool> capturing{false};
+std::atomic<uint64_t> droppedScopes{0};
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> threads;
+// Tracks of freed buffers, still named in the trace
+std::vector<std::pair<uint32_t, std::string>> exitedThreads;
+uint32_t nextTrack = 1;
+thread_local ThreadSlot currentThread;
+
+// GL thread only
+GpuFrame gpuFrames[FRAME_LATENCY];
+unsigned int currentFrame = 0;
+unsigned int lostGpuFrames = 0;
+std::vector<TraceEvent> captured;
+uint64_t captureStart = 0;
+
+uint64_t now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+ThreadBuffer& threadBuffer() {
+    if (!currentThread.buffer) {
+        auto buffer = std::make_unique<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->track = nextTrack++;
+        buffer->name =
+            currentThread.name.empty() ? "Thread " + std::to_string(buffer->track) : currentThread.name;
+        currentThread.buffer = buffer.get();
+        threads.push_back(std::move(buffer));
+    }
+    return *currentThread.buffer;
+}
+
+uint32_t timestamp(GpuFrame& frame) {
+    if (frame.usedQueries == frame.queries.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    glQueryCounter(frame.queries[frame.usedQueries], GL_TIMESTAMP);
+    return frame.usedQueries++;
+}
+
+// Moves a frame's GPU scopes into the capture and frees its queries for
+// reuse. Without wait, a frame whose queries are not done yet is dropped.
+void resolveFrame(GpuFrame& frame, bool wait) {
+    if (!frame.records.empty() && capturing) {
+        GLint available = GL_TRUE;
+        if (!wait) {
+            // Timestamps complete in order, so the last one stands for all
+            glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (!available) {
+            lostGpuFrames++;
+        } else {
+            for (const GpuRecord& record : frame.records) {
+                if (record.endQuery == 0) {
+                    continue;
+                }
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.queries[record.beginQuery], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[record.endQuery], GL_QUERY_RESULT, &end);
+                captured.push_back(TraceEvent{record.name, (uint64_t)((int64_t)begin + frame.clockOffset),
+                                              (uint64_t)((int64_t)end + frame.clockOffset), GPU_TRACK});
+            }
+        }
+    }
+    frame.records.clear();
+    frame.usedQueries = 0;
+}
+
+// Empties every thread's ring, into the capture if there is one
+void drainThreads() {
+    bool keep = capturing;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto it = threads.begin(); it != threads.end();) {
+        ThreadBuffer& buffer = **it;
+        // Checked first: once it is set, head does not move any more
+        bool exited = buffer.exited.load(std::memory_order_acquire);
+        uint64_t tail = buffer.tail.load(std::memory_order_relaxed);
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        for (; keep && tail < head; tail++) {
+            const CpuEvent& event = buffer.events[tail % RING_CAPACITY];
+            captured.push_back(TraceEvent{event.name, event.start, event.end, buffer.track});
+        }
+        buffer.tail.store(head, std::memory_order_release);
+        if (exited) {
+            exitedThreads.emplace_back(buffer.track, buffer.name);
+            it = threads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void writeEscaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << (c < ' ' ? ' ' : c);
+    }
+}
+
+void writeThreadName(std::ostream& out, uint32_t track, const std::string& name) {
+    out << "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track
+        << ", \"args\": {\"name\": \"";
+    writeEscaped(out, name);
+    out << "\"}},\n";
+}
+
+} // namespace
+
+CpuScope::CpuScope(const char* name) : name(name), start(capturing.load(std::memory_order_relaxed) ? now() : 0) {}
+
+CpuScope::~CpuScope() {
+    if (start == 0) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        droppedScopes.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[head % RING_CAPACITY] = CpuEvent{name, start, now()};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+GpuScope::GpuScope(const char* name) : record(-1) {
+    if (!capturing.load(std::memory_order_relaxed)) {
+        return;
+    }
+    GpuFrame& frame = gpuFrames[currentFrame];
+    record = (int)frame.records.size();
+    frame.records.push_back(GpuRecord{name, timestamp(frame), 0});
+}
+
+GpuScope::~GpuScope() {
+    GpuFrame& frame = gpuFrames[currentFrame];
+    // The capture may have ended, and taken the record with it, meanwhile
+    if (record >= 0 && (size_t)record < frame.records.size()) {
+        frame.records[record].endQuery = timestamp(frame);
+    }
+}
+
+void beginFrame() {
+    currentFrame = (currentFrame + 1) % FRAME_LATENCY;
+    GpuFrame& frame = gpuFrames[currentFrame];
+    resolveFrame(frame, false);
+    if (capturing) {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        frame.clockOffset = (int64_t)now() - gpuNow;
+    }
+    drainThreads();
+}
+
+void setThreadName(const std::string& name) {
+    currentThread.name = name;
+    if (currentThread.buffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        currentThread.buffer->name = name;
+    }
+}
+
+void beginCapture() {
+    if (capturing) {
+        return;
+    }
+    // Whatever was recorded before belongs to no capture
+    drainThreads();
+    captured.clear();
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        exitedThreads.clear();
+    }
+    droppedScopes = 0;
+    lostGpuFrames = 0;
+    captureStart = now();
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuFrames[currentFrame].clockOffset = (int64_t)captureStart - gpuNow;
+    capturing = true;
+}
+
+bool endCapture(const std::string& path) {
+    if (!capturing) {
+        return false;
+    }
+    // Oldest frame first, ending with the current one
+    for (unsigned int i = 1; i <= FRAME_LATENCY; i++) {
+        resolveFrame(gpuFrames[(currentFrame + i) % FRAME_LATENCY], true);
+    }
+    drainThreads();
+    capturing = false;
+
+    std::sort(captured.begin(), captured.end(),
+              [](const TraceEvent& a, const TraceEvent& b) { return a.start < b.start; });
+    std::ofstream file(path);
+    file << "{\n  \"traceEvents\": [\n";
+    writeThreadName(file, GPU_TRACK, "GPU");
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : threads) {
+            writeThreadName(file, buffer->track, buffer->name);
+        }
+        for (const auto& thread : exitedThreads) {
+            writeThreadName(file, thread.first, thread.second);
+        }
+    }
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for (const TraceEvent& event : captured) {
+        // Microseconds from the start of the capture
+        double start = (double)((int64_t)event.start - (int64_t)captureStart) / 1000.0;
+        double duration = (double)(event.end - std::min(event.start, event.end)) / 1000.0;
+        file << "    {\"name\": \"";
+        writeEscaped(file, event.name);
+        file << "\", \"cat\": \"" << (event.track == GPU_TRACK ? "gpu" : "cpu") << "\", \"ph\": \"X\", \"pid\": 1, "
+             << "\"tid\": " << event.track << ", \"ts\": " << start << ", \"dur\": " << duration << "},\n";
+    }
+    // Metadata last, which also spares the trailing comma
+    file << "    {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"OpenGL-Learn\"}}\n";
+    file << "  ],\n  \"displayTimeUnit\": \"ms\",\n";
+    file << "  \"otherData\": {\"droppedCpuScopes\": " << droppedScopes << ", \"lostGpuFrames\": " << lostGpuFrames
+         << "}\n}\n";
+    captured.clear();
+    if (!file) {
+        std::cerr << "ERROR::PROFILER::CANNOT_WRITE: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool isCapturing() {
+    return capturing;
+}
+
+void shutdown() {
+    for (GpuFrame& frame : gpuFrames) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+        }
+        frame = GpuFrame{};
+    }
+}
+
+} // namespace profiler
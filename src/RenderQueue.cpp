@@ -0,0 +1,174 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "Texture.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int DEPTH_SHIFT = 0;
+const int GEOMETRY_SHIFT = DEPTH_SHIFT + RenderQueue::DEPTH_BITS;
+const int MATERIAL_SHIFT = GEOMETRY_SHIFT + RenderQueue::GEOMETRY_BITS;
+const int PROGRAM_SHIFT = MATERIAL_SHIFT + RenderQueue::MATERIAL_BITS;
+const int LAYER_SHIFT = PROGRAM_SHIFT + RenderQueue::PROGRAM_BITS;
+
+uint32_t field(uint64_t key, int shift, int bits) {
+    return (uint32_t)(key >> shift) & ((1u << bits) - 1);
+}
+
+unsigned int countStateChanges(const std::vector<DrawPacket>& packets) {
+    const uint64_t stateMask = ~((uint64_t(1) << GEOMETRY_SHIFT) - 1) & ((uint64_t(1) << LAYER_SHIFT) - 1);
+    unsigned int changes = 0;
+    uint64_t previous = 0;
+    for (size_t i = 0; i < packets.size(); i++) {
+        uint64_t state = packets[i].key & stateMask;
+        if (i == 0) {
+            changes += 3;
+        } else if (state != previous) {
+            uint64_t changed = state ^ previous;
+            changes += (field(changed, PROGRAM_SHIFT, RenderQueue::PROGRAM_BITS) != 0) +
+                       (field(changed, MATERIAL_SHIFT, RenderQueue::MATERIAL_BITS) != 0) +
+                       (field(changed, GEOMETRY_SHIFT, RenderQueue::GEOMETRY_BITS) != 0);
+        }
+        previous = state;
+    }
+    return changes;
+}
+
+} // namespace
+
+uint64_t RenderQueue::makeKey(uint32_t layer, uint32_t program, uint32_t material, uint32_t geometry, float depth) {
+    // Non-negative floats order like their bit patterns, so the top bits of
+    // one keep the ordering at reduced precision
+    uint32_t depthBits;
+    depth = std::max(depth, 0.0f);
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    return (uint64_t)layer << LAYER_SHIFT | (uint64_t)program << PROGRAM_SHIFT |
+           (uint64_t)material << MATERIAL_SHIFT | (uint64_t)geometry << GEOMETRY_SHIFT |
+           (uint64_t)(depthBits >> (32 - DEPTH_BITS)) << DEPTH_SHIFT;
+}
+
+uint32_t RenderQueue::addProgram(const RenderProgram& program) {
+    programs.push_back(program);
+    return (uint32_t)programs.size() - 1;
+}
+
+uint32_t RenderQueue::addMaterial(const RenderMaterial& material) {
+    materials.push_back(material);
+    return (uint32_t)materials.size() - 1;
+}
+
+uint32_t RenderQueue::addGeometry(const RenderGeometry& geometry) {
+    geometries.push_back(geometry);
+    return (uint32_t)geometries.size() - 1;
+}
+
+void RenderQueue::clearStates() {
+    programs.clear();
+    materials.clear();
+    geometries.clear();
+    packets.clear();
+}
+
+void RenderQueue::clear() {
+    packets.clear();
+    stats = RenderQueueStats{};
+}
+
+DrawPacket* RenderQueue::allocate(size_t count) {
+    size_t first = packets.size();
+    packets.resize(first + count);
+    return packets.data() + first;
+}
+
+void RenderQueue::sort() {
+    stats.packets = (unsigned int)packets.size();
+    stats.unsortedStateChanges = countStateChanges(packets);
+
+    // LSD radix sort, a byte per pass. One pass builds all eight histograms,
+    // and bytes every key has in common (most of the state bits, in practice)
+    // are skipped.
+    size_t counts[8][256] = {};
+    for (const DrawPacket& packet : packets) {
+        for (int pass = 0; pass < 8; pass++) {
+            counts[pass][(packet.key >> (pass * 8)) & 0xff]++;
+        }
+    }
+    sortScratch.resize(packets.size());
+    for (int pass = 0; pass < 8; pass++) {
+        size_t* count = counts[pass];
+        if (packets.empty() || count[(packets[0].key >> (pass * 8)) & 0xff] == packets.size()) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t digitCount = count[digit];
+            count[digit] = offset;
+            offset += digitCount;
+        }
+        for (const DrawPacket& packet : packets) {
+            sortScratch[count[(packet.key >> (pass * 8)) & 0xff]++] = packet;
+        }
+        packets.swap(sortScratch);
+    }
+
+    stats.stateChanges = countStateChanges(packets);
+}
+
+unsigned int RenderQueue::execute(uint32_t layer) const {
+    auto first = std::partition_point(packets.begin(), packets.end(), [layer](const DrawPacket& packet) {
+        return (packet.key >> LAYER_SHIFT) < layer;
+    });
+    auto last = std::partition_point(first, packets.end(), [layer](const DrawPacket& packet) {
+        return (packet.key >> LAYER_SHIFT) <= layer;
+    });
+
+    // Indices past any valid one, so the first packet binds everything
+    uint32_t program = UINT32_MAX, material = UINT32_MAX, geometry = UINT32_MAX;
+    unsigned int drawCalls = 0;
+    for (auto packet = first; packet != last; ++packet) {
+        uint32_t packetProgram = field(packet->key, PROGRAM_SHIFT, PROGRAM_BITS);
+        uint32_t packetMaterial = field(packet->key, MATERIAL_SHIFT, MATERIAL_BITS);
+        uint32_t packetGeometry = field(packet->key, GEOMETRY_SHIFT, GEOMETRY_BITS);
+        const RenderProgram& state = programs[packetProgram];
+        const RenderGeometry& mesh = geometries[packetGeometry];
+
+        bool programChanged = packetProgram != program;
+        bool geometryChanged = packetGeometry != geometry;
+        if (programChanged) {
+            state.shader->use();
+            program = packetProgram;
+        }
+        if (packetMaterial != material) {
+            const RenderMaterial& textures = materials[packetMaterial];
+            if (textures.diffuse) {
+                textures.diffuse->bind(0);
+            }
+            if (textures.specular) {
+                textures.specular->bind(1);
+            }
+            if (textures.normal) {
+                textures.normal->bind(5);
+            }
+            material = packetMaterial;
+        }
+        if (geometryChanged) {
+            glstate::bindVertexArray(mesh.vao);
+            geometry = packetGeometry;
+        }
+        if (programChanged || geometryChanged) {
+            state.shader->setBool(state.octahedralNormals, mesh.octahedralNormals);
+        }
+
+        if (packet->instance) {
+            state.shader->setMat4(state.model, packet->instance->model);
+            state.shader->setMat3(state.normalMatrix, packet->instance->normalMatrix);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+        } else {
+            glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0,
+                                    (GLsizei)packet->instanceCount);
+        }
+        drawCalls++;
+    }
+    return drawCalls;
+}
@@ -0,0 +1,1054 @@
+#include "Renderer.h"
+#include "Camera.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "NormalMatrix.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+namespace {
+
+float vertices[] = {
+    // positions          // normals           // texture coords
+    -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+    0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
+    0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
+    -0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+
+    -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+    -0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+
+    -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    -0.5f, 0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+    -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+
+    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+    0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+    0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+    0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+
+    -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
+    0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,
+    0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+    0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
+
+    -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+    -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+    -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+
+// Cube positions
+glm::vec3 cubePositions[] = {
+    glm::vec3(0.0f, 0.0f, 0.0f),
+    glm::vec3(2.0f, 5.0f, -15.0f),
+    glm::vec3(-1.5f, -2.2f, -2.5f),
+    glm::vec3(-3.8f, -2.0f, -12.3f),
+    glm::vec3(2.4f, -0.4f, -3.5f),
+    glm::vec3(-1.7f, 3.0f, -7.5f),
+    glm::vec3(1.3f, -2.0f, -2.5f),
+    glm::vec3(1.5f, 2.0f, -2.5f),
+    glm::vec3(1.5f, 0.2f, -1.5f),
+    glm::vec3(-1.3f, 1.0f, -1.5f)};
+
+// Light Positions
+glm::vec3 pointLightPositions[] = {
+    glm::vec3(0.7f, 0.2f, 2.0f),
+    glm::vec3(2.3f, -3.3f, -4.0f),
+    glm::vec3(-4.0f, 2.0f, -12.0f),
+    glm::vec3(0.0f, 0.0f, -3.0f)};
+
+// Light volume: a cube with consistent outward (counter-clockwise) winding,
+// unlike the textured one above, so its front faces can be culled
+float volumeVertices[] = {
+    -0.5f, -0.5f, -0.5f,
+    0.5f, -0.5f, -0.5f,
+    -0.5f, 0.5f, -0.5f,
+    0.5f, 0.5f, -0.5f,
+    -0.5f, -0.5f, 0.5f,
+    0.5f, -0.5f, 0.5f,
+    -0.5f, 0.5f, 0.5f,
+    0.5f, 0.5f, 0.5f};
+
+unsigned int volumeIndices[] = {
+    0, 4, 6, 0, 6, 2, // -x
+    1, 3, 7, 1, 7, 5, // +x
+    0, 1, 5, 0, 5, 4, // -y
+    2, 6, 7, 2, 7, 3, // +y
+    0, 2, 3, 0, 3, 1, // -z
+    4, 5, 7, 4, 7, 6  // +z
+};
+
+// Occluders per frame, picked among the cubes in view nearest the camera
+const size_t MAX_OCCLUDERS = 64;
+
+// Render queue layers: lit objects go through the forward or the G-buffer
+// shaders, unlit light sources are drawn forward on top afterwards. Shadow
+// casters are drawn before either, a layer per cascade.
+const uint32_t LIT_LAYER = 0;
+const uint32_t UNLIT_LAYER = 1;
+const uint32_t SHADOW_LAYER = 2;
+
+// Depth bias for shadow casters, scaled by their slope and in depth buffer
+// steps; the receivers' normal offset takes care of the rest
+const float SHADOW_SLOPE_BIAS = 2.0f;
+const float SHADOW_CONSTANT_BIAS = 2.0f;
+
+// Per-object packets recorded per task
+const size_t PACKET_GRAIN = 4096;
+
+// Transient lists built during a frame; overflowing only costs heap calls
+const size_t FRAME_ARENA_SIZE = 64 * 1024;
+
+// Closest a model mesh's bounding sphere counts as being to the camera when
+// picking its level of detail, in world units
+const float MIN_LOD_DISTANCE = 0.01f;
+
+// 16 bytes per vertex instead of 32
+const VertexFormat CUBE_VERTEX_FORMAT = {PositionEncoding::Half, NormalEncoding::Octahedral, TexCoordEncoding::Half};
+
+// Attribute locations 3-6 hold the model matrix columns, 7-9 the normal
+// matrix columns (see shaders/instanced.vertex.glsl). They read instances
+// from the bound array buffer, starting offset bytes in.
+void setInstanceAttributes(size_t offset) {
+  for (unsigned int i = 0; i < 4; i++) {
+    glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(offset + i * sizeof(glm::vec4)));
+  }
+  for (unsigned int i = 0; i < 3; i++) {
+    glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void *)(offset + sizeof(glm::mat4) + i * sizeof(glm::vec3)));
+  }
+}
+
+void setupInstanceAttributes() {
+  setInstanceAttributes(0);
+  for (unsigned int i = 3; i < 10; i++) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
+}
+
+// Permutation features a material's textures call for
+uint32_t materialFeatures(const RenderMaterial &material) {
+  return (material.diffuse ? ShaderFeature::DiffuseMap : 0u) | (material.specular ? ShaderFeature::SpecularMap : 0u) |
+         (material.normal ? ShaderFeature::NormalMap : 0u);
+}
+
+} // namespace
+
+Renderer::Renderer(unsigned int cubeCount, unsigned int lightCount, SubmissionMode mode)
+    : lightShader(SHADER_DIR "/vertex.glsl", SHADER_DIR "/light.fragment.glsl", &shaderCache),
+      lightInstancedShader(SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/light.fragment.glsl", &shaderCache),
+      lightVolumeShader(SHADER_DIR "/lightvolume.vertex.glsl", SHADER_DIR "/lightvolume.fragment.glsl", &shaderCache),
+      objectShaders(SHADER_DIR "/vertex.glsl", SHADER_DIR "/object.fragment.glsl", &shaderCache),
+      objectInstancedShaders(SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/object.fragment.glsl", &shaderCache),
+      gbufferShaders(SHADER_DIR "/vertex.glsl", SHADER_DIR "/gbuffer.fragment.glsl", &shaderCache,
+                     ShaderFeature::DiffuseMap | ShaderFeature::SpecularMap | ShaderFeature::NormalMap),
+      gbufferInstancedShaders(SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/gbuffer.fragment.glsl", &shaderCache,
+                              ShaderFeature::DiffuseMap | ShaderFeature::SpecularMap | ShaderFeature::NormalMap),
+      deferredShaders(SHADER_DIR "/deferred.vertex.glsl", SHADER_DIR "/deferred.fragment.glsl", &shaderCache,
+                      ShaderFeature::DirLight | ShaderFeature::DirShadow | ShaderFeature::SpotLight),
+      lightingFeatures(0), objectShader(nullptr), objectInstancedShader(nullptr), gbufferShader(nullptr),
+      gbufferInstancedShader(nullptr), deferredShader(nullptr),
+      depthShader(SHADER_DIR "/vertex.glsl", SHADER_DIR "/depth.fragment.glsl", &shaderCache),
+      depthInstancedShader(SHADER_DIR "/instanced.vertex.glsl", SHADER_DIR "/depth.fragment.glsl", &shaderCache),
+      vbo(nullptr, 0), cubeEbo(nullptr, 0), objectVao(0), lightVao(0), shadowVao(0), frameArena(FRAME_ARENA_SIZE),
+      textureLoader(threadPool, &textureCache), diffuseMap(textureLoader.load("textures/container2.png")),
+      specularMap(textureLoader.load("textures/container2_specular.png")),
+      uniformAlignment(StreamBuffer::getUniformOffsetAlignment()), lightsOffset(0), shadowsOffset(0), frameUniformSize(0),
+      lights{}, lightClusters(&threadPool), pointLightBuffer(GL_RGBA32F, nullptr, 0, GL_STATIC_DRAW),
+      clusterBuffer(GL_RG32UI, nullptr, 0), lightIndexBuffer(GL_R32UI, nullptr, 0),
+      lightVolumeVbo(volumeVertices, sizeof(volumeVertices)),
+      lightVolumeEbo(volumeIndices, sizeof(volumeIndices) / sizeof(unsigned int)),
+      lightVolumeVao(0), screenVao(0), scene(&threadPool), cubeBvh(&threadPool), lightBvh(&threadPool),
+      occlusionCulling(true), sceneModel(nullptr),
+      sceneModelTransform{glm::mat4(1.0f), glm::mat3(1.0f)}, lodEnabled(true),
+      lodThreshold(DEFAULT_LOD_THRESHOLD), lodHysteresis(DEFAULT_LOD_HYSTERESIS), shadowInstanceOffsets{},
+      shadowPending{}, shadows(true), shadowCaching(true), submissionMode(mode), renderPath(RenderPath::Forward),
+      spotlight(false) {
+  // The cube is listed as an unindexed triangle list in MeshVertex layout.
+  // Its coordinates are all multiples of 0.5, exact as half floats.
+  static_assert(sizeof(vertices) % sizeof(MeshVertex) == 0, "cube vertices must match MeshVertex");
+  MeshData cube = indexVertices((const MeshVertex *)vertices, sizeof(vertices) / (sizeof(float) * 8));
+  optimizeMesh(cube);
+  std::vector<uint8_t> cubeVertices;
+  encodeVertices(cube.vertices.data(), cube.vertices.size(), CUBE_VERTEX_FORMAT, cubeVertices);
+  vbo.setData(cubeVertices.data(), cubeVertices.size());
+  cubeEbo.setData(cube.indices.data(), cube.indices.size());
+
+  buildLights(lightCount);
+  buildInstances(cubeCount);
+  pointLightBuffer.setData(pointLights.data(), pointLights.size() * sizeof(PointLight), GL_STATIC_DRAW);
+
+  // The blocks share one allocation; the Lights and Shadows ranges must
+  // start on the driver's offset alignment
+  lightsOffset = std140::alignUp(sizeof(CameraBlock), uniformAlignment);
+  shadowsOffset = std140::alignUp(lightsOffset + sizeof(LightsBlock), uniformAlignment);
+  frameUniformSize = shadowsOffset + sizeof(ShadowsBlock);
+  setPersistentStreaming(true);
+
+  // Create vertex array objects sharing one vertex buffer
+  glGenVertexArrays(1, &lightVao);
+  glGenVertexArrays(1, &objectVao);
+  glGenVertexArrays(1, &shadowVao);
+
+  glstate::bindVertexArray(lightVao);
+  vbo.bind();
+  cubeEbo.bind();
+  setVertexAttributes(CUBE_VERTEX_FORMAT);
+  frameData->bind();
+  setupInstanceAttributes();
+
+  glstate::bindVertexArray(objectVao);
+  vbo.bind();
+  cubeEbo.bind();
+  setVertexAttributes(CUBE_VERTEX_FORMAT);
+  frameData->bind();
+  setupInstanceAttributes();
+
+  glstate::bindVertexArray(shadowVao);
+  vbo.bind();
+  cubeEbo.bind();
+  setVertexAttributes(CUBE_VERTEX_FORMAT);
+  frameData->bind();
+  setupInstanceAttributes();
+
+  // Light volumes read their transform from the light buffer by instance
+  glGenVertexArrays(1, &lightVolumeVao);
+  glstate::bindVertexArray(lightVolumeVao);
+  lightVolumeVbo.bind();
+  lightVolumeEbo.bind();
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  // The full-screen triangle has no attributes, but core profile still
+  // needs a vertex array bound to draw
+  glGenVertexArrays(1, &screenVao);
+
+  glstate::bindVertexArray(0);
+
+  setupLights();
+  selectShaders();
+  // Every program is linked; the stages they shared are no longer needed
+  shaderCache.releaseStages();
+}
+
+Renderer::~Renderer() {
+  const unsigned int vertexArrays[] = {objectVao, lightVao, shadowVao, lightVolumeVao, screenVao};
+  glstate::deleteVertexArrays(5, vertexArrays);
+}
+
+std::pmr::vector<Shader *> Renderer::getShaders(std::pmr::memory_resource *resource) {
+  std::pmr::vector<Shader *> shaders(
+      {&lightShader, &lightInstancedShader, &lightVolumeShader, &depthShader, &depthInstancedShader}, resource);
+  for (ShaderVariants *variants :
+       {&objectShaders, &objectInstancedShaders, &gbufferShaders, &gbufferInstancedShaders, &deferredShaders}) {
+    std::pmr::vector<Shader *> built = variants->getShaders(resource);
+    shaders.insert(shaders.end(), built.begin(), built.end());
+  }
+  return shaders;
+}
+
+uint32_t Renderer::getLightingFeatures() const {
+  return ShaderFeature::DirLight | (shadows ? ShaderFeature::DirShadow : 0u) |
+         (pointLights.empty() ? 0u : ShaderFeature::PointLights) | (spotlight ? ShaderFeature::SpotLight : 0u);
+}
+
+// Makes the permutations for the current lights active, building any that
+// are missing
+void Renderer::selectShaders() {
+  lightingFeatures = getLightingFeatures();
+  uint32_t objectFeatures =
+      lightingFeatures | materialFeatures(RenderMaterial{diffuseMap.get(), specularMap.get(), nullptr});
+  // Started together, so with parallel compile they build side by side
+  for (ShaderVariants *variants :
+       {&objectShaders, &objectInstancedShaders, &gbufferShaders, &gbufferInstancedShaders}) {
+    variants->prepare(objectFeatures);
+  }
+  deferredShaders.prepare(lightingFeatures);
+  if (glext::maxShaderCompilerThreads) {
+    // The spotlight is toggled at run time; have its permutations ready
+    // without holding up this frame
+    objectShaders.prepare(objectFeatures ^ ShaderFeature::SpotLight);
+    objectInstancedShaders.prepare(objectFeatures ^ ShaderFeature::SpotLight);
+    deferredShaders.prepare(lightingFeatures ^ ShaderFeature::SpotLight);
+  }
+  objectShader = &objectShaders.get(objectFeatures);
+  objectInstancedShader = &objectInstancedShaders.get(objectFeatures);
+  gbufferShader = &gbufferShaders.get(objectFeatures);
+  gbufferInstancedShader = &gbufferInstancedShaders.get(objectFeatures);
+  deferredShader = &deferredShaders.get(lightingFeatures);
+  setupShaders();
+  setupRenderQueue();
+}
+
+// Program state: sampler units, block bindings and constant uniforms.
+// Variants still linking have no program yet and are set up once they do.
+void Renderer::setupShaders() {
+  for (const Shader *shader : getShaders()) {
+    if (shader->getID() == 0) {
+      continue;
+    }
+    shader->bindUniformBlock("Camera", CAMERA_BINDING);
+    shader->bindUniformBlock("Lights", LIGHTS_BINDING);
+    shader->bindUniformBlock("Shadows", SHADOWS_BINDING);
+  }
+  for (ShaderVariants *variants :
+       {&objectShaders, &objectInstancedShaders, &gbufferShaders, &gbufferInstancedShaders}) {
+    for (const Shader *shader : variants->getShaders()) {
+      if (shader->getID() != 0) {
+        setupMaterial(*shader);
+      }
+    }
+  }
+  std::pmr::vector<Shader *> lightingShaders = deferredShaders.getShaders();
+  lightingShaders.push_back(&lightVolumeShader);
+  for (const Shader *shader : lightingShaders) {
+    if (shader->getID() == 0) {
+      continue;
+    }
+    shader->use();
+    shader->setInt("pointLightData", 2);
+    shader->setInt("gPosition", GBuffer::POSITION_SLOT);
+    shader->setInt("gNormal", GBuffer::NORMAL_SLOT);
+    shader->setInt("gAlbedoSpec", GBuffer::ALBEDO_SPEC_SLOT);
+    shader->setInt("gDepth", GBuffer::DEPTH_SLOT);
+    shader->setInt("shadowMap", CascadedShadowMaps::TEXTURE_SLOT);
+    shader->setFloat("shininess", 64.0f);
+  }
+}
+
+void Renderer::reloadShaders() {
+  // Programs started last frame have had a frame to link in; with parallel
+  // compile, ones still linking are left for a later frame
+  bool replaced = false;
+  for (Shader *shader : getShaders(&frameArena.get())) {
+    if (shader->isLinkComplete()) {
+      replaced |= shader->finishReload();
+    }
+  }
+  // A light switched on or off since the last frame selects other
+  // permutations
+  if (getLightingFeatures() != lightingFeatures) {
+    selectShaders();
+    shaderCache.releaseStages();
+  } else if (replaced) {
+    setupShaders();
+    setupRenderQueue();
+  }
+
+  std::vector<std::string> changed = shaderCache.takeChangedFiles();
+  if (changed.empty()) {
+    return;
+  }
+  for (Shader *shader : getShaders()) {
+    if (std::any_of(changed.begin(), changed.end(), [&](const std::string &path) { return shader->usesFile(path); })) {
+      shader->reload();
+    }
+  }
+  shaderCache.releaseStages();
+}
+
+void Renderer::buildLights(unsigned int lightCount) {
+  pointLights.clear();
+  pointLights.reserve(lightCount);
+
+  // Same spread as the procedural cubes, seeded separately so the cube
+  // layout does not depend on the light count
+  std::mt19937 rng(7331);
+  std::uniform_real_distribution<float> spreadX(-40.0f, 40.0f);
+  std::uniform_real_distribution<float> spreadY(-25.0f, 25.0f);
+  std::uniform_real_distribution<float> spreadZ(-90.0f, 5.0f);
+  std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+
+  for (unsigned int i = 0; i < lightCount; i++) {
+    PointLight light{};
+    light.constant = 1.0f;
+    if (i < 4) {
+      light.position = pointLightPositions[i];
+      light.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+      light.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+      light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+      light.linear = 0.09f;
+      light.quadratic = 0.032f;
+    } else {
+      // Short range (~5 units) coloured fill lights
+      glm::vec3 color(channel(rng), channel(rng), channel(rng));
+      light.position = glm::vec3(spreadX(rng), spreadY(rng), spreadZ(rng));
+      light.ambient = color * 0.02f;
+      light.diffuse = color;
+      light.specular = color;
+      light.linear = 0.7f;
+      light.quadratic = 1.8f;
+    }
+    float maxIntensity = std::max({light.diffuse.x, light.diffuse.y, light.diffuse.z,
+                                   light.specular.x, light.specular.y, light.specular.z});
+    light.radius = pointLightRadius(light.constant, light.linear, light.quadratic, maxIntensity);
+    pointLights.push_back(light);
+  }
+}
+
+void Renderer::buildInstances(unsigned int cubeCount) {
+  scene.clear();
+  scene.reserve(cubeCount + pointLights.size());
+
+  // Fixed seed so every run (and every submission mode) sees the same scene
+  std::mt19937 rng(1337);
+  std::uniform_real_distribution<float> spreadX(-40.0f, 40.0f);
+  std::uniform_real_distribution<float> spreadY(-25.0f, 25.0f);
+  std::uniform_real_distribution<float> spreadZ(-90.0f, 5.0f);
+
+  const glm::vec3 cubeAxis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+  for (unsigned int i = 0; i < cubeCount; i++) {
+    glm::vec3 position = i < 10 ? cubePositions[i] : glm::vec3(spreadX(rng), spreadY(rng), spreadZ(rng));
+    float angle = 20.0f * i;
+    scene.addNode(SceneGraph::NO_PARENT, position, glm::angleAxis(glm::radians(angle), cubeAxis));
+  }
+  for (const PointLight &light : pointLights) {
+    // Make it smaller
+    scene.addNode(SceneGraph::NO_PARENT, light.position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f));
+  }
+  scene.update();
+
+  std::vector<glm::mat4> cubeModels(cubeCount);
+  std::vector<glm::mat4> lightModels(pointLights.size());
+  for (unsigned int i = 0; i < cubeCount; i++) {
+    cubeModels[i] = scene.getWorldMatrix(i);
+  }
+  for (size_t i = 0; i < lightModels.size(); i++) {
+    lightModels[i] = scene.getWorldMatrix(cubeCount + (uint32_t)i);
+  }
+
+  // Normal matrices are computed once here, batched, instead of per vertex
+  auto toInstances = [](const std::vector<glm::mat4> &models, std::vector<InstanceData> &instances) {
+    std::vector<glm::mat3> normals(models.size());
+    computeNormalMatrices(models.data(), normals.data(), models.size());
+    instances.resize(models.size());
+    for (size_t i = 0; i < models.size(); i++) {
+      instances[i] = InstanceData{models[i], normals[i]};
+    }
+  };
+  toInstances(cubeModels, cubeInstances);
+  toInstances(lightModels, lightInstances);
+
+  // Both object types are the unit cube
+  const Aabb unitCube = {glm::vec3(-0.5f), glm::vec3(0.5f)};
+  auto buildBvh = [&](const std::vector<glm::mat4> &models, std::vector<Aabb> &bounds, Bvh &bvh) {
+    bounds.resize(models.size());
+    for (size_t i = 0; i < models.size(); i++) {
+      bounds[i] = transformAabb(unitCube, models[i]);
+    }
+    bvh.build(bounds.data(), bounds.size());
+  };
+  buildBvh(cubeModels, cubeBounds, cubeBvh);
+  buildBvh(lightModels, lightBounds, lightBvh);
+}
+
+void Renderer::setupMaterial(const Shader &shader) const {
+  shader.use();
+
+  // Set texture uniform and material properties
+  shader.setInt("material.diffuse", 0);
+  shader.setInt("material.specular", 1);
+  shader.setFloat("material.shininess", 64.0f); // Higher shininess for more visible specular
+  // Only read by permutations without the maps
+  shader.setInt("material.normal", 5);
+  shader.setVec3("material.diffuseColor", 1.0f, 1.0f, 1.0f);
+  shader.setVec3("material.specularColor", 0.0f, 0.0f, 0.0f);
+
+  // Clustered point light buffers
+  shader.setInt("pointLightData", 2);
+  shader.setInt("lightClusters", 3);
+  shader.setInt("lightIndices", 4);
+
+  shader.setInt("shadowMap", CascadedShadowMaps::TEXTURE_SLOT);
+}
+
+void Renderer::setupLights() {
+  // Set up dir lights
+  lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+  lights.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+  lights.dirLight.diffuse = glm::vec3(0.075f, 0.075f, 0.075f);
+  lights.dirLight.specular = glm::vec3(0.1f, 0.1f, 0.1f);
+
+  // Setup spot light; direction and toggle are refreshed every frame
+  lights.spotLight.spotDir = glm::vec3(0.0f, 0.0f, -1.0f);
+  lights.spotLight.phi = glm::cos(glm::radians(12.5f));
+  lights.spotLight.phiOuter = glm::cos(glm::radians(25.0f));
+  lights.spotLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+  lights.spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+  lights.spotLight.specular = glm::vec3(0.1f, 0.1f, 0.1f);
+  lights.spotLight.enabled = spotlight;
+
+  lights.clusterDims = glm::uvec4(LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES_Z,
+                                  (unsigned int)pointLights.size());
+}
+
+void Renderer::uploadFrameUniforms(const Camera &camera, int width, int height) {
+  profiler::CpuScope scope("Uniform upload");
+  CameraBlock cameraBlock{};
+  cameraBlock.view = camera.GetViewMatrix();
+  cameraBlock.projection = camera.GetProjectionMatrix((float)width / (float)height);
+  cameraBlock.viewPos = camera.Position;
+
+  // Update spotlight
+  lights.spotLight.spotDir = camera.Front;
+  lights.spotLight.enabled = spotlight;
+
+  lights.clusterParams = glm::vec4(lightClusters.getZScale(), lightClusters.getZBias(),
+                                   (float)LightClusters::TILES_X / width, (float)LightClusters::TILES_Y / height);
+
+  ShadowsBlock shadowsBlock{};
+  if (shadows) {
+    for (unsigned int c = 0; c < CascadedShadowMaps::CASCADE_COUNT; c++) {
+      shadowsBlock.cascadeMatrices[c] = shadowMaps->getViewProjectionMatrix(c);
+      shadowsBlock.cascadeSplits[c] = shadowMaps->getSplitDepth(c);
+      shadowsBlock.cascadeTexelSizes[c] = shadowMaps->getTexelSize(c);
+    }
+  }
+
+  StreamAllocation allocation = frameData->allocate(frameUniformSize, uniformAlignment);
+  if (!allocation.data) {
+    return;
+  }
+  std::memcpy(allocation.data, &cameraBlock, sizeof(CameraBlock));
+  std::memcpy((unsigned char *)allocation.data + lightsOffset, &lights, sizeof(LightsBlock));
+  std::memcpy((unsigned char *)allocation.data + shadowsOffset, &shadowsBlock, sizeof(ShadowsBlock));
+  frameData->flush();
+  glstate::bindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BINDING, frameData->getID(), allocation.offset,
+                           sizeof(CameraBlock));
+  glstate::bindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BINDING, frameData->getID(), allocation.offset + lightsOffset,
+                           sizeof(LightsBlock));
+  glstate::bindBufferRange(GL_UNIFORM_BUFFER, SHADOWS_BINDING, frameData->getID(), allocation.offset + shadowsOffset,
+                           sizeof(ShadowsBlock));
+  stats.streamedBytes += frameUniformSize;
+}
+
+void Renderer::binLights(const Camera &camera, int width, int height) {
+  profiler::CpuScope scope("Light clusters");
+  lightClusters.build(pointLights, camera, (float)width / (float)height);
+}
+
+void Renderer::uploadLightClusters() {
+  threadPool.wait(lightBinning);
+
+  // Orphan and refill; the index list changes size every frame
+  const std::vector<LightCluster> &clusters = lightClusters.getClusters();
+  const std::vector<uint32_t> &indices = lightClusters.getLightIndices();
+  clusterBuffer.setData(clusters.data(), clusters.size() * sizeof(LightCluster));
+  lightIndexBuffer.setData(indices.data(), indices.size() * sizeof(uint32_t));
+}
+
+void Renderer::setupRenderQueue() {
+  renderQueue.clearStates();
+  auto addProgram = [&](const Shader &shader) {
+    return renderQueue.addProgram(RenderProgram{&shader, shader.getUniform("model"), shader.getUniform("normalMatrix"),
+                                                shader.getUniform("octahedralNormals")});
+  };
+  objectProgram = addProgram(*objectShader);
+  objectInstancedProgram = addProgram(*objectInstancedShader);
+  gbufferProgram = addProgram(*gbufferShader);
+  gbufferInstancedProgram = addProgram(*gbufferInstancedShader);
+  lightProgram = addProgram(lightShader);
+  lightInstancedProgram = addProgram(lightInstancedShader);
+  depthProgram = addProgram(depthShader);
+  depthInstancedProgram = addProgram(depthInstancedShader);
+
+  cubeMaterial = renderQueue.addMaterial(RenderMaterial{diffuseMap.get(), specularMap.get(), nullptr});
+  noMaterial = renderQueue.addMaterial(RenderMaterial{nullptr, nullptr, nullptr});
+
+  bool octahedral = CUBE_VERTEX_FORMAT.normal == NormalEncoding::Octahedral;
+  cubeGeometry = renderQueue.addGeometry(RenderGeometry{objectVao, (GLsizei)cubeEbo.getCount(), octahedral});
+  lightGeometry = renderQueue.addGeometry(RenderGeometry{lightVao, (GLsizei)cubeEbo.getCount(), octahedral});
+  shadowCubeGeometry = renderQueue.addGeometry(RenderGeometry{shadowVao, (GLsizei)cubeEbo.getCount(), octahedral});
+
+  sceneModelGeometries.clear();
+  sceneModelInstances.clear();
+  sceneModelLods.clear();
+  visibleModelMeshes.clear();
+  if (sceneModel) {
+    const glm::mat4 &transform = sceneModelTransform.model;
+    float errorScale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                 glm::length(glm::vec3(transform[2]))});
+    for (size_t m = 0; m < sceneModel->getMeshes().size(); m++) {
+      Aabb bounds = transformAabb(sceneModel->getBounds(m), transform);
+      sceneModelLods.push_back(ModelLod{(uint32_t)sceneModelInstances.size(), sceneModel->getLodCount(m), 0,
+                                        (bounds.min + bounds.max) * 0.5f,
+                                        glm::length(bounds.max - bounds.min) * 0.5f, errorScale, bounds});
+      for (unsigned int level = 0; level < sceneModel->getLodCount(m); level++) {
+        const Mesh &mesh = sceneModel->getLod(m, level);
+        const VertexEncoding &encoding = mesh.getEncoding();
+        sceneModelGeometries.push_back(renderQueue.addGeometry(RenderGeometry{
+            mesh.getVao(), (GLsizei)mesh.getIndexCount(), encoding.format.normal == NormalEncoding::Octahedral}));
+        sceneModelInstances.push_back(InstanceData{transform * encoding.getPositionTransform(),
+                                                   sceneModelTransform.normalMatrix});
+      }
+    }
+  }
+}
+
+void Renderer::selectModelLods(const Camera &camera, int height) {
+  // World units to pixels at unit distance along the view direction
+  float pixelsPerUnit = (float)height / (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f));
+  for (uint32_t m : visibleModelMeshes) {
+    ModelLod &lod = sceneModelLods[m];
+    if (lodEnabled) {
+      float distance = std::max(glm::length(lod.center - camera.Position) - lod.radius, MIN_LOD_DISTANCE);
+      lod.level = selectLod(sceneModel->getLodErrors(m).data(), lod.levelCount, distance,
+                            pixelsPerUnit * lod.errorScale, lodThreshold, lodHysteresis, lod.level);
+    } else {
+      lod.level = 0;
+    }
+    stats.triangles += sceneModel->getLod(m, lod.level).getIndexCount() / 3;
+    stats.fullDetailTriangles += sceneModel->getLod(m, 0).getIndexCount() / 3;
+  }
+}
+
+void Renderer::recordDraws(const Camera &camera) {
+  profiler::CpuScope scope("Record draws");
+  bool deferred = renderPath == RenderPath::Deferred;
+  renderQueue.clear();
+
+  bool instanced = submissionMode == SubmissionMode::Instanced;
+  auto recordInstanced = [&](uint32_t layer, uint32_t program, uint32_t material, uint32_t geometry, size_t count) {
+    if (count > 0) {
+      *renderQueue.allocate(1) =
+          DrawPacket{RenderQueue::makeKey(layer, program, material, geometry, 0.0f), nullptr, (uint32_t)count};
+    }
+  };
+  // One packet per object, recorded on the thread pool a chunk of the
+  // scene at a time and keyed by squared distance to the camera
+  auto recordObjects = [&](uint32_t layer, uint32_t program, uint32_t material, uint32_t geometry,
+                           const std::vector<InstanceData> &instances, const std::vector<uint32_t> &visible) {
+    DrawPacket *packets = renderQueue.allocate(visible.size());
+    threadPool.parallelFor(visible.size(), PACKET_GRAIN, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const InstanceData &instance = instances[visible[i]];
+        glm::vec3 offset = glm::vec3(instance.model[3]) - camera.Position;
+        packets[i] = DrawPacket{RenderQueue::makeKey(layer, program, material, geometry, glm::dot(offset, offset)),
+                                &instance, 0};
+      }
+    });
+  };
+
+  if (instanced) {
+    recordInstanced(LIT_LAYER, deferred ? gbufferInstancedProgram : objectInstancedProgram, cubeMaterial,
+                    cubeGeometry, visibleCubes.size());
+    recordInstanced(UNLIT_LAYER, lightInstancedProgram, noMaterial, lightGeometry, visibleLights.size());
+  } else {
+    recordObjects(LIT_LAYER, deferred ? gbufferProgram : objectProgram, cubeMaterial, cubeGeometry, cubeInstances,
+                  visibleCubes);
+    recordObjects(UNLIT_LAYER, lightProgram, noMaterial, lightGeometry, lightInstances, visibleLights);
+  }
+
+  // The model's visible meshes are drawn one at a time, at the levels
+  // picked for this frame
+  for (uint32_t m : visibleModelMeshes) {
+    const ModelLod &lod = sceneModelLods[m];
+    size_t i = lod.first + lod.level;
+    glm::vec3 offset = lod.center - camera.Position;
+    *renderQueue.allocate(1) =
+        DrawPacket{RenderQueue::makeKey(LIT_LAYER, deferred ? gbufferProgram : objectProgram, cubeMaterial,
+                                        sceneModelGeometries[i], glm::dot(offset, offset)),
+                   &sceneModelInstances[i], 0};
+  }
+
+  // Casters of the cascades drawn this frame, with no material at all
+  for (unsigned int c = 0; shadows && c < CascadedShadowMaps::CASCADE_COUNT; c++) {
+    if (!shadowPending[c]) {
+      continue;
+    }
+    uint32_t layer = SHADOW_LAYER + c;
+    if (instanced) {
+      recordInstanced(layer, depthInstancedProgram, noMaterial, shadowCubeGeometry, shadowCubes[c].size());
+    } else {
+      recordObjects(layer, depthProgram, noMaterial, cubeGeometry, cubeInstances, shadowCubes[c]);
+    }
+    // Casters are drawn at full detail: a cached cascade outlives the
+    // levels picked for the camera, and off-screen meshes have none
+    for (uint32_t m : shadowModelMeshes[c]) {
+      size_t i = sceneModelLods[m].first;
+      *renderQueue.allocate(1) = DrawPacket{
+          RenderQueue::makeKey(layer, depthProgram, noMaterial, sceneModelGeometries[i], 0.0f), &sceneModelInstances[i],
+          0};
+    }
+  }
+
+  renderQueue.sort();
+}
+
+void Renderer::cullInstances(const Camera &camera, int width, int height) {
+  profiler::CpuScope scope("Culling");
+  glm::mat4 viewProjection = camera.GetViewProjectionMatrix((float)width / (float)height);
+  Frustum frustum = extractFrustum(viewProjection);
+
+  // The cubes in view are the occluders as well as most of what they hide
+  cubeBvh.cull(frustum, visibleCubes);
+  stats.frustumCulledObjects += (unsigned int)(cubeInstances.size() - visibleCubes.size());
+  if (occlusionCulling) {
+    rasterizeOccluders(camera, viewProjection);
+    removeOccluded(cubeBounds, visibleCubes);
+  }
+
+  lightBvh.cull(frustum, visibleLights);
+  stats.frustumCulledObjects += (unsigned int)(lightInstances.size() - visibleLights.size());
+  if (occlusionCulling) {
+    removeOccluded(lightBounds, visibleLights);
+  }
+
+  // A model has a handful of meshes, tested one by one
+  visibleModelMeshes.clear();
+  for (uint32_t m = 0; m < (uint32_t)sceneModelLods.size(); m++) {
+    const Aabb &bounds = sceneModelLods[m].bounds;
+    if (!frustum.intersects(bounds)) {
+      stats.frustumCulledObjects++;
+    } else if (occlusionCulling && !occlusionBuffer.isVisible(bounds)) {
+      stats.occludedObjects++;
+    } else {
+      visibleModelMeshes.push_back(m);
+    }
+  }
+
+  // Per-object draws read their transforms from the instance arrays as they
+  // are; only instanced ones need the visible subset in a buffer
+  if (submissionMode == SubmissionMode::Instanced) {
+    streamInstances(cubeInstances, visibleCubes, objectVao);
+    streamInstances(lightInstances, visibleLights, lightVao);
+  }
+}
+
+bool Renderer::gatherInstances(const std::vector<InstanceData> &instances, const std::vector<uint32_t> &visible,
+                               size_t &offset) {
+  // Gathered straight into the stream buffer, on the pool for large scenes
+  size_t size = visible.size() * sizeof(InstanceData);
+  StreamAllocation allocation = frameData->allocate(size);
+  offset = allocation.offset;
+  if (allocation.data) {
+    InstanceData *out = (InstanceData *)allocation.data;
+    threadPool.parallelFor(visible.size(), PACKET_GRAIN, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        out[i] = instances[visible[i]];
+      }
+    });
+  }
+  frameData->flush();
+  stats.streamedBytes += size;
+  return allocation.data != nullptr;
+}
+
+void Renderer::streamInstances(const std::vector<InstanceData> &instances, const std::vector<uint32_t> &visible,
+                               unsigned int vao) {
+  size_t offset;
+  gatherInstances(instances, visible, offset);
+
+  // The region moves every frame, and GL 3.3 has no base instance to offset
+  // into it, so the attributes are pointed at it instead
+  glstate::bindVertexArray(vao);
+  frameData->bind();
+  setInstanceAttributes(offset);
+}
+
+void Renderer::cullShadowCasters(const Camera &camera, int width, int height) {
+  profiler::CpuScope scope("Shadow culling");
+  if (!shadowMaps) {
+    shadowMaps = std::make_unique<CascadedShadowMaps>(DEFAULT_SHADOW_MAP_SIZE);
+  }
+  shadowMaps->setCaching(shadowCaching);
+  shadowMaps->update(camera, (float)width / (float)height, lights.dirLight.direction);
+
+  for (unsigned int c = 0; c < CascadedShadowMaps::CASCADE_COUNT; c++) {
+    shadowCubes[c].clear();
+    shadowModelMeshes[c].clear();
+    shadowPending[c] = shadowMaps->needsRender(c);
+    if (!shadowPending[c]) {
+      continue;
+    }
+    // Neither view frustum nor occlusion culling apply: a caster off screen
+    // or hidden from the camera can still shadow what is visible
+    Frustum frustum = shadowMaps->getCasterFrustum(c);
+    cubeBvh.cull(frustum, shadowCubes[c]);
+    for (uint32_t m = 0; m < (uint32_t)sceneModelLods.size(); m++) {
+      if (frustum.intersects(sceneModelLods[m].bounds)) {
+        shadowModelMeshes[c].push_back(m);
+      }
+    }
+    // Out of stream space, the cascade is left for a later frame
+    if (submissionMode == SubmissionMode::Instanced &&
+        !gatherInstances(cubeInstances, shadowCubes[c], shadowInstanceOffsets[c])) {
+      shadowPending[c] = false;
+    }
+  }
+}
+
+void Renderer::rasterizeOccluders(const Camera &camera, const glm::mat4 &viewProjection) {
+  // All cubes are the same size, so the nearest ones cover the most screen
+  occluderCandidates.resize(visibleCubes.size());
+  for (size_t i = 0; i < visibleCubes.size(); i++) {
+    const Aabb &box = cubeBounds[visibleCubes[i]];
+    glm::vec3 offset = (box.min + box.max) * 0.5f - camera.Position;
+    occluderCandidates[i] = {glm::dot(offset, offset), visibleCubes[i]};
+  }
+  size_t occluderCount = std::min(MAX_OCCLUDERS, occluderCandidates.size());
+  std::nth_element(occluderCandidates.begin(), occluderCandidates.begin() + occluderCount,
+                   occluderCandidates.end());
+
+  // The light volume cube is the textured cube's shape, with outward winding
+  occlusionBuffer.clear(viewProjection);
+  for (size_t i = 0; i < occluderCount; i++) {
+    occlusionBuffer.rasterize(cubeInstances[occluderCandidates[i].second].model, (const glm::vec3 *)volumeVertices, 8,
+                              volumeIndices, sizeof(volumeIndices) / sizeof(unsigned int));
+  }
+  occlusionBuffer.buildHierarchy();
+}
+
+void Renderer::removeOccluded(const std::vector<Aabb> &bounds, std::vector<uint32_t> &visible) {
+  occlusionResults.resize(visible.size());
+  threadPool.parallelFor(visible.size(), 1024, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      occlusionResults[i] = occlusionBuffer.isVisible(bounds[visible[i]]);
+    }
+  });
+
+  size_t kept = 0;
+  for (size_t i = 0; i < visible.size(); i++) {
+    if (occlusionResults[i]) {
+      visible[kept++] = visible[i];
+    }
+  }
+  stats.occludedObjects += (unsigned int)(visible.size() - kept);
+  visible.resize(kept);
+}
+
+void Renderer::renderShadows(int width, int height) {
+  profiler::CpuScope cpuScope("Shadow maps");
+  profiler::GpuScope gpuScope("Shadow maps");
+  GLuint target = glstate::getFramebuffer();
+  // Casters between the light and a cascade are clamped onto its near plane
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
+
+  for (unsigned int c = 0; c < CascadedShadowMaps::CASCADE_COUNT; c++) {
+    if (!shadowPending[c]) {
+      continue;
+    }
+    // The depth shaders read the light's view through the Camera block
+    StreamAllocation allocation = frameData->allocate(sizeof(CameraBlock), uniformAlignment);
+    if (!allocation.data) {
+      continue;
+    }
+    CameraBlock cameraBlock{};
+    cameraBlock.view = shadowMaps->getViewMatrix();
+    cameraBlock.projection = shadowMaps->getProjectionMatrix(c);
+    std::memcpy(allocation.data, &cameraBlock, sizeof(CameraBlock));
+    frameData->flush();
+    glstate::bindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BINDING, frameData->getID(), allocation.offset,
+                             sizeof(CameraBlock));
+    stats.streamedBytes += sizeof(CameraBlock);
+
+    if (submissionMode == SubmissionMode::Instanced) {
+      glstate::bindVertexArray(shadowVao);
+      frameData->bind();
+      setInstanceAttributes(shadowInstanceOffsets[c]);
+    }
+    shadowMaps->beginCascade(c);
+    unsigned int drawCalls = renderQueue.execute(SHADOW_LAYER + c);
+    shadowMaps->endCascade(c, (unsigned int)(shadowCubes[c].size() + shadowModelMeshes[c].size()), drawCalls);
+    stats.drawCalls += drawCalls;
+  }
+
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glDisable(GL_DEPTH_CLAMP);
+  glstate::bindFramebuffer(target);
+  glViewport(0, 0, width, height);
+}
+
+void Renderer::renderForward(const Camera &camera, int width, int height) {
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  uploadLightClusters();
+  uploadFrameUniforms(camera, width, height);
+
+  pointLightBuffer.bind(2);
+  clusterBuffer.bind(3);
+  lightIndexBuffer.bind(4);
+  if (shadows) {
+    shadowMaps->bindTexture();
+  }
+  profiler::CpuScope cpuScope("Forward pass");
+  profiler::GpuScope gpuScope("Forward pass");
+  stats.drawCalls += renderQueue.execute(LIT_LAYER);
+}
+
+void Renderer::renderDeferred(int width, int height) {
+  // Lighting is resolved into whatever framebuffer the caller had bound
+  GLuint target = glstate::getFramebuffer();
+  if (!gbuffer || gbuffer->getWidth() != width || gbuffer->getHeight() != height) {
+    gbuffer = std::make_unique<GBuffer>(width, height);
+  }
+
+  // 1. Geometry pass
+  {
+    profiler::CpuScope cpuScope("Geometry pass");
+    profiler::GpuScope gpuScope("Geometry pass");
+    gbuffer->bind();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    stats.drawCalls += renderQueue.execute(LIT_LAYER);
+  }
+
+  // 2. Directional light and spotlight over the whole screen; this pass
+  // also copies the G-buffer depth into the target
+  {
+    profiler::CpuScope cpuScope("Lighting pass");
+    profiler::GpuScope gpuScope("Lighting pass");
+    glstate::bindFramebuffer(target);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gbuffer->bindTextures();
+    pointLightBuffer.bind(2);
+    if (shadows) {
+      shadowMaps->bindTexture();
+    }
+
+    glDepthFunc(GL_ALWAYS);
+    deferredShader->use();
+    glstate::bindVertexArray(screenVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    stats.drawCalls++;
+  }
+
+  // 3. Point lights, one volume per light. Only back faces are drawn, and
+  // only where they lie behind the scene surface, so a pixel is shaded by
+  // the lights whose volume contains it. Depth clamping keeps volumes that
+  // cross the far plane from losing their back faces.
+  glDepthFunc(GL_GEQUAL);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_CULL_FACE);
+  glCullFace(GL_FRONT);
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  {
+    profiler::CpuScope cpuScope("Light volumes");
+    profiler::GpuScope gpuScope("Light volumes");
+    lightVolumeShader.use();
+    glstate::bindVertexArray(lightVolumeVao);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)lightVolumeEbo.getCount(), GL_UNSIGNED_INT, 0,
+                            (GLsizei)pointLights.size());
+    stats.drawCalls++;
+  }
+
+  glDisable(GL_BLEND);
+  glDisable(GL_DEPTH_CLAMP);
+  glDisable(GL_CULL_FACE);
+  glCullFace(GL_BACK);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+}
+
+void Renderer::render(const Camera &camera, int width, int height) {
+  profiler::CpuScope scope("Render");
+  stats = RenderStats{};
+  glstate::resetCounters();
+  frameArena.beginFrame();
+  unsigned int streamWaits = frameData->getWaitCount();
+  reloadShaders();
+  {
+    profiler::CpuScope uploadScope("Texture uploads");
+    textureLoader.update();
+  }
+  // Binning only needs the camera, so a worker takes it while this thread
+  // culls and records the draws
+  if (renderPath == RenderPath::Forward) {
+    threadPool.submit([this, &camera, width, height] { binLights(camera, width, height); }, &lightBinning);
+  }
+  cullInstances(camera, width, height);
+  selectModelLods(camera, height);
+  if (shadows) {
+    cullShadowCasters(camera, width, height);
+  }
+  recordDraws(camera);
+  if (shadows) {
+    renderShadows(width, height);
+  }
+
+  if (renderPath == RenderPath::Deferred) {
+    // Light volumes replace the clusters, so there is nothing to bin
+    uploadFrameUniforms(camera, width, height);
+    renderDeferred(width, height);
+  } else {
+    renderForward(camera, width, height);
+  }
+
+  // Light sources are unlit, so both paths draw them forward on top
+  {
+    profiler::CpuScope cpuScope("Unlit pass");
+    profiler::GpuScope gpuScope("Unlit pass");
+    stats.drawCalls += renderQueue.execute(UNLIT_LAYER);
+  }
+  frameData->endFrame();
+
+  stats.objects = (unsigned int)(cubeInstances.size() + lightInstances.size() + sceneModelLods.size());
+  stats.visibleObjects = (unsigned int)(visibleCubes.size() + visibleLights.size() + visibleModelMeshes.size());
+  size_t sceneTriangles = (visibleCubes.size() + visibleLights.size()) * (cubeEbo.getCount() / 3);
+  stats.triangles += sceneTriangles;
+  stats.fullDetailTriangles += sceneTriangles;
+  stats.queue = renderQueue.getStats();
+  stats.glState = glstate::getCounters();
+  stats.streamWaits = frameData->getWaitCount() - streamWaits;
+  if (shadows) {
+    std::copy(shadowMaps->getStats(), shadowMaps->getStats() + CascadedShadowMaps::CASCADE_COUNT,
+              stats.shadowCascades);
+  }
+}
+
+void Renderer::setPersistentStreaming(bool enabled) {
+  // Room for every instance, every cube once more per shadow cascade, and
+  // the uniforms, each padded to its alignment
+  const size_t cascades = CascadedShadowMaps::CASCADE_COUNT;
+  size_t instanceBytes = (cubeInstances.size() * (1 + cascades) + lightInstances.size()) * sizeof(InstanceData);
+  size_t frameSize = instanceBytes + (2 + cascades) * 16 + uniformAlignment + frameUniformSize +
+                     cascades * (uniformAlignment + sizeof(CameraBlock));
+  frameData = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, frameSize, enabled);
+
+  // Still pointing into the old buffer otherwise, until the next instanced
+  // frame; the constructor sets the vertex arrays up afterwards
+  for (unsigned int vao : {objectVao, lightVao, shadowVao}) {
+    if (vao != 0) {
+      glstate::bindVertexArray(vao);
+      frameData->bind();
+      setInstanceAttributes(0);
+    }
+  }
+}
+
+void Renderer::setModel(const Model *model, const glm::mat4 &transform) {
+  sceneModel = model;
+  sceneModelTransform = InstanceData{transform, normalMatrix(transform)};
+  setupRenderQueue();
+  // Cached cascades do not have it, or still have the old one
+  if (shadowMaps) {
+    shadowMaps->invalidate();
+  }
+}
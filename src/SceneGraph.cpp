@@ -0,0 +1,289 @@
+#include "SceneGraph.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_GRAPH_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Nodes per task; a world matrix takes a few nanoseconds, so smaller chunks
+// would cost more to hand out than to run
+const size_t UPDATE_GRAIN = 4096;
+
+// world = parent * T * R * S, or T * R * S for a root
+void composeWorld(const glm::mat4* parent, const glm::vec3& position, const glm::quat& rotation,
+                  const glm::vec3& scale, glm::mat4& world) {
+    glm::mat3 basis = glm::mat3_cast(rotation);
+    basis[0] = basis[0] * scale.x;
+    basis[1] = basis[1] * scale.y;
+    basis[2] = basis[2] * scale.z;
+
+    if (!parent) {
+        world = glm::mat4(glm::vec4(basis[0], 0.0f), glm::vec4(basis[1], 0.0f), glm::vec4(basis[2], 0.0f),
+                          glm::vec4(position, 1.0f));
+        return;
+    }
+
+#ifdef SCENE_GRAPH_SSE
+    // Every column of the result is a combination of the parent's columns
+    __m128 p0 = _mm_loadu_ps(&(*parent)[0][0]);
+    __m128 p1 = _mm_loadu_ps(&(*parent)[1][0]);
+    __m128 p2 = _mm_loadu_ps(&(*parent)[2][0]);
+    __m128 p3 = _mm_loadu_ps(&(*parent)[3][0]);
+    for (int col = 0; col < 3; col++) {
+        __m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(basis[col].x)),
+                                              _mm_mul_ps(p1, _mm_set1_ps(basis[col].y))),
+                                   _mm_mul_ps(p2, _mm_set1_ps(basis[col].z)));
+        _mm_storeu_ps(&world[col][0], column);
+    }
+    __m128 origin = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(position.x)),
+                                          _mm_mul_ps(p1, _mm_set1_ps(position.y))),
+                               _mm_add_ps(_mm_mul_ps(p2, _mm_set1_ps(position.z)), p3));
+    _mm_storeu_ps(&world[3][0], origin);
+#else
+    const glm::mat4& p = *parent;
+    for (int col = 0; col < 3; col++) {
+        world[col] = p[0] * basis[col].x + p[1] * basis[col].y + p[2] * basis[col].z;
+    }
+    world[3] = p[0] * position.x + p[1] * position.y + p[2] * position.z + p[3];
+#endif
+}
+
+} // namespace
+
+SceneGraph::SceneGraph(ThreadPool* pool) : pool(pool), layoutChanged(false), updatedCount(0) {}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::vec3& position, const glm::quat& rotation,
+                             const glm::vec3& scale) {
+    uint32_t node = (uint32_t)slots.size();
+    // Appended for now; the next update() sorts it into its level
+    uint32_t slot = (uint32_t)positions.size();
+    positions.push_back(position);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    parents.push_back(parent == NO_PARENT ? NO_PARENT : slots[parent]);
+    worldMatrices.emplace_back(1.0f);
+    dirty.push_back(1);
+    slots.push_back(slot);
+    nodes.push_back(node);
+    depths.push_back(parent == NO_PARENT ? 0 : depths[parent] + 1);
+    layoutChanged = true;
+    return node;
+}
+
+void SceneGraph::reserve(size_t count) {
+    positions.reserve(count);
+    rotations.reserve(count);
+    scales.reserve(count);
+    parents.reserve(count);
+    worldMatrices.reserve(count);
+    dirty.reserve(count);
+    slots.reserve(count);
+    nodes.reserve(count);
+    depths.reserve(count);
+}
+
+void SceneGraph::clear() {
+    positions.clear();
+    rotations.clear();
+    scales.clear();
+    parents.clear();
+    worldMatrices.clear();
+    dirty.clear();
+    levelStarts.clear();
+    levelDirty.clear();
+    slots.clear();
+    nodes.clear();
+    depths.clear();
+    layoutChanged = false;
+    updatedCount = 0;
+}
+
+void SceneGraph::rebuildLayout() {
+    size_t count = slots.size();
+
+    // Children of every node, by node index
+    std::vector<uint32_t> childStarts(count + 1, 0);
+    for (size_t node = 0; node < count; node++) {
+        uint32_t parent = parents[slots[node]];
+        if (parent != NO_PARENT) {
+            childStarts[nodes[parent] + 1]++;
+        }
+    }
+    for (size_t node = 0; node < count; node++) {
+        childStarts[node + 1] += childStarts[node];
+    }
+    std::vector<uint32_t> children(childStarts[count]);
+    std::vector<uint32_t> fill(childStarts.begin(), childStarts.end() - 1);
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    for (uint32_t node = 0; node < count; node++) {
+        uint32_t parent = parents[slots[node]];
+        if (parent == NO_PARENT) {
+            order.push_back(node);
+        } else {
+            children[fill[nodes[parent]]++] = node;
+        }
+    }
+
+    // Breadth first from the roots: levels come out contiguous, and the
+    // nodes of each ordered by parent
+    for (size_t i = 0; i < order.size(); i++) {
+        uint32_t node = order[i];
+        order.insert(order.end(), children.begin() + childStarts[node], children.begin() + childStarts[node + 1]);
+    }
+
+    std::vector<uint32_t> newSlots(count);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        newSlots[order[slot]] = slot;
+    }
+
+    std::vector<glm::vec3> newPositions(count);
+    std::vector<glm::quat> newRotations(count);
+    std::vector<glm::vec3> newScales(count);
+    std::vector<uint32_t> newParents(count);
+    std::vector<glm::mat4> newWorldMatrices(count);
+    std::vector<uint8_t> newDirty(count);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        uint32_t old = slots[order[slot]];
+        newPositions[slot] = positions[old];
+        newRotations[slot] = rotations[old];
+        newScales[slot] = scales[old];
+        newParents[slot] = parents[old] == NO_PARENT ? NO_PARENT : newSlots[nodes[parents[old]]];
+        newWorldMatrices[slot] = worldMatrices[old];
+        newDirty[slot] = dirty[old];
+    }
+    positions = std::move(newPositions);
+    rotations = std::move(newRotations);
+    scales = std::move(newScales);
+    parents = std::move(newParents);
+    worldMatrices = std::move(newWorldMatrices);
+    dirty = std::move(newDirty);
+    slots = std::move(newSlots);
+    nodes = std::move(order);
+
+    levelStarts.assign(1, 0);
+    levelDirty.clear();
+    for (uint32_t slot = 0; slot < count; slot++) {
+        uint32_t depth = depths[nodes[slot]];
+        if (depth == levelDirty.size()) {
+            levelStarts.push_back(slot);
+            levelDirty.push_back(0);
+        }
+        levelStarts.back() = slot + 1;
+        levelDirty[depth] |= dirty[slot];
+    }
+    layoutChanged = false;
+}
+
+void SceneGraph::markDirty(uint32_t slot) {
+    dirty[slot] = 1;
+    if (!layoutChanged) {
+        levelDirty[depths[nodes[slot]]] = 1;
+    }
+}
+
+void SceneGraph::setPosition(uint32_t node, const glm::vec3& position) {
+    positions[slots[node]] = position;
+    markDirty(slots[node]);
+}
+
+void SceneGraph::setRotation(uint32_t node, const glm::quat& rotation) {
+    rotations[slots[node]] = rotation;
+    markDirty(slots[node]);
+}
+
+void SceneGraph::setScale(uint32_t node, const glm::vec3& scale) {
+    scales[slots[node]] = scale;
+    markDirty(slots[node]);
+}
+
+void SceneGraph::setLocal(uint32_t node, const glm::vec3& position, const glm::quat& rotation,
+                          const glm::vec3& scale) {
+    uint32_t slot = slots[node];
+    positions[slot] = position;
+    rotations[slot] = rotation;
+    scales[slot] = scale;
+    markDirty(slot);
+}
+
+uint32_t SceneGraph::getParent(uint32_t node) const {
+    uint32_t parent = parents[slots[node]];
+    return parent == NO_PARENT ? NO_PARENT : nodes[parent];
+}
+
+size_t SceneGraph::updateRange(uint32_t begin, uint32_t end, bool parentsChanged) {
+    size_t changed = 0;
+    for (uint32_t slot = begin; slot < end; slot++) {
+        if (!parentsChanged) {
+            // Only flags set on this level count; skip clean runs 8 at a time
+            uint64_t flags;
+            if (slot + 8 <= end && (std::memcpy(&flags, &dirty[slot], sizeof(flags)), flags == 0)) {
+                slot += 7;
+                continue;
+            }
+            if (!dirty[slot]) {
+                continue;
+            }
+        } else {
+            uint32_t parent = parents[slot];
+            if (!dirty[slot] && (parent == NO_PARENT || !dirty[parent])) {
+                continue;
+            }
+        }
+        uint32_t parent = parents[slot];
+        composeWorld(parent == NO_PARENT ? nullptr : &worldMatrices[parent], positions[slot], rotations[slot],
+                     scales[slot], worldMatrices[slot]);
+        // Read by the children on the next level
+        dirty[slot] = 1;
+        changed++;
+    }
+    return changed;
+}
+
+void SceneGraph::update() {
+    if (layoutChanged) {
+        rebuildLayout();
+    }
+    updatedCount = 0;
+
+    bool parentsChanged = false;
+    // Level whose flags the next level may still read
+    size_t flaggedLevel = levelDirty.size();
+    auto clearFlags = [&](size_t level) {
+        std::memset(&dirty[levelStarts[level]], 0, levelStarts[level + 1] - levelStarts[level]);
+    };
+    for (size_t level = 0; level < getLevelCount(); level++) {
+        if (!levelDirty[level] && !parentsChanged) {
+            continue;
+        }
+        uint32_t begin = levelStarts[level];
+        uint32_t end = levelStarts[level + 1];
+        size_t changed = 0;
+        if (pool && end - begin > UPDATE_GRAIN) {
+            std::atomic<size_t> total{0};
+            pool->parallelFor(end - begin, UPDATE_GRAIN, [&](size_t first, size_t last) {
+                total.fetch_add(updateRange(begin + (uint32_t)first, begin + (uint32_t)last, parentsChanged),
+                                std::memory_order_relaxed);
+            });
+            changed = total;
+        } else {
+            changed = updateRange(begin, end, parentsChanged);
+        }
+
+        if (flaggedLevel < levelDirty.size()) {
+            clearFlags(flaggedLevel);
+        }
+        flaggedLevel = level;
+        levelDirty[level] = 0;
+        parentsChanged = changed > 0;
+        updatedCount += changed;
+    }
+    if (flaggedLevel < levelDirty.size()) {
+        clearFlags(flaggedLevel);
+    }
+}
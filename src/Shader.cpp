@@ -1,64 +1,180 @@
 #include "Shader.h"
 #include "Camera.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "ShaderCache.h"
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath) : ID(0) {
-  std::string vertexSource = readFile(vertexPath);
-  std::string fragmentSource = readFile(fragmentPath);
-
-  const char *vShaderCode = vertexSource.c_str();
-  const char *fShaderCode = fragmentSource.c_str();
-
-  // Compile vertex shader
-  unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex, 1, &vShaderCode, nullptr);
-  glCompileShader(vertex);
-  checkCompileErrors(vertex, "VERTEX");
-
-  // Compile fragment shader
-  unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fShaderCode, nullptr);
-  glCompileShader(fragment);
-  checkCompileErrors(fragment, "FRAGMENT");
-
-  // Link program
-  ID = glCreateProgram();
-  glAttachShader(ID, vertex);
-  glAttachShader(ID, fragment);
-  glLinkProgram(ID);
-  checkCompileErrors(ID, "PROGRAM");
-
-  // Clean up shaders
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+Shader::Shader(const char *vertexPath, const char *fragmentPath, ShaderCache *cache, std::string defines,
+               bool deferLink)
+    : ID(0), vertexPath(vertexPath), fragmentPath(fragmentPath), defines(std::move(defines)), cache(cache),
+      pendingID(0), pendingKey(0) {
+  if (deferLink) {
+    pendingID = startLink(pendingKey);
+    return;
+  }
+  uint64_t binaryKey = 0;
+  ID = startLink(binaryKey);
+  finishLink(ID, binaryKey);
+  reflectUniforms();
 }
 
 Shader::~Shader() {
   if (ID != 0) {
-    glDeleteProgram(ID);
+    glstate::deleteProgram(ID);
+  }
+  if (pendingID != 0) {
+    glstate::deleteProgram(pendingID);
   }
 }
 
 Shader::Shader(Shader &&other) noexcept
-    : ID(other.ID), uniformLocations(std::move(other.uniformLocations)) {
+    : ID(other.ID), uniforms(std::move(other.uniforms)), vertexPath(std::move(other.vertexPath)),
+      fragmentPath(std::move(other.fragmentPath)), defines(std::move(other.defines)), cache(other.cache),
+      pendingID(other.pendingID), pendingKey(other.pendingKey) {
   other.ID = 0;
+  other.pendingID = 0;
 }
 
 Shader &Shader::operator=(Shader &&other) noexcept {
   if (this != &other) {
     if (ID != 0) {
-      glDeleteProgram(ID);
+      glstate::deleteProgram(ID);
+    }
+    if (pendingID != 0) {
+      glstate::deleteProgram(pendingID);
     }
     ID = other.ID;
-    uniformLocations = std::move(other.uniformLocations);
+    uniforms = std::move(other.uniforms);
+    vertexPath = std::move(other.vertexPath);
+    fragmentPath = std::move(other.fragmentPath);
+    defines = std::move(other.defines);
+    cache = other.cache;
+    pendingID = other.pendingID;
+    pendingKey = other.pendingKey;
     other.ID = 0;
+    other.pendingID = 0;
   }
   return *this;
 }
 
-void Shader::use() const { glUseProgram(ID); }
+unsigned int Shader::compileStage(GLenum type, const std::string &source) const {
+  if (cache) {
+    if (unsigned int shared = cache->findStage(type, source)) {
+      return shared;
+    }
+  }
+  const char *code = source.c_str();
+  unsigned int shader = glCreateShader(type);
+  glShaderSource(shader, 1, &code, nullptr);
+  // Not checked until the program is: asking for the status here would wait
+  // on a compile the driver may be running in parallel
+  glCompileShader(shader);
+  if (cache) {
+    cache->addStage(type, source, shader);
+  }
+  return shader;
+}
+
+unsigned int Shader::startLink(uint64_t &binaryKey) const {
+  std::string vertexSource = readFile(vertexPath.c_str());
+  std::string fragmentSource = readFile(fragmentPath.c_str());
+
+  unsigned int program = glCreateProgram();
+  binaryKey = 0;
+  if (cache) {
+    uint64_t key = cache->getProgramKey(vertexSource, fragmentSource);
+    if (cache->loadBinary(program, key)) {
+      return program;
+    }
+    cache->prepareProgram(program);
+    binaryKey = key;
+  }
+
+  unsigned int vertex = compileStage(GL_VERTEX_SHADER, vertexSource);
+  unsigned int fragment = compileStage(GL_FRAGMENT_SHADER, fragmentSource);
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  glLinkProgram(program);
+
+  // Attached stages live on until finishLink() detaches them, even once
+  // deleted, so their logs are still there if linking fails
+  if (!cache) {
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+  }
+  return program;
+}
+
+bool Shader::finishLink(unsigned int program, uint64_t binaryKey) const {
+  GLuint stages[2];
+  GLsizei stageCount = 0;
+  glGetAttachedShaders(program, 2, &stageCount, stages);
+  bool linked = checkCompileErrors(program, "PROGRAM");
+  for (GLsizei i = 0; i < stageCount; i++) {
+    if (!linked) {
+      GLint type = 0;
+      glGetShaderiv(stages[i], GL_SHADER_TYPE, &type);
+      checkCompileErrors(stages[i], type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT");
+    }
+    glDetachShader(program, stages[i]);
+  }
+  if (!linked) {
+    return false;
+  }
+  if (cache && binaryKey != 0) {
+    cache->storeBinary(program, binaryKey);
+  }
+  return true;
+}
+
+void Shader::reload() {
+  if (pendingID != 0) {
+    glstate::deleteProgram(pendingID);
+  }
+  pendingID = startLink(pendingKey);
+}
+
+bool Shader::finishReload() {
+  if (pendingID == 0) {
+    return false;
+  }
+  unsigned int program = pendingID;
+  pendingID = 0;
+  if (!finishLink(program, pendingKey)) {
+    std::cerr << "ERROR::SHADER::RELOAD_FAILED: " << vertexPath << ", " << fragmentPath
+              << " (keeping the previous program)" << std::endl;
+    glstate::deleteProgram(program);
+    return false;
+  }
+  if (ID != 0) {
+    glstate::deleteProgram(ID);
+  }
+  ID = program;
+  reflectUniforms();
+  return true;
+}
+
+bool Shader::isLinkComplete() const {
+  if (pendingID == 0 || !glext::maxShaderCompilerThreads) {
+    return true;
+  }
+  GLint complete = GL_FALSE;
+  glGetProgramiv(pendingID, GL_COMPLETION_STATUS_KHR, &complete);
+  return complete != GL_FALSE;
+}
+
+bool Shader::usesFile(const std::string &path) const {
+  std::filesystem::path changed = std::filesystem::path(path).lexically_normal();
+  return changed == std::filesystem::path(vertexPath).lexically_normal() ||
+         changed == std::filesystem::path(fragmentPath).lexically_normal();
+}
+
+void Shader::use() const { glstate::useProgram(ID); }
 
 std::string Shader::readFile(const char *filePath) const {
   std::ifstream shaderFile;
@@ -68,7 +184,24 @@ std::string Shader::readFile(const char *filePath) const {
     shaderFile.open(filePath);
     std::stringstream shaderStream;
     shaderStream << shaderFile.rdbuf();
-    return shaderStream.str();
+    std::string source = shaderStream.str();
+    if (defines.empty()) {
+      return source;
+    }
+    // #version has to stay first; #line keeps error messages pointing at
+    // the lines of the file
+    size_t insertAt = 0;
+    if (source.starts_with("#version")) {
+      insertAt = source.find('\n');
+      if (insertAt == std::string::npos) {
+        source += '\n';
+        insertAt = source.size();
+      } else {
+        insertAt++;
+      }
+    }
+    source.insert(insertAt, defines + "#line " + (insertAt != 0 ? "2" : "1") + "\n");
+    return source;
   } catch (const std::ifstream::failure &e) {
     std::cerr << "ERROR::SHADER::FILE_NOT_READ: " << filePath << " - "
               << e.what() << std::endl;
@@ -76,7 +209,7 @@ std::string Shader::readFile(const char *filePath) const {
   }
 }
 
-void Shader::checkCompileErrors(unsigned int shader,
+bool Shader::checkCompileErrors(unsigned int shader,
                                 const std::string &type) const {
   int success;
   char infoLog[1024];
@@ -96,50 +229,106 @@ void Shader::checkCompileErrors(unsigned int shader,
                 << infoLog << std::endl;
     }
   }
+  return success != 0;
 }
 
-GLint Shader::getUniformLocation(const std::string &name) const {
-  auto it = uniformLocations.find(name);
-  if (it != uniformLocations.end()) {
-    return it->second;
+void Shader::addUniform(std::string_view name, GLint location) {
+  uniforms.push_back(UniformInfo{fnv1a32(name), location, std::string(name)});
+}
+
+void Shader::reflectUniforms() {
+  uniforms.clear();
+
+  GLint count = 0;
+  GLint maxLength = 0;
+  glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<char> buffer(std::max(maxLength, 1));
+
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(ID, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+
+    // Uniform block members have no location
+    GLint location = glGetUniformLocation(ID, buffer.data());
+    if (location < 0) {
+      continue;
+    }
+
+    std::string_view name(buffer.data(), length);
+    addUniform(name, location);
+
+    // Arrays are reported once as "name[0]"; register the bare name and
+    // every element so either spelling resolves
+    if (name.ends_with("[0]")) {
+      std::string_view base = name.substr(0, name.size() - 3);
+      addUniform(base, location);
+      for (GLint element = 1; element < size; element++) {
+        std::string elementName = std::string(base) + "[" + std::to_string(element) + "]";
+        addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+      }
+    }
   }
 
-  GLint location = glGetUniformLocation(ID, name.c_str());
-  uniformLocations[name] = location;
-  return location;
+  std::sort(uniforms.begin(), uniforms.end(),
+            [](const UniformInfo &a, const UniformInfo &b) { return a.hash < b.hash; });
 }
 
-void Shader::setBool(const std::string &name, bool value) const {
-  glUniform1i(getUniformLocation(name), static_cast<int>(value));
+UniformHandle Shader::findUniform(uint32_t hash, std::string_view name) const {
+  auto it = std::lower_bound(uniforms.begin(), uniforms.end(), hash,
+                             [](const UniformInfo &info, uint32_t value) { return info.hash < value; });
+  for (; it != uniforms.end() && it->hash == hash; ++it) {
+    if (it->name == name) {
+      return UniformHandle(it->location);
+    }
+  }
+  return UniformHandle();
 }
 
-void Shader::setInt(const std::string &name, int value) const {
-  glUniform1i(getUniformLocation(name), value);
+void Shader::setBool(UniformHandle uniform, bool value) const {
+  glUniform1i(uniform.getLocation(), static_cast<int>(value));
 }
 
-void Shader::setFloat(const std::string &name, float value) const {
-  glUniform1f(getUniformLocation(name), value);
+void Shader::setInt(UniformHandle uniform, int value) const {
+  glUniform1i(uniform.getLocation(), value);
 }
 
-void Shader::setVec2(const std::string &name, float x, float y) const {
-  glUniform2f(getUniformLocation(name), x, y);
+void Shader::setFloat(UniformHandle uniform, float value) const {
+  glUniform1f(uniform.getLocation(), value);
 }
 
-void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-  glUniform3f(getUniformLocation(name), x, y, z);
+void Shader::setVec2(UniformHandle uniform, float x, float y) const {
+  glUniform2f(uniform.getLocation(), x, y);
 }
 
-void Shader::setVec3(const std::string &name, const glm::vec3& value) const {
-  glUniform3fv(getUniformLocation(name), 1, &value[0]);
+void Shader::setVec3(UniformHandle uniform, float x, float y, float z) const {
+  glUniform3f(uniform.getLocation(), x, y, z);
 }
 
-void Shader::setVec4(const std::string &name, float x, float y, float z,
+void Shader::setVec3(UniformHandle uniform, const glm::vec3 &value) const {
+  glUniform3fv(uniform.getLocation(), 1, &value[0]);
+}
+
+void Shader::setVec4(UniformHandle uniform, float x, float y, float z,
                      float w) const {
-  glUniform4f(getUniformLocation(name), x, y, z, w);
+  glUniform4f(uniform.getLocation(), x, y, z, w);
+}
+
+void Shader::setMat3(UniformHandle uniform, const glm::mat3 &mat) const {
+  glUniformMatrix3fv(uniform.getLocation(), 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::setMat4(const std::string &name, const glm::mat4& mat) const {
-  glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+void Shader::setMat4(UniformHandle uniform, const glm::mat4 &mat) const {
+  glUniformMatrix4fv(uniform.getLocation(), 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::bindUniformBlock(const std::string &blockName, unsigned int binding) const {
+  GLuint index = glGetUniformBlockIndex(ID, blockName.c_str());
+  if (index != GL_INVALID_INDEX) {
+    glUniformBlockBinding(ID, index, binding);
+  }
 }
 
 void Shader::setCameraUniforms(const std::string& viewName, const std::string& projectionName, 
@@ -0,0 +1,252 @@
+#include "ShaderCache.h"
+#include "GLExtensions.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'O', 'G', 'L', 'P'};
+const uint32_t VERSION = 1;
+
+struct ProgramFileHeader {
+    char magic[4]; // "OGLP"
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binarySize; // bytes of binary following the header
+};
+static_assert(sizeof(ProgramFileHeader) == 24, "cache files are read straight from the mapping");
+
+// How long the watcher sleeps at most before checking for shutdown
+const int WATCH_POLL_MS = 100;
+
+const char* glString(GLenum name) {
+    const char* value = (const char*)glGetString(name);
+    return value ? value : "";
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(std::string directory)
+    : directory(std::move(directory)), binariesSupported(false), driverHash(0), watchDescriptor(-1),
+      stopping(false) {
+    if (glext::programBinary) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binariesSupported = formats > 0 && !this->directory.empty();
+    }
+    if (glext::maxShaderCompilerThreads) {
+        // Drivers may start out compiling on the calling thread; let them
+        // use as many threads as they see fit
+        glext::maxShaderCompilerThreads(0xFFFFFFFF);
+    }
+    driverHash = fnv1a64(glString(GL_VERSION), fnv1a64(glString(GL_RENDERER), fnv1a64(glString(GL_VENDOR))));
+    if (binariesSupported) {
+        std::error_code error;
+        std::filesystem::create_directories(this->directory, error);
+    }
+}
+
+ShaderCache::~ShaderCache() {
+    stopping = true;
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+#ifdef __linux__
+    if (watchDescriptor >= 0) {
+        close(watchDescriptor);
+    }
+#endif
+    releaseStages();
+}
+
+std::string ShaderCache::entryPath(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << key << ".prog";
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+uint64_t ShaderCache::getProgramKey(const std::string& vertexSource, const std::string& fragmentSource) const {
+    // The length keeps moving text from one source to the other from
+    // producing the same key
+    uint64_t hash = fnv1a64(vertexSource, driverHash);
+    hash = fnv1a64(std::to_string(vertexSource.size()), hash);
+    return fnv1a64(fragmentSource, hash);
+}
+
+bool ShaderCache::loadBinary(GLuint program, uint64_t key) {
+    if (!binariesSupported) {
+        return false;
+    }
+    MappedFile file(entryPath(key));
+    const auto* header = (const ProgramFileHeader*)file.getData();
+    bool valid = file.isOpen() && file.getSize() >= sizeof(ProgramFileHeader) &&
+                 std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->version == VERSION &&
+                 header->key == key && file.getSize() - sizeof(ProgramFileHeader) >= header->binarySize;
+    if (!valid) {
+        stats.binaryMisses++;
+        return false;
+    }
+
+    glext::programBinary(program, header->binaryFormat, file.getData() + sizeof(ProgramFileHeader),
+                         (GLsizei)header->binarySize);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Typically a driver update; the entry is rewritten after linking
+        stats.binaryMisses++;
+        return false;
+    }
+    stats.binaryHits++;
+    return true;
+}
+
+void ShaderCache::prepareProgram(GLuint program) const {
+    if (binariesSupported) {
+        glext::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+void ShaderCache::storeBinary(GLuint program, uint64_t key) const {
+    if (!binariesSupported) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glext::getProgramBinary(program, length, &written, &format, binary.data());
+
+    ProgramFileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binarySize = (uint32_t)written;
+
+    // Written under a temporary name and renamed into place, like the
+    // texture cache, so another process never loads a half-written entry
+    std::string cachePath = entryPath(key);
+    std::ostringstream tempPath;
+    tempPath << cachePath << '.' << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+    {
+        std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), written);
+        if (!file) {
+            std::cerr << "ERROR::SHADER_CACHE::CANNOT_WRITE: " << tempPath.str() << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath.str(), cachePath, error);
+    if (error) {
+        std::cerr << "ERROR::SHADER_CACHE::CANNOT_WRITE: " << cachePath << std::endl;
+        std::filesystem::remove(tempPath.str(), error);
+    }
+}
+
+GLuint ShaderCache::findStage(GLenum type, const std::string& source) {
+    auto it = stages.find(fnv1a64(source, type));
+    if (it == stages.end()) {
+        return 0;
+    }
+    stats.stagesShared++;
+    return it->second;
+}
+
+void ShaderCache::addStage(GLenum type, const std::string& source, GLuint shader) {
+    GLuint& stage = stages[fnv1a64(source, type)];
+    if (stage != 0) {
+        glDeleteShader(stage);
+    }
+    stage = shader;
+    stats.stagesCompiled++;
+}
+
+void ShaderCache::releaseStages() {
+    for (const auto& stage : stages) {
+        glDeleteShader(stage.second);
+    }
+    stages.clear();
+}
+
+bool ShaderCache::watch(const std::string& watchDirectory) {
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(watchMutex);
+    if (watchDescriptor < 0) {
+        watchDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watchDescriptor < 0) {
+            std::cerr << "ERROR::SHADER_CACHE::INOTIFY_UNAVAILABLE" << std::endl;
+            return false;
+        }
+    }
+    // Editors either rewrite the file or write a new one and rename it over
+    int watchId = inotify_add_watch(watchDescriptor, watchDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watchId < 0) {
+        std::cerr << "ERROR::SHADER_CACHE::CANNOT_WATCH: " << watchDirectory << std::endl;
+        return false;
+    }
+    watchedDirectories.emplace_back(watchId, watchDirectory);
+    if (!watcher.joinable()) {
+        watcher = std::thread(&ShaderCache::watchLoop, this);
+    }
+    return true;
+#else
+    std::cerr << "ERROR::SHADER_CACHE::CANNOT_WATCH: " << watchDirectory << " (needs inotify)" << std::endl;
+    return false;
+#endif
+}
+
+void ShaderCache::watchLoop() {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    pollfd descriptor = {watchDescriptor, POLLIN, 0};
+    while (!stopping) {
+        if (poll(&descriptor, 1, WATCH_POLL_MS) <= 0) {
+            continue;
+        }
+        ssize_t length;
+        while ((length = read(watchDescriptor, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(watchMutex);
+            for (char* next = buffer; next < buffer + length;) {
+                const auto* event = (const inotify_event*)next;
+                next += sizeof(inotify_event) + event->len;
+                auto watched = std::find_if(watchedDirectories.begin(), watchedDirectories.end(),
+                                            [&](const auto& entry) { return entry.first == event->wd; });
+                if (event->len == 0 || watched == watchedDirectories.end()) {
+                    continue;
+                }
+                std::string path = (std::filesystem::path(watched->second) / event->name).string();
+                if (std::find(changedFiles.begin(), changedFiles.end(), path) == changedFiles.end()) {
+                    changedFiles.push_back(std::move(path));
+                }
+            }
+        }
+    }
+#endif
+}
+
+std::vector<std::string> ShaderCache::takeChangedFiles() {
+    std::lock_guard<std::mutex> lock(watchMutex);
+    std::vector<std::string> files;
+    files.swap(changedFiles);
+    return files;
+}
@@ -0,0 +1,64 @@
+#include "ShaderVariants.h"
+#include "ShadowMaps.h"
+#include <iterator>
+
+namespace {
+
+// Indexed by bit
+const char* const FEATURE_DEFINES[] = {"DIR_LIGHT", "POINT_LIGHTS", "SPOT_LIGHT", "DIFFUSE_MAP",
+                                       "SPECULAR_MAP", "NORMAL_MAP", "DIR_SHADOW"};
+static_assert(ShaderFeature::All == (1u << std::size(FEATURE_DEFINES)) - 1, "every feature needs a define");
+
+} // namespace
+
+std::string shaderDefines(uint32_t features) {
+    std::string defines;
+    for (size_t bit = 0; bit < std::size(FEATURE_DEFINES); bit++) {
+        if (features & (1u << bit)) {
+            defines += "#define ";
+            defines += FEATURE_DEFINES[bit];
+            defines += '\n';
+        }
+    }
+    // Sizes the Shadows block, which has to match CascadedShadowMaps
+    if (features & ShaderFeature::DirShadow) {
+        defines += "#define SHADOW_CASCADES " + std::to_string(CascadedShadowMaps::CASCADE_COUNT) + "\n";
+    }
+    return defines;
+}
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath, ShaderCache* cache,
+                               uint32_t usedFeatures)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), cache(cache), usedFeatures(usedFeatures) {}
+
+void ShaderVariants::prepare(uint32_t features) {
+    features &= usedFeatures;
+    if (variants.find(features) == variants.end()) {
+        variants.emplace(features, Shader(vertexPath.c_str(), fragmentPath.c_str(), cache, shaderDefines(features),
+                                          true));
+    }
+}
+
+bool ShaderVariants::isReady(uint32_t features) const {
+    auto it = variants.find(features & usedFeatures);
+    return it != variants.end() && (it->second.getID() != 0 || it->second.isLinkComplete());
+}
+
+Shader& ShaderVariants::get(uint32_t features) {
+    prepare(features);
+    Shader& shader = variants.find(features & usedFeatures)->second;
+    if (shader.getID() == 0) {
+        // Still linking its first program
+        shader.finishReload();
+    }
+    return shader;
+}
+
+std::pmr::vector<Shader*> ShaderVariants::getShaders(std::pmr::memory_resource* resource) {
+    std::pmr::vector<Shader*> shaders(resource);
+    shaders.reserve(variants.size());
+    for (auto& variant : variants) {
+        shaders.push_back(&variant.second);
+    }
+    return shaders;
+}
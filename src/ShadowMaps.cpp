@@ -0,0 +1,184 @@
+#include "ShadowMaps.h"
+#include "Camera.h"
+#include "GLState.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Shadows end with the camera's far plane
+const float SHADOW_DISTANCE = FAR_PLANE;
+
+// Blend between logarithmic (1) and uniform (0) split distances; mostly
+// logarithmic keeps near cascades small without starving the far ones
+const float SPLIT_LAMBDA = 0.75f;
+
+// Room a cached cascade leaves around its slice, as a fraction of the
+// slice's bounding sphere radius
+const float CACHE_MARGIN = 0.15f;
+
+} // namespace
+
+CascadedShadowMaps::CascadedShadowMaps(int size)
+    : ID(0), depthTexture(0), size(size), caching(true), lightDirection(0.0f), lightView(1.0f), cascades{},
+      frame(0) {
+    glGenTextures(1, &depthTexture);
+    glstate::bindTexture(0, GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, CASCADE_COUNT, 0, GL_DEPTH_COMPONENT,
+                 GL_UNSIGNED_INT, nullptr);
+    // Compared in the sampler, and filtered: every lookup is a 2x2 PCF
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glstate::bindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+    // Created mid-frame; the caller's framebuffer stays bound
+    GLuint target = glstate::getFramebuffer();
+    glGenFramebuffers(1, &ID);
+    glstate::bindFramebuffer(ID);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::SHADOW_MAPS::INCOMPLETE: " << size << "x" << size << std::endl;
+    }
+    glstate::bindFramebuffer(target);
+
+    glGenQueries(QUERY_FRAMES * CASCADE_COUNT * 2, &queries[0][0]);
+    std::fill(&queried[0][0], &queried[0][0] + QUERY_FRAMES * CASCADE_COUNT, false);
+}
+
+CascadedShadowMaps::~CascadedShadowMaps() {
+    glDeleteQueries(QUERY_FRAMES * CASCADE_COUNT * 2, &queries[0][0]);
+    glstate::deleteFramebuffers(1, &ID);
+    glstate::deleteTextures(1, &depthTexture);
+}
+
+void CascadedShadowMaps::collectQueries() {
+    // Issued QUERY_FRAMES frames ago, so the GPU is long done with them
+    unsigned int slot = frame % QUERY_FRAMES;
+    for (unsigned int c = 0; c < CASCADE_COUNT; c++) {
+        stats[c] = ShadowCascadeStats{};
+        if (queried[slot][c]) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[slot][c * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[slot][c * 2 + 1], GL_QUERY_RESULT, &end);
+            stats[c].gpuMs = (double)(end - begin) / 1.0e6;
+            queried[slot][c] = false;
+        }
+    }
+}
+
+void CascadedShadowMaps::update(const Camera& camera, float aspectRatio, const glm::vec3& direction) {
+    frame++;
+    collectQueries();
+
+    if (direction != lightDirection) {
+        lightDirection = direction;
+        glm::vec3 forward = glm::normalize(direction);
+        glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        lightView = glm::lookAt(glm::vec3(0.0f), forward, up);
+        invalidate();
+    }
+
+    // Squared slope of the frustum's corner rays off the view axis
+    float tanHalfFov = std::tan(glm::radians(camera.Zoom) * 0.5f);
+    float cornerSlope2 = tanHalfFov * tanHalfFov * (1.0f + aspectRatio * aspectRatio);
+    float splitNear = NEAR_PLANE;
+    for (unsigned int c = 0; c < CASCADE_COUNT; c++) {
+        Cascade& cascade = cascades[c];
+        float t = (float)(c + 1) / CASCADE_COUNT;
+        float logSplit = NEAR_PLANE * std::pow(SHADOW_DISTANCE / NEAR_PLANE, t);
+        float uniformSplit = NEAR_PLANE + (SHADOW_DISTANCE - NEAR_PLANE) * t;
+        float splitFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+        cascade.splitDepth = splitFar;
+
+        // Smallest sphere through the near and far corners of the slice;
+        // it only depends on the split depths and the field of view
+        float centerDepth = 0.5f * (splitNear + splitFar) * (1.0f + cornerSlope2);
+        float sliceRadius;
+        if (centerDepth >= splitFar) {
+            centerDepth = splitFar;
+            sliceRadius = splitFar * std::sqrt(cornerSlope2);
+        } else {
+            sliceRadius = std::sqrt((splitFar - centerDepth) * (splitFar - centerDepth) +
+                                    splitFar * splitFar * cornerSlope2);
+        }
+        splitNear = splitFar;
+        glm::vec3 center = glm::vec3(lightView * glm::vec4(camera.Position + camera.Front * centerDepth, 1.0f));
+
+        // Without caching, the margin only has to absorb the snapping
+        float radius = sliceRadius * (1.0f + (caching ? CACHE_MARGIN : 2.0f / size));
+        glm::vec3 offset = glm::abs(center - cascade.center) + sliceRadius;
+        bool covered = cascade.radius == radius && offset.x <= radius && offset.y <= radius && offset.z <= radius;
+        if (caching && cascade.valid && covered) {
+            cascade.needsRender = false;
+            continue;
+        }
+
+        // Moving the map by whole texels keeps every texel sampling the same
+        // scene positions from frame to frame
+        float texelSize = 2.0f * radius / size;
+        center.x = std::floor(center.x / texelSize + 0.5f) * texelSize;
+        center.y = std::floor(center.y / texelSize + 0.5f) * texelSize;
+        cascade.center = center;
+        cascade.radius = radius;
+        // The light looks down -z
+        cascade.projection = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+                                        -center.z - radius, -center.z + radius);
+        cascade.viewProjection = cascade.projection * lightView;
+        cascade.valid = false;
+        cascade.needsRender = true;
+    }
+}
+
+void CascadedShadowMaps::invalidate() {
+    for (Cascade& cascade : cascades) {
+        cascade.valid = false;
+        cascade.radius = 0.0f;
+    }
+}
+
+Frustum CascadedShadowMaps::getCasterFrustum(unsigned int cascade) const {
+    Frustum frustum = extractFrustum(cascades[cascade].viewProjection);
+    // Casters in front of the near plane still shadow the cascade; depth
+    // clamping puts them on it
+    frustum.planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    return frustum;
+}
+
+void CascadedShadowMaps::beginCascade(unsigned int cascade) {
+    glstate::bindFramebuffer(ID);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, (GLint)cascade);
+    glViewport(0, 0, size, size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glQueryCounter(queries[frame % QUERY_FRAMES][cascade * 2], GL_TIMESTAMP);
+}
+
+void CascadedShadowMaps::endCascade(unsigned int cascade, unsigned int casters, unsigned int drawCalls) {
+    unsigned int slot = frame % QUERY_FRAMES;
+    glQueryCounter(queries[slot][cascade * 2 + 1], GL_TIMESTAMP);
+    queried[slot][cascade] = true;
+    cascades[cascade].valid = true;
+    cascades[cascade].needsRender = false;
+    stats[cascade].rendered = true;
+    stats[cascade].casters = casters;
+    stats[cascade].drawCalls = drawCalls;
+}
+
+void CascadedShadowMaps::bindTexture(unsigned int unit) const {
+    glstate::bindTexture(unit, GL_TEXTURE_2D_ARRAY, depthTexture);
+}
+
+void CascadedShadowMaps::setCaching(bool enabled) {
+    if (enabled != caching) {
+        caching = enabled;
+        // The margin changes with it
+        invalidate();
+    }
+}
@@ -0,0 +1,175 @@
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include <iostream>
+
+StreamBuffer::StreamBuffer(GLenum target, size_t frameSize, bool allowPersistent)
+    : target(target), ID(0), frameSize(frameSize), persistent(false), persistentData(nullptr), mapped(false),
+      frameStarted(false), region(FRAME_REGIONS - 1), head(0), fences{}, waits(0) {
+    size_t capacity = frameSize * FRAME_REGIONS;
+    glGenBuffers(1, &ID);
+    bind();
+    if (allowPersistent && glext::bufferStorage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glext::bufferStorage(target, capacity, nullptr, flags);
+        persistentData = (unsigned char*)glMapBufferRange(target, 0, capacity, flags);
+        if (persistentData) {
+            persistent = true;
+            return;
+        }
+        // Storage is immutable, so the fallback needs a buffer of its own
+        std::cerr << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+        glstate::deleteBuffers(1, &ID);
+        glGenBuffers(1, &ID);
+        bind();
+    }
+    glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+}
+
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+StreamBuffer::StreamBuffer(StreamBuffer&& other) noexcept
+    : target(other.target), ID(other.ID), frameSize(other.frameSize), persistent(other.persistent),
+      persistentData(other.persistentData), mapped(other.mapped), frameStarted(other.frameStarted),
+      region(other.region), head(other.head), waits(other.waits) {
+    for (unsigned int i = 0; i < FRAME_REGIONS; i++) {
+        fences[i] = other.fences[i];
+        other.fences[i] = nullptr;
+    }
+    other.ID = 0;
+    other.persistentData = nullptr;
+    other.mapped = false;
+}
+
+StreamBuffer& StreamBuffer::operator=(StreamBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        target = other.target;
+        ID = other.ID;
+        frameSize = other.frameSize;
+        persistent = other.persistent;
+        persistentData = other.persistentData;
+        mapped = other.mapped;
+        frameStarted = other.frameStarted;
+        region = other.region;
+        head = other.head;
+        waits = other.waits;
+        for (unsigned int i = 0; i < FRAME_REGIONS; i++) {
+            fences[i] = other.fences[i];
+            other.fences[i] = nullptr;
+        }
+        other.ID = 0;
+        other.persistentData = nullptr;
+        other.mapped = false;
+    }
+    return *this;
+}
+
+void StreamBuffer::release() {
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (ID != 0) {
+        // Deleting a buffer unmaps it as well
+        glstate::deleteBuffers(1, &ID);
+        ID = 0;
+    }
+}
+
+void StreamBuffer::beginFrame() {
+    region = (region + 1) % FRAME_REGIONS;
+    head = 0;
+    frameStarted = true;
+
+    if (!persistent) {
+        // Wrapped around: the earlier regions may still be read, so let the
+        // driver swap in new storage rather than synchronize
+        if (region == 0) {
+            bind();
+            glBufferData(target, frameSize * FRAME_REGIONS, nullptr, GL_STREAM_DRAW);
+        }
+        return;
+    }
+
+    GLsync& fence = fences[region];
+    if (!fence) {
+        return;
+    }
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        waits++;
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    if (result == GL_WAIT_FAILED) {
+        std::cerr << "ERROR::STREAM_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment) {
+    if (!frameStarted) {
+        beginFrame();
+    }
+    flush();
+
+    // Aligned within the buffer, not the region: regions start wherever the
+    // frame size puts them
+    size_t regionStart = (size_t)region * frameSize;
+    size_t offset = (regionStart + head + alignment - 1) / alignment * alignment;
+    if (offset + size > regionStart + frameSize) {
+        std::cerr << "ERROR::STREAM_BUFFER::FRAME_FULL: " << offset + size - regionStart << " of " << frameSize
+                  << " bytes" << std::endl;
+        return StreamAllocation{nullptr, 0};
+    }
+    head = offset + size - regionStart;
+
+    if (persistent) {
+        return StreamAllocation{persistentData + offset, offset};
+    }
+    if (size == 0) {
+        // Zero-length ranges cannot be mapped, and there is nothing to write
+        return StreamAllocation{nullptr, offset};
+    }
+    bind();
+    void* data = glMapBufferRange(target, offset, size,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    mapped = data != nullptr;
+    return StreamAllocation{data, offset};
+}
+
+void StreamBuffer::flush() {
+    if (mapped) {
+        bind();
+        glUnmapBuffer(target);
+        mapped = false;
+    }
+}
+
+void StreamBuffer::endFrame() {
+    if (!frameStarted) {
+        return;
+    }
+    flush();
+    if (persistent) {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frameStarted = false;
+}
+
+void StreamBuffer::bind() const {
+    glstate::bindBuffer(target, ID);
+}
+
+size_t StreamBuffer::getUniformOffsetAlignment() {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment > 0 ? (size_t)alignment : 256;
+}
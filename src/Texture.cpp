@@ -1,36 +1,50 @@
 #include "Texture.h"
+#include "GLState.h"
 #include <iostream>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+namespace {
+
+void setDefaultParameters(Texture& texture) {
+    texture.setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    texture.setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+    texture.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    texture.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+GLenum formatForChannels(int channels, GLenum fallback) {
+    switch (channels) {
+    case 1:
+        return GL_RED;
+    case 3:
+        return GL_RGB;
+    case 4:
+        return GL_RGBA;
+    default:
+        return fallback;
+    }
+}
+
+} // namespace
+
 Texture::Texture(const std::string& imagePath, GLenum format) 
     : ID(0), width(0), height(0), channels(0) {
     glGenTextures(1, &ID);
-    bind();
+    bindForUpdate();
     
     // Set default parameters
-    setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-    setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
-    setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    setDefaultParameters(*this);
     
     // Load image using stb_image
     stbi_set_flip_vertically_on_load(true);
     unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
     
     if (data) {
-        GLenum internalFormat = format;
-        GLenum dataFormat = format;
-        
         // Auto-detect format based on channels
-        if (channels == 1) {
-            internalFormat = dataFormat = GL_RED;
-        } else if (channels == 3) {
-            internalFormat = dataFormat = GL_RGB;
-        } else if (channels == 4) {
-            internalFormat = dataFormat = GL_RGBA;
-        }
+        GLenum internalFormat = formatForChannels(channels, format);
+        GLenum dataFormat = internalFormat;
         
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
@@ -41,9 +55,27 @@ Texture::Texture(const std::string& imagePath, GLenum format)
     }
 }
 
+Texture::Texture(int width, int height, int channels, const void* pixels)
+    : ID(0), width(width), height(height), channels(channels) {
+    glGenTextures(1, &ID);
+    setDefaultParameters(*this);
+
+    // Rows of 1 or 3 channel images are not 4 byte aligned
+    GLenum format = formatForChannels(channels, GL_RGBA);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+Texture::Texture(int width, int height, int channels)
+    : ID(0), width(width), height(height), channels(channels) {
+    glGenTextures(1, &ID);
+    setDefaultParameters(*this);
+}
+
 Texture::~Texture() {
     if (ID != 0) {
-        glDeleteTextures(1, &ID);
+        glstate::deleteTextures(1, &ID);
     }
 }
 
@@ -58,7 +90,7 @@ Texture::Texture(Texture&& other) noexcept
 Texture& Texture::operator=(Texture&& other) noexcept {
     if (this != &other) {
         if (ID != 0) {
-            glDeleteTextures(1, &ID);
+            glstate::deleteTextures(1, &ID);
         }
         ID = other.ID;
         width = other.width;
@@ -74,15 +106,27 @@ Texture& Texture::operator=(Texture&& other) noexcept {
 }
 
 void Texture::bind(unsigned int slot) const {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    glstate::bindTexture(slot, GL_TEXTURE_2D, ID);
+}
+
+void Texture::bindForUpdate() const {
+    glstate::bindTexture(GL_TEXTURE_2D, ID);
 }
 
 void Texture::unbind() const {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glstate::bindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::setParameter(GLenum pname, GLint param) {
-    bind();
+    bindForUpdate();
     glTexParameteri(GL_TEXTURE_2D, pname, param);
-}
\ No newline at end of file
+}
+
+GLenum Texture::getFormat() const {
+    return formatForChannels(channels, GL_RGBA);
+}
+
+void Texture::generateMipmaps() {
+    bindForUpdate();
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
@@ -0,0 +1,55 @@
+#include "TextureBuffer.h"
+#include "GLState.h"
+
+TextureBuffer::TextureBuffer(GLenum internalFormat, const void* data, size_t size, GLenum usage)
+    : bufferID(0), textureID(0), internalFormat(internalFormat) {
+    glGenBuffers(1, &bufferID);
+    glstate::bindBuffer(GL_TEXTURE_BUFFER, bufferID);
+    glBufferData(GL_TEXTURE_BUFFER, size, data, usage);
+
+    glGenTextures(1, &textureID);
+    glstate::bindTexture(GL_TEXTURE_BUFFER, textureID);
+    glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, bufferID);
+}
+
+TextureBuffer::~TextureBuffer() {
+    release();
+}
+
+TextureBuffer::TextureBuffer(TextureBuffer&& other) noexcept
+    : bufferID(other.bufferID), textureID(other.textureID), internalFormat(other.internalFormat) {
+    other.bufferID = 0;
+    other.textureID = 0;
+}
+
+TextureBuffer& TextureBuffer::operator=(TextureBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        bufferID = other.bufferID;
+        textureID = other.textureID;
+        internalFormat = other.internalFormat;
+        other.bufferID = 0;
+        other.textureID = 0;
+    }
+    return *this;
+}
+
+void TextureBuffer::release() {
+    if (textureID != 0) {
+        glstate::deleteTextures(1, &textureID);
+        textureID = 0;
+    }
+    if (bufferID != 0) {
+        glstate::deleteBuffers(1, &bufferID);
+        bufferID = 0;
+    }
+}
+
+void TextureBuffer::bind(unsigned int slot) const {
+    glstate::bindTexture(slot, GL_TEXTURE_BUFFER, textureID);
+}
+
+void TextureBuffer::setData(const void* data, size_t size, GLenum usage) {
+    glstate::bindBuffer(GL_TEXTURE_BUFFER, bufferID);
+    glBufferData(GL_TEXTURE_BUFFER, size, data, usage);
+}
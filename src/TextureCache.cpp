@@ -0,0 +1,233 @@
+#include "TextureCache.h"
+#include "GLExtensions.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <stb_image.h>
+
+// EXT_texture_compression_s3tc is not part of core GL, so glad leaves it out
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'O', 'G', 'L', 'T'};
+// Bump whenever the layout or the encoders change
+const uint32_t VERSION = 1;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+GLenum uncompressedFormat(int channels) {
+    switch (channels) {
+    case 1:
+        return GL_RED;
+    case 2:
+        return GL_RG;
+    case 3:
+        return GL_RGB;
+    default:
+        return GL_RGBA;
+    }
+}
+
+GLenum compressedFormat(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+// 2x2 box filter, the same as glGenerateMipmap does in practice. Odd sizes
+// repeat the last row or column.
+std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, int width, int height, int channels) {
+    int outWidth = std::max(width / 2, 1), outHeight = std::max(height / 2, 1);
+    std::vector<unsigned char> out((size_t)outWidth * outHeight * channels);
+    for (int y = 0; y < outHeight; y++) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < outWidth; x++) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < channels; c++) {
+                int sum = pixels[((size_t)y0 * width + x0) * channels + c] + pixels[((size_t)y0 * width + x1) * channels + c] +
+                          pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+                out[((size_t)y * outWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return out;
+}
+
+bool isOpaque(const unsigned char* pixels, size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount; i++) {
+        if (pixels[i * 4 + 3] != 255) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+CachedTexture::CachedTexture(MappedFile&& file)
+    : file(std::move(file)),
+      header((const TextureFileHeader*)this->file.getData()),
+      levels((const TextureFileLevel*)(this->file.getData() + sizeof(TextureFileHeader))) {}
+
+void CachedTexture::uploadLevel(int level) const {
+    const TextureFileLevel& info = levels[level];
+    const unsigned char* data = file.getData() + info.offset;
+    BlockFormat format = getFormat();
+    if (format == BlockFormat::None) {
+        GLenum pixelFormat = uncompressedFormat(getChannels());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, pixelFormat, info.width, info.height, 0, pixelFormat, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } else {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat(format), info.width, info.height, 0,
+                               (GLsizei)info.size, data);
+    }
+}
+
+TextureCache::TextureCache(std::string directory, bool compress)
+    : directory(std::move(directory)), compress(compress),
+      s3tcSupported(glext::hasExtension("GL_EXT_texture_compression_s3tc")) {
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+}
+
+std::string TextureCache::entryPath(const std::string& imagePath) const {
+    std::ostringstream name;
+    name << std::hex << fnv1a64(imagePath) << ".tex";
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+std::unique_ptr<CachedTexture> TextureCache::load(const std::string& imagePath) const {
+    MappedFile source(imagePath);
+    if (!source.isOpen()) {
+        return nullptr;
+    }
+    uint64_t sourceHash = fnv1a64(std::string_view((const char*)source.getData(), source.getSize()));
+    std::string cachePath = entryPath(imagePath);
+
+    // Second attempt reads back what build() just wrote
+    for (int attempt = 0; attempt < 2; attempt++) {
+        MappedFile entry(cachePath);
+        if (entry.isOpen() && entry.getSize() >= sizeof(TextureFileHeader)) {
+            const auto* header = (const TextureFileHeader*)entry.getData();
+            const auto* levels = (const TextureFileLevel*)(entry.getData() + sizeof(TextureFileHeader));
+            BlockFormat format = (BlockFormat)header->format;
+            bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->version == VERSION &&
+                         header->sourceHash == sourceHash && header->compressRequested == (uint32_t)compress &&
+                         header->levelCount > 0 &&
+                         (s3tcSupported || (format != BlockFormat::BC1 && format != BlockFormat::BC3)) &&
+                         entry.getSize() >= sizeof(TextureFileHeader) + header->levelCount * sizeof(TextureFileLevel);
+            for (uint32_t i = 0; valid && i < header->levelCount; i++) {
+                valid = levels[i].offset + levels[i].size <= entry.getSize();
+            }
+            if (valid) {
+                return std::make_unique<CachedTexture>(std::move(entry));
+            }
+        }
+        if (attempt == 0 && !build(source, cachePath, sourceHash)) {
+            return nullptr;
+        }
+    }
+    std::cerr << "ERROR::TEXTURE_CACHE::INVALID_ENTRY: " << cachePath << std::endl;
+    return nullptr;
+}
+
+bool TextureCache::build(const MappedFile& source, const std::string& cachePath, uint64_t sourceHash) const {
+    // The flip flag is global by default; other threads may be decoding
+    stbi_set_flip_vertically_on_load_thread(true);
+    int width, height, channels;
+    unsigned char* decoded = stbi_load_from_memory(source.getData(), (int)source.getSize(), &width, &height, &channels, 0);
+    if (!decoded) {
+        return false;
+    }
+    std::vector<unsigned char> pixels(decoded, decoded + (size_t)width * height * channels);
+    stbi_image_free(decoded);
+
+    BlockFormat format = BlockFormat::None;
+    if (compress) {
+        if (channels <= 2) {
+            format = BlockFormat::BC5;
+        } else if (s3tcSupported) {
+            bool opaque = channels == 3 || isOpaque(pixels.data(), (size_t)width * height);
+            format = opaque ? BlockFormat::BC1 : BlockFormat::BC3;
+        }
+    }
+
+    int levelCount = 1;
+    while ((width >> levelCount) > 0 || (height >> levelCount) > 0) {
+        levelCount++;
+    }
+
+    TextureFileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceHash = sourceHash;
+    header.format = (uint32_t)format;
+    header.channels = (uint32_t)channels;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.levelCount = (uint32_t)levelCount;
+    header.compressRequested = compress;
+
+    std::vector<TextureFileLevel> levels(levelCount);
+    std::vector<unsigned char> data;
+    size_t dataStart = alignUp(sizeof(TextureFileHeader) + levelCount * sizeof(TextureFileLevel), 16);
+    int levelWidth = width, levelHeight = height;
+    for (int level = 0; level < levelCount; level++) {
+        size_t offset = alignUp(data.size(), 16);
+        size_t size = blockCompressedSize(format, levelWidth, levelHeight, channels);
+        data.resize(offset + size);
+        compressBlocks(format, pixels.data(), levelWidth, levelHeight, channels, data.data() + offset);
+        levels[level] = {(uint32_t)levelWidth, (uint32_t)levelHeight, dataStart + offset, size};
+
+        if (level + 1 < levelCount) {
+            pixels = downsample(pixels, levelWidth, levelHeight, channels);
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+        }
+    }
+
+    // Written under a temporary name and renamed into place, so a reader on
+    // another thread or process never maps a half-written entry
+    std::ostringstream tempPath;
+    tempPath << cachePath << '.' << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+    {
+        std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+        std::vector<char> padding(dataStart - sizeof(TextureFileHeader) - levelCount * sizeof(TextureFileLevel), 0);
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)levels.data(), levels.size() * sizeof(TextureFileLevel));
+        file.write(padding.data(), padding.size());
+        file.write((const char*)data.data(), data.size());
+        if (!file) {
+            std::cerr << "ERROR::TEXTURE_CACHE::CANNOT_WRITE: " << tempPath.str() << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath.str(), cachePath, error);
+    if (error) {
+        std::cerr << "ERROR::TEXTURE_CACHE::CANNOT_WRITE: " << cachePath << std::endl;
+        std::filesystem::remove(tempPath.str(), error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,182 @@
+#include "TextureLoader.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stb_image.h>
+
+TextureLoader::Decode::~Decode() {
+    if (pixels) {
+        stbi_image_free(pixels);
+    }
+}
+
+TextureLoader::TextureLoader(ThreadPool& pool, const TextureCache* cache, size_t uploadBudget)
+    : pool(pool), cache(cache), uploadBudget(uploadBudget), decodesInFlight(0), nextPbo(0) {
+    glGenBuffers(PBO_COUNT, pbos);
+}
+
+TextureLoader::~TextureLoader() {
+    // Workers still reference the mutex and condition variable
+    std::unique_lock<std::mutex> lock(mutex);
+    decoded.wait(lock, [this] { return decodesInFlight == 0; });
+    lock.unlock();
+    glstate::deleteBuffers(PBO_COUNT, pbos);
+}
+
+std::shared_ptr<Texture> TextureLoader::load(const std::string& imagePath) {
+    static const unsigned char grey[4] = {128, 128, 128, 255};
+    auto texture = std::make_shared<Texture>(1, 1, 4, grey);
+
+    auto decode = std::make_shared<Decode>();
+    decode->path = imagePath;
+    decoding.push_back({texture, decode, nullptr});
+    stats.requested++;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        decodesInFlight++;
+    }
+    pool.submitBackground([this, decode] {
+        profiler::CpuScope scope("Texture decode");
+        unsigned char* pixels = nullptr;
+        std::unique_ptr<CachedTexture> cached;
+        if (cache) {
+            cached = cache->load(decode->path);
+        } else {
+            // The flip flag is global by default; other threads may be decoding
+            stbi_set_flip_vertically_on_load_thread(true);
+            pixels = stbi_load(decode->path.c_str(), &decode->width, &decode->height, &decode->channels, 0);
+        }
+        // Notify under the lock: the destructor may free the condition
+        // variable as soon as decodesInFlight reaches zero
+        std::lock_guard<std::mutex> lock(mutex);
+        decode->pixels = pixels;
+        decode->cached = std::move(cached);
+        decode->done = true;
+        decodesInFlight--;
+        decoded.notify_all();
+    });
+    return texture;
+}
+
+void TextureLoader::collectDecoded() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto firstPending = std::stable_partition(decoding.begin(), decoding.end(),
+                                              [](const Job& job) { return job.decode->done; });
+    for (auto it = decoding.begin(); it != firstPending; ++it) {
+        if (it->decode->pixels || it->decode->cached) {
+            uploads.push_back(std::move(*it));
+        } else {
+            std::cerr << "ERROR::TEXTURE::FAILED_TO_LOAD: " << it->decode->path << std::endl;
+            stats.failed++;
+        }
+    }
+    decoding.erase(decoding.begin(), firstPending);
+}
+
+size_t TextureLoader::uploadRows(Job& job, size_t budget) {
+    const Decode& image = *job.decode;
+    if (!job.staging) {
+        job.staging = std::make_unique<Texture>(image.width, image.height, image.channels, nullptr);
+    }
+
+    // Whole rows only; at least one so an oversized row cannot stall the queue
+    size_t rowSize = (size_t)image.width * image.channels;
+    int rows = (int)std::min<size_t>(std::max<size_t>(budget / rowSize, 1), image.height - job.nextRow);
+    size_t size = rows * rowSize;
+
+    // Orphaning the buffer lets the driver hand out fresh storage instead
+    // of waiting for the previous transfer from it to finish
+    glstate::bindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPbo]);
+    nextPbo = (nextPbo + 1) % PBO_COUNT;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst) {
+        // The placeholder stays, as for an image that failed to decode
+        std::cerr << "ERROR::TEXTURE::MAP_FAILED: " << image.path << std::endl;
+        glstate::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        job.failed = true;
+        return 0;
+    }
+    std::memcpy(dst, image.pixels + job.nextRow * rowSize, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    job.staging->bindForUpdate();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.nextRow, image.width, rows,
+                    job.staging->getFormat(), GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // Unbound before the next staging texture is allocated, or its null
+    // pixels would be read as an offset into this buffer
+    glstate::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    job.nextRow += rows;
+
+    if (job.nextRow == image.height) {
+        job.staging->generateMipmaps();
+    }
+    return size;
+}
+
+size_t TextureLoader::uploadLevel(Job& job) {
+    const CachedTexture& image = *job.decode->cached;
+    if (!job.staging) {
+        job.staging = std::make_unique<Texture>(image.getWidth(), image.getHeight(), image.getChannels());
+    }
+    job.staging->bindForUpdate();
+    image.uploadLevel(job.nextLevel);
+    return image.getLevelSize(job.nextLevel++);
+}
+
+void TextureLoader::upload(size_t budget) {
+    size_t uploaded = 0;
+    while (!uploads.empty() && (uploaded < budget || uploaded == 0)) {
+        Job& job = uploads.front();
+        const Decode& image = *job.decode;
+        bool complete;
+        if (image.cached) {
+            uploaded += uploadLevel(job);
+            complete = job.nextLevel == image.cached->getLevelCount();
+        } else {
+            uploaded += uploadRows(job, budget > uploaded ? budget - uploaded : 0);
+            complete = job.nextRow == image.height;
+        }
+
+        if (job.failed) {
+            stats.failed++;
+            uploads.pop_front();
+        } else if (complete) {
+            // Everyone holding the placeholder now samples the real texture
+            *job.texture = std::move(*job.staging);
+            stats.resident++;
+            uploads.pop_front();
+        }
+    }
+    stats.bytesUploaded += uploaded;
+}
+
+void TextureLoader::update() {
+    collectDecoded();
+    if (!uploads.empty()) {
+        upload(uploadBudget);
+    }
+}
+
+void TextureLoader::finish() {
+    for (;;) {
+        collectDecoded();
+        if (!uploads.empty()) {
+            upload(std::numeric_limits<size_t>::max());
+        }
+        if (decoding.empty()) {
+            return;
+        }
+        // Upload each image as soon as it is decoded rather than after all of them
+        std::unique_lock<std::mutex> lock(mutex);
+        decoded.wait(lock, [this] {
+            return std::any_of(decoding.begin(), decoding.end(), [](const Job& job) { return job.decode->done; });
+        });
+    }
+}
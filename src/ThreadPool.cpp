@@ -0,0 +1,287 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+
+// Failed attempts to find a job before a thread goes to sleep; yielding in
+// between keeps short gaps, such as between two parallelFor calls, from
+// costing a wake-up
+const unsigned int IDLE_SPINS = 64;
+
+// Room for a frame's worth of jobs in every queue up front
+const size_t INITIAL_QUEUE_CAPACITY = 256;
+
+// The pool the calling thread works for, if any, and its deque there
+thread_local const ThreadPool* workerPool = nullptr;
+thread_local size_t workerIndex = 0;
+
+} // namespace
+
+void ThreadPool::WorkQueue::pushBack(Job&& job) {
+    if (count == jobs.size()) {
+        // Unwrapped into the new storage
+        std::vector<Job> grown(std::max<size_t>(jobs.size() * 2, INITIAL_QUEUE_CAPACITY));
+        for (size_t i = 0; i < count; i++) {
+            grown[i] = std::move(jobs[(first + i) % jobs.size()]);
+        }
+        jobs.swap(grown);
+        first = 0;
+    }
+    jobs[(first + count) % jobs.size()] = std::move(job);
+    count++;
+}
+
+bool ThreadPool::WorkQueue::popBack(Job& job) {
+    if (count == 0) {
+        return false;
+    }
+    count--;
+    job = std::move(jobs[(first + count) % jobs.size()]);
+    return true;
+}
+
+bool ThreadPool::WorkQueue::popFront(Job& job) {
+    if (count == 0) {
+        return false;
+    }
+    job = std::move(jobs[first]);
+    first = (first + 1) % jobs.size();
+    count--;
+    return true;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : queuedJobs(0), queuedBackground(0), sleepers(0), stopping(false) {
+    unsigned int workerCount = std::max(threadCount, 1u) - 1;
+    for (unsigned int i = 0; i <= workerCount; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+        queues.back()->jobs.resize(INITIAL_QUEUE_CAPACITY);
+    }
+    background.jobs.resize(INITIAL_QUEUE_CAPACITY);
+    for (unsigned int i = 0; i < workerCount; i++) {
+        workers.emplace_back([this, i] {
+            profiler::setThreadName("Worker " + std::to_string(i + 1));
+            workerLoop(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::homeQueue() const {
+    return workerPool == this ? workerIndex : workers.size();
+}
+
+void ThreadPool::wakeSleepers(bool all) {
+    if (sleepers == 0) {
+        return;
+    }
+    // Taking the lock orders this after a sleeper's last check of its
+    // condition, so the notification cannot slip in before it waits
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    if (all) {
+        available.notify_all();
+    } else {
+        available.notify_one();
+    }
+}
+
+void ThreadPool::push(Job job) {
+    if (workers.empty()) {
+        runJob(job);
+        return;
+    }
+    WorkQueue& queue = *queues[homeQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pushBack(std::move(job));
+    }
+    queuedJobs++;
+    wakeSleepers(false);
+}
+
+bool ThreadPool::popJob(size_t home, bool allowBackground, Job& job) {
+    if (queuedJobs > 0) {
+        // Own deque first, newest job; then the oldest of every other one
+        size_t count = queues.size();
+        for (size_t i = 0; i < count; i++) {
+            WorkQueue& queue = *queues[(home + i) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (i == 0 ? queue.popBack(job) : queue.popFront(job)) {
+                queuedJobs--;
+                return true;
+            }
+        }
+    }
+    if (allowBackground && queuedBackground > 0) {
+        std::lock_guard<std::mutex> lock(background.mutex);
+        if (background.popFront(job)) {
+            queuedBackground--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runJob(Job& job) {
+    job.task();
+    // Whatever it captured goes before anyone learns it has finished
+    job.task.reset();
+    finishJob(job.counter);
+}
+
+void ThreadPool::finishJob(JobCounter* counter) {
+    if (!counter) {
+        return;
+    }
+    std::vector<JobCounter::Continuation> inlineContinuations;
+    bool finished;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        finished = --counter->pending == 0;
+        if (finished && workers.empty()) {
+            // push() would run them right here, and they may touch the counter
+            inlineContinuations.swap(counter->continuations);
+        } else if (finished) {
+            // Queued under the lock, as the counter may be gone once it is
+            // released; the vector keeps its capacity for the next frame
+            for (JobCounter::Continuation& continuation : counter->continuations) {
+                push(Job{std::move(continuation.task), continuation.counter});
+            }
+            counter->continuations.clear();
+        }
+    }
+    for (JobCounter::Continuation& continuation : inlineContinuations) {
+        push(Job{std::move(continuation.task), continuation.counter});
+    }
+    if (finished) {
+        wakeSleepers(true);
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    workerPool = this;
+    workerIndex = index;
+    unsigned int idle = 0;
+    for (;;) {
+        Job job;
+        if (popJob(index, true, job)) {
+            runJob(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers++;
+        available.wait(lock, [this] { return stopping || queuedJobs > 0 || queuedBackground > 0; });
+        sleepers--;
+        // Queued jobs still run on the way out
+        if (stopping && queuedJobs == 0 && queuedBackground == 0) {
+            return;
+        }
+        idle = 0;
+    }
+}
+
+void ThreadPool::submit(JobFunction task, JobCounter* counter) {
+    if (counter) {
+        counter->pending++;
+    }
+    push(Job{std::move(task), counter});
+}
+
+void ThreadPool::submitAfter(JobCounter& dependency, JobFunction task, JobCounter* counter) {
+    if (counter) {
+        counter->pending++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (dependency.pending != 0) {
+            dependency.continuations.push_back(JobCounter::Continuation{std::move(task), counter});
+            return;
+        }
+    }
+    push(Job{std::move(task), counter});
+}
+
+void ThreadPool::submitBackground(JobFunction task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(background.mutex);
+        background.pushBack(Job{std::move(task), nullptr});
+    }
+    queuedBackground++;
+    // Only workers take these, and one woken with notify_one might not be
+    wakeSleepers(true);
+}
+
+void ThreadPool::wait(JobCounter& counter) {
+    size_t home = homeQueue();
+    unsigned int idle = 0;
+    while (counter.pending != 0) {
+        Job job;
+        if (popJob(home, false, job)) {
+            runJob(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers++;
+        available.wait(lock, [&] { return counter.pending == 0 || queuedJobs > 0; });
+        sleepers--;
+        idle = 0;
+    }
+    // The job that finished last may still be handing its continuations on
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grainSize, RangeFunction fn) {
+    grainSize = std::max<size_t>(grainSize, 1);
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount <= 1 || workers.empty()) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    // Helpers claim chunks until none are left; the wait below covers the
+    // ones that only start after the loop is done, so they can live here
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        size_t chunk;
+        while ((chunk = next.fetch_add(1)) < chunkCount) {
+            size_t begin = chunk * grainSize;
+            fn(begin, std::min(begin + grainSize, count));
+        }
+    };
+
+    JobCounter done;
+    size_t helpers = std::min(workers.size(), chunkCount - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        submit(work, &done);
+    }
+    work();
+    wait(done);
+}
@@ -0,0 +1,64 @@
+#include "UniformBuffer.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+
+UniformBuffer::UniformBuffer(const void* data, size_t size, GLenum usage) : ID(0), size(size) {
+    glGenBuffers(1, &ID);
+    bind();
+    glBufferData(GL_UNIFORM_BUFFER, size, data, usage);
+}
+
+UniformBuffer::~UniformBuffer() {
+    if (ID != 0) {
+        glstate::deleteBuffers(1, &ID);
+    }
+}
+
+UniformBuffer::UniformBuffer(UniformBuffer&& other) noexcept : ID(other.ID), size(other.size) {
+    other.ID = 0;
+    other.size = 0;
+}
+
+UniformBuffer& UniformBuffer::operator=(UniformBuffer&& other) noexcept {
+    if (this != &other) {
+        if (ID != 0) {
+            glstate::deleteBuffers(1, &ID);
+        }
+        ID = other.ID;
+        size = other.size;
+        other.ID = 0;
+        other.size = 0;
+    }
+    return *this;
+}
+
+void UniformBuffer::bind() const {
+    glstate::bindBuffer(GL_UNIFORM_BUFFER, ID);
+}
+
+void UniformBuffer::unbind() const {
+    glstate::bindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::setData(const void* data, size_t size, GLenum usage) {
+    bind();
+    this->size = size;
+    glBufferData(GL_UNIFORM_BUFFER, size, data, usage);
+}
+
+void UniformBuffer::setSubData(size_t offset, const void* data, size_t size) {
+    bind();
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void UniformBuffer::bindBase(unsigned int binding) const {
+    glstate::bindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+void UniformBuffer::bindRange(unsigned int binding, size_t offset, size_t size) const {
+    glstate::bindBufferRange(GL_UNIFORM_BUFFER, binding, ID, offset, size);
+}
+
+size_t UniformBuffer::getOffsetAlignment() {
+    return StreamBuffer::getUniformOffsetAlignment();
+}
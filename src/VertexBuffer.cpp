@@ -1,4 +1,5 @@
 #include "VertexBuffer.h"
+#include "GLState.h"
 
 VertexBuffer::VertexBuffer(const void* data, size_t size, GLenum usage) : ID(0) {
     glGenBuffers(1, &ID);
@@ -8,7 +9,7 @@ VertexBuffer::VertexBuffer(const void* data, size_t size, GLenum usage) : ID(0)
 
 VertexBuffer::~VertexBuffer() {
     if (ID != 0) {
-        glDeleteBuffers(1, &ID);
+        glstate::deleteBuffers(1, &ID);
     }
 }
 
@@ -19,7 +20,7 @@ VertexBuffer::VertexBuffer(VertexBuffer&& other) noexcept : ID(other.ID) {
 VertexBuffer& VertexBuffer::operator=(VertexBuffer&& other) noexcept {
     if (this != &other) {
         if (ID != 0) {
-            glDeleteBuffers(1, &ID);
+            glstate::deleteBuffers(1, &ID);
         }
         ID = other.ID;
         other.ID = 0;
@@ -28,11 +29,11 @@ VertexBuffer& VertexBuffer::operator=(VertexBuffer&& other) noexcept {
 }
 
 void VertexBuffer::bind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, ID);
+    glstate::bindBuffer(GL_ARRAY_BUFFER, ID);
 }
 
 void VertexBuffer::unbind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glstate::bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void VertexBuffer::setData(const void* data, size_t size, GLenum usage) {
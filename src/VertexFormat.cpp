@@ -0,0 +1,362 @@
+#include "VertexFormat.h"
+#include "Mesh.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_FORMAT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+size_t positionSize(PositionEncoding encoding) {
+    return encoding == PositionEncoding::Float ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+size_t normalSize(NormalEncoding encoding) {
+    return encoding == NormalEncoding::Float ? 3 * sizeof(float) : 2 * sizeof(int16_t);
+}
+
+size_t texCoordSize(TexCoordEncoding encoding) {
+    return encoding == TexCoordEncoding::Float ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+}
+
+// Round to nearest even, with overflow to infinity and NaN kept quiet. The
+// SSE2 version below is the same algorithm on four lanes and must give
+// identical results.
+uint16_t floatToHalf(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint32_t half;
+    if (f >= (143u << 23)) {
+        half = f > (255u << 23) ? 0x7e00 : 0x7c00;
+    } else if (f < (113u << 23)) {
+        // Subnormal or zero: let the FPU round the shifted-out mantissa
+        const uint32_t magicBits = 126u << 23;
+        float magic, shifted;
+        std::memcpy(&magic, &magicBits, sizeof(magic));
+        std::memcpy(&shifted, &f, sizeof(shifted));
+        shifted += magic;
+        std::memcpy(&f, &shifted, sizeof(f));
+        half = f - magicBits;
+    } else {
+        uint32_t mantissaOdd = (f >> 13) & 1;
+        f += ((15u - 127u) << 23) + 0xfff + mantissaOdd;
+        half = f >> 13;
+    }
+    return (uint16_t)(half | (sign >> 16));
+}
+
+float halfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = std::ldexp((float)mantissa, -24);
+    } else if (exponent == 31) {
+        value = mantissa ? NAN : INFINITY;
+    } else {
+        value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// GL maps c to max(c / 32767, -1) for normalized shorts
+int16_t toSnorm16(float value) {
+    return (int16_t)std::lrint(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+float fromSnorm16(int16_t value) {
+    return std::max((float)value / 32767.0f, -1.0f);
+}
+
+// Octahedral map (Cigolle et al. 2014): project onto the L1 unit sphere and
+// fold the lower hemisphere over the diagonals
+glm::vec2 encodeOctahedral(const glm::vec3& normal) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+    float invLength = 1.0f / length;
+    glm::vec2 p(normal.x * invLength, normal.y * invLength);
+    if (normal.z < 0.0f) {
+        glm::vec2 folded(1.0f - std::abs(p.y), 1.0f - std::abs(p.x));
+        p.x = std::copysign(folded.x, p.x);
+        p.y = std::copysign(folded.y, p.y);
+    }
+    return p;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& e) {
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// The 16-bit fields of one vertex, for whichever attributes are not floats
+struct PackedVertex {
+    uint16_t position[3];
+    int16_t normal[2];
+    uint16_t texCoords[2];
+};
+
+void encodeScalar(const MeshVertex& vertex, const VertexFormat& format, const glm::vec3& offset,
+                  const glm::vec3& invScale, PackedVertex& packed) {
+    for (int c = 0; c < 3; c++) {
+        if (format.position == PositionEncoding::Half) {
+            packed.position[c] = floatToHalf(vertex.position[c]);
+        } else if (format.position == PositionEncoding::Snorm16) {
+            packed.position[c] = (uint16_t)toSnorm16((vertex.position[c] - offset[c]) * invScale[c]);
+        }
+    }
+    glm::vec2 octahedral = encodeOctahedral(vertex.normal);
+    packed.normal[0] = toSnorm16(octahedral.x);
+    packed.normal[1] = toSnorm16(octahedral.y);
+    packed.texCoords[0] = floatToHalf(vertex.texCoords.x);
+    packed.texCoords[1] = floatToHalf(vertex.texCoords.y);
+}
+
+void storeVertex(uint8_t* out, const MeshVertex& vertex, const PackedVertex& packed, const VertexFormat& format) {
+    if (format.position == PositionEncoding::Float) {
+        std::memcpy(out, &vertex.position, 3 * sizeof(float));
+    } else {
+        const uint16_t position[4] = {packed.position[0], packed.position[1], packed.position[2], 0};
+        std::memcpy(out, position, sizeof(position));
+    }
+    out += positionSize(format.position);
+    if (format.normal == NormalEncoding::Float) {
+        std::memcpy(out, &vertex.normal, 3 * sizeof(float));
+    } else {
+        std::memcpy(out, packed.normal, sizeof(packed.normal));
+    }
+    out += normalSize(format.normal);
+    if (format.texCoords == TexCoordEncoding::Float) {
+        std::memcpy(out, &vertex.texCoords, 2 * sizeof(float));
+    } else {
+        std::memcpy(out, packed.texCoords, sizeof(packed.texCoords));
+    }
+}
+
+#ifdef VERTEX_FORMAT_SSE2
+__m128i floatToHalf4(__m128 value) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 sign = _mm_and_ps(value, signMask);
+    __m128 absolute = _mm_xor_ps(value, sign);
+    __m128i bits = _mm_castps_si128(absolute);
+
+    __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absolute, absolute));
+    __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32(143 << 23), bits);
+    __m128i special = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+    const __m128i magic = _mm_set1_epi32(126 << 23);
+    __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(113 << 23), bits);
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(magic))), magic);
+
+    __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32((int)(((15u - 127u) << 23) + 0xfff))), mantissaOdd);
+    normal = _mm_srli_epi32(normal, 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    __m128i half = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, special));
+    return _mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+}
+
+__m128i toSnorm16x4(__m128 value) {
+    value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+    return _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(32767.0f)));
+}
+
+// Four vertices per call: attributes are transposed into one register per
+// component, converted, and written back out per vertex
+void encodeSse2(const MeshVertex* vertices, const VertexFormat& format, const glm::vec3& offset,
+                const glm::vec3& invScale, PackedVertex* packed) {
+    auto gather = [&](auto member, int c) {
+        return _mm_setr_ps(member(vertices[0])[c], member(vertices[1])[c], member(vertices[2])[c],
+                           member(vertices[3])[c]);
+    };
+    auto position = [](const MeshVertex& v) -> const glm::vec3& { return v.position; };
+    auto normal = [](const MeshVertex& v) -> const glm::vec3& { return v.normal; };
+    auto texCoords = [](const MeshVertex& v) -> const glm::vec2& { return v.texCoords; };
+
+    alignas(16) int32_t lanes[7][4];
+    for (int c = 0; c < 3; c++) {
+        __m128 p = gather(position, c);
+        __m128i encoded = format.position == PositionEncoding::Half
+                              ? floatToHalf4(p)
+                              : toSnorm16x4(_mm_mul_ps(_mm_sub_ps(p, _mm_set1_ps(offset[c])), _mm_set1_ps(invScale[c])));
+        _mm_store_si128((__m128i*)lanes[c], encoded);
+    }
+
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 x = gather(normal, 0), y = gather(normal, 1), z = gather(normal, 2);
+    __m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)),
+                               _mm_andnot_ps(signMask, z));
+    __m128 nonZero = _mm_cmpneq_ps(length, _mm_setzero_ps());
+    __m128 invLength = _mm_and_ps(_mm_div_ps(one, _mm_or_ps(length, _mm_andnot_ps(nonZero, one))), nonZero);
+    __m128 px = _mm_mul_ps(x, invLength), py = _mm_mul_ps(y, invLength);
+    __m128 foldedX = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, py)), _mm_and_ps(px, signMask));
+    __m128 foldedY = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, px)), _mm_and_ps(py, signMask));
+    __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+    px = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, px));
+    py = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, py));
+    _mm_store_si128((__m128i*)lanes[3], toSnorm16x4(px));
+    _mm_store_si128((__m128i*)lanes[4], toSnorm16x4(py));
+
+    _mm_store_si128((__m128i*)lanes[5], floatToHalf4(gather(texCoords, 0)));
+    _mm_store_si128((__m128i*)lanes[6], floatToHalf4(gather(texCoords, 1)));
+
+    for (int k = 0; k < 4; k++) {
+        for (int c = 0; c < 3; c++) {
+            packed[k].position[c] = (uint16_t)lanes[c][k];
+        }
+        packed[k].normal[0] = (int16_t)lanes[3][k];
+        packed[k].normal[1] = (int16_t)lanes[4][k];
+        packed[k].texCoords[0] = (uint16_t)lanes[5][k];
+        packed[k].texCoords[1] = (uint16_t)lanes[6][k];
+    }
+}
+#endif
+
+} // namespace
+
+size_t VertexFormat::getStride() const {
+    return positionSize(position) + normalSize(normal) + texCoordSize(texCoords);
+}
+
+glm::mat4 VertexEncoding::getPositionTransform() const {
+    glm::mat4 transform(1.0f);
+    transform[0][0] = positionScale.x;
+    transform[1][1] = positionScale.y;
+    transform[2][2] = positionScale.z;
+    transform[3] = glm::vec4(positionOffset, 1.0f);
+    return transform;
+}
+
+VertexEncoding encodeVertices(const MeshVertex* vertices, size_t count, const VertexFormat& format,
+                              std::vector<uint8_t>& out) {
+    VertexEncoding encoding;
+    encoding.format = format;
+    size_t stride = format.getStride();
+    out.resize(count * stride);
+
+    // Snorm positions span the bounding box, per axis
+    if (format.position == PositionEncoding::Snorm16 && count > 0) {
+        glm::vec3 lower = vertices[0].position, upper = vertices[0].position;
+        for (size_t i = 1; i < count; i++) {
+            lower = glm::min(lower, vertices[i].position);
+            upper = glm::max(upper, vertices[i].position);
+        }
+        encoding.positionOffset = (lower + upper) * 0.5f;
+        encoding.positionScale = (upper - lower) * 0.5f;
+        for (int c = 0; c < 3; c++) {
+            if (encoding.positionScale[c] <= 0.0f) {
+                encoding.positionScale[c] = 1.0f;
+            }
+        }
+    }
+    glm::vec3 invScale = 1.0f / encoding.positionScale;
+
+    if (format == FLOAT_VERTEX_FORMAT) {
+        std::memcpy(out.data(), vertices, count * sizeof(MeshVertex));
+        return encoding;
+    }
+
+    size_t i = 0;
+    PackedVertex packed[4];
+#ifdef VERTEX_FORMAT_SSE2
+    for (; i + 4 <= count; i += 4) {
+        encodeSse2(vertices + i, format, encoding.positionOffset, invScale, packed);
+        for (size_t k = 0; k < 4; k++) {
+            storeVertex(out.data() + (i + k) * stride, vertices[i + k], packed[k], format);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        encodeScalar(vertices[i], format, encoding.positionOffset, invScale, packed[0]);
+        storeVertex(out.data() + i * stride, vertices[i], packed[0], format);
+    }
+    return encoding;
+}
+
+void decodeVertices(const void* data, size_t count, const VertexEncoding& encoding, MeshVertex* out) {
+    const VertexFormat& format = encoding.format;
+    size_t stride = format.getStride();
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* in = (const uint8_t*)data + i * stride;
+        MeshVertex& vertex = out[i];
+
+        if (format.position == PositionEncoding::Float) {
+            std::memcpy(&vertex.position, in, 3 * sizeof(float));
+        } else {
+            uint16_t position[3];
+            std::memcpy(position, in, sizeof(position));
+            for (int c = 0; c < 3; c++) {
+                float value = format.position == PositionEncoding::Half ? halfToFloat(position[c])
+                                                                        : fromSnorm16((int16_t)position[c]);
+                vertex.position[c] = value * encoding.positionScale[c] + encoding.positionOffset[c];
+            }
+        }
+        in += positionSize(format.position);
+
+        if (format.normal == NormalEncoding::Float) {
+            std::memcpy(&vertex.normal, in, 3 * sizeof(float));
+        } else {
+            int16_t normal[2];
+            std::memcpy(normal, in, sizeof(normal));
+            vertex.normal = decodeOctahedral(glm::vec2(fromSnorm16(normal[0]), fromSnorm16(normal[1])));
+        }
+        in += normalSize(format.normal);
+
+        if (format.texCoords == TexCoordEncoding::Float) {
+            std::memcpy(&vertex.texCoords, in, 2 * sizeof(float));
+        } else {
+            uint16_t texCoords[2];
+            std::memcpy(texCoords, in, sizeof(texCoords));
+            vertex.texCoords = glm::vec2(halfToFloat(texCoords[0]), halfToFloat(texCoords[1]));
+        }
+    }
+}
+
+void setVertexAttributes(const VertexFormat& format) {
+    GLsizei stride = (GLsizei)format.getStride();
+    size_t offset = 0;
+
+    // position attribute
+    if (format.position == PositionEncoding::Float) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    } else if (format.position == PositionEncoding::Half) {
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+    } else {
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void*)offset);
+    }
+    glEnableVertexAttribArray(0);
+    offset += positionSize(format.position);
+
+    // normal attribute; octahedral normals arrive as (x, y, 0)
+    if (format.normal == NormalEncoding::Float) {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    } else {
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offset);
+    }
+    glEnableVertexAttribArray(1);
+    offset += normalSize(format.normal);
+
+    // texcoord attribute
+    glVertexAttribPointer(2, 2, format.texCoords == TexCoordEncoding::Float ? GL_FLOAT : GL_HALF_FLOAT, GL_FALSE,
+                          stride, (void*)offset);
+    glEnableVertexAttribArray(2);
+}
@@ -1,17 +1,16 @@
 #include "Camera.h"
+#include "GLExtensions.h"
+#include "Model.h"
+#include "Profiler.h"
+#include "Renderer.h"
 #include "Shader.h"
-#include "Texture.h"
-#include "VertexBuffer.h"
-#include "glm/ext/matrix_transform.hpp"
 #include "glm/fwd.hpp"
 #include <GLFW/glfw3.h>
-#include <format>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -27,8 +26,7 @@ std::map<std::string, Material> loadMaterials(const std::string &filename);
 void setMaterial(Shader &shader, const Material &material);
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
-void processInput(GLFWwindow *window, Shader &shader, Camera &camera,
-                  float deltaTime);
+void processInput(GLFWwindow *window, Camera &camera, float deltaTime);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
@@ -38,6 +36,12 @@ const unsigned int SCR_HEIGHT = 1080;
 float lastX = SCR_WIDTH / 2.0f, lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 bool spotlight = false;
+bool deferred = false;
+bool occlusion = true;
+bool lod = true;
+bool shadows = true;
+// Chrome trace written when a capture (P key) ends
+const char *PROFILE_PATH = "profile.json";
 
 // Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -45,27 +49,7 @@ Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 // Light animation toggle
 bool animateLight = false;
 
-// Cube positions
-glm::vec3 cubePositions[] = {
-    glm::vec3(0.0f, 0.0f, 0.0f),
-    glm::vec3(2.0f, 5.0f, -15.0f),
-    glm::vec3(-1.5f, -2.2f, -2.5f),
-    glm::vec3(-3.8f, -2.0f, -12.3f),
-    glm::vec3(2.4f, -0.4f, -3.5f),
-    glm::vec3(-1.7f, 3.0f, -7.5f),
-    glm::vec3(1.3f, -2.0f, -2.5f),
-    glm::vec3(1.5f, 2.0f, -2.5f),
-    glm::vec3(1.5f, 0.2f, -1.5f),
-    glm::vec3(-1.3f, 1.0f, -1.5f)};
-
-// Light Positions
-glm::vec3 pointLightPositions[] = {
-    glm::vec3(0.7f, 0.2f, 2.0f),
-    glm::vec3(2.3f, -3.3f, -4.0f),
-    glm::vec3(-4.0f, 2.0f, -12.0f),
-    glm::vec3(0.0f, 0.0f, -3.0f)};
-
-int main() {
+int main(int argc, char **argv) {
   // glfw: initialize and configure
   // ------------------------------
   glfwInit();
@@ -98,200 +82,67 @@ int main() {
     std::cout << "Failed to initialize GLAD" << std::endl;
     return -1;
   }
+  glext::load((GLADloadproc)glfwGetProcAddress);
+  profiler::setThreadName("Main");
 
   glEnable(GL_DEPTH_TEST);
 
-  float vertices[] = {
-      // positions          // normals           // texture coords
-      -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-      0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,
-      0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
-      0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
-      -0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,
-      -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-
-      -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-      0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-      0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-      0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-      -0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-      -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-
-      -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-      -0.5f, 0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-      -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-      -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-      -0.5f, -0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-      -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-
-      0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-      0.5f, 0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-      0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-      0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-      0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-      0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-
-      -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
-      0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,
-      0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-      0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-      -0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-      -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
-
-      -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-      0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
-      0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-      0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-      -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-      -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
-
-  Shader objectShader("shaders/vertex.glsl", "shaders/object.fragment.glsl");
-  Shader lightShader("shaders/vertex.glsl", "shaders/light.fragment.glsl");
-
-  // Create vertex array object and buffers
-  unsigned int lightVao, objectVao;
-  glGenVertexArrays(1, &lightVao);
-  glGenVertexArrays(1, &objectVao);
-
-  glBindVertexArray(lightVao);
-  VertexBuffer vbo(vertices, sizeof(vertices));
-
-  // position attribute
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
-
-  glBindVertexArray(objectVao);
-  vbo.bind();
-
-  // position attribute
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
-  // normal attribute
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-  // texcoord attribute
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
-
-  objectShader.use();
-  objectShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-
-  // Load container texture
-  Texture diffuseMap("textures/container2.png");
-  Texture specularMap("textures/container2_specular.png");
-
-  // Set texture uniform and material properties
-  objectShader.setInt("material.diffuse", 0);
-  objectShader.setInt("material.specular", 1);
-  objectShader.setFloat("material.shininess", 64.0f); // Higher shininess for more visible specular
-
-  // Set light intensities - boosted specular for more visible effect
-  objectShader.setVec3("light.ambient", 0.2f, 0.2f, 0.2f);
-  objectShader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-  objectShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f); // Stronger specular
+  // Optional model file to show among the cubes, given on the command line.
+  // Declared first so it outlives the renderer; its meshes are optimized
+  // and simplified on the renderer's thread pool.
+  std::unique_ptr<Model> model;
+  Renderer renderer;
+  if (argc > 1) {
+    model = std::make_unique<Model>(argv[1], "meshcache", &renderer.getThreadPool());
+    if (model->isLoaded()) {
+      renderer.setModel(model.get());
+    }
+  }
+  // Edits to the source tree's shaders/ show up while running
+  renderer.enableShaderHotReload();
 
   float deltaTime = 0.0f;
   float lastFrame = 0.0f;
 
-  GLuint objectModelLoc = glGetUniformLocation(objectShader.getID(), "model");
-  GLuint objectViewLoc = glGetUniformLocation(objectShader.getID(), "view");
-  GLuint objectProjLoc = glGetUniformLocation(objectShader.getID(), "projection");
-
-  GLuint lightModelLoc = glGetUniformLocation(lightShader.getID(), "model");
-  GLuint lightViewLoc = glGetUniformLocation(lightShader.getID(), "view");
-  GLuint lightProjLoc = glGetUniformLocation(lightShader.getID(), "projection");
-
-  // Set up point lights
-  for (int i = 0; i < 4; i++) {
-    objectShader.setVec3(std::format("pointLights[{}].position", i), pointLightPositions[i]);
-    objectShader.setVec3(std::format("pointLights[{}].ambient", i), 0.2f, 0.2f, 0.2f);
-    objectShader.setVec3(std::format("pointLights[{}].diffuse", i), 0.5f, 0.5f, 0.5f);
-    objectShader.setVec3(std::format("pointLights[{}].specular", i), 1.0f, 1.0f, 1.0f);
-    objectShader.setFloat(std::format("pointLights[{}].constant", i), 1.0f);
-    objectShader.setFloat(std::format("pointLights[{}].linear", i), 0.09f);
-    objectShader.setFloat(std::format("pointLights[{}].quadratic", i), 0.032f);
-  }
-
-  // Set up dir lights
-  objectShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-  objectShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-  objectShader.setVec3("dirLight.diffuse", 0.075f, 0.075f, 0.075f);
-  objectShader.setVec3("dirLight.specular", 0.1f, 0.1f, 0.1f);
-
-  // Setup spot light
-  objectShader.setVec3("spotLight.spotDir", camera.Front);
-  objectShader.setFloat("spotLight.phi", glm::cos(glm::radians(12.5f)));
-  objectShader.setFloat("spotLight.phiOuter", glm::cos(glm::radians(25.0f)));
-  objectShader.setVec3("spotLight.ambient", 0.05f, 0.05f, 0.05f);
-  objectShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-  objectShader.setVec3("spotLight.specular", 0.1f, 0.1f, 0.1f);
-  objectShader.setBool("spotLight.enabled", spotlight);
-
   while (!glfwWindowShouldClose(window)) {
+    profiler::beginFrame();
+    profiler::CpuScope frameScope("Frame");
     float currentFrame = (float)glfwGetTime();
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
 
-    processInput(window, objectShader, camera, deltaTime);
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // 1. Render the objects (multiple cubes)
-    objectShader.use();
-    glBindVertexArray(objectVao);
+    {
+      profiler::CpuScope inputScope("Input");
+      processInput(window, camera, deltaTime);
 
-    // Bind textures
-    diffuseMap.bind(0);
-    specularMap.bind(1);
-
-    glm::mat4 view = camera.GetViewMatrix();
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-
-    glUniformMatrix4fv(objectViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(objectProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Set directional light (like sunlight coming from above-right)
-    objectShader.setVec3("viewPos", camera.Position.x, camera.Position.y, camera.Position.z);
-
-    // Update spotlight
-    objectShader.setVec3("spotLight.spotDir", camera.Front);
-    objectShader.setBool("spotLight.enabled", spotlight);
-
-    // Render multiple cubes
-    for (unsigned int i = 0; i < 10; i++) {
-      glm::mat4 model = glm::mat4(1.0f);
-      model = glm::translate(model, cubePositions[i]);
-      float angle = 20.0f * i;
-      model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-      glUniformMatrix4fv(objectModelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+      renderer.setSpotlight(spotlight);
+      renderer.setRenderPath(deferred ? RenderPath::Deferred : RenderPath::Forward);
+      renderer.setOcclusionCulling(occlusion);
+      renderer.setLodEnabled(lod);
+      renderer.setShadows(shadows);
     }
-    // 2. Render the light source (white cube at lightPos)
-    lightShader.use();
-    glBindVertexArray(lightVao);
-
-    for (unsigned int i = 0; i < 4; i++) {
-      glm::mat4 lightModel = glm::mat4(1.0f);
-      lightModel = glm::translate(lightModel, pointLightPositions[i]);
-      lightModel = glm::scale(lightModel, glm::vec3(0.2f)); // Make it smaller
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    renderer.render(camera, width, height);
 
-      glUniformMatrix4fv(lightModelLoc, 1, GL_FALSE, glm::value_ptr(lightModel));
-      glUniformMatrix4fv(lightViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-      glUniformMatrix4fv(lightProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+    {
+      profiler::CpuScope swapScope("Swap");
+      glfwSwapBuffers(window);
     }
-
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    {
+      profiler::CpuScope eventScope("Poll events");
+      glfwPollEvents();
+    }
+  }
+  if (profiler::isCapturing()) {
+    profiler::endCapture(PROFILE_PATH);
   }
+  profiler::shutdown();
   glfwTerminate();
   return 0;
 }
 
-void processInput(GLFWwindow *window, Shader &shader, Camera &camera,
-                  float deltaTime) {
+void processInput(GLFWwindow *window, Camera &camera, float deltaTime) {
 
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
@@ -315,6 +166,61 @@ void processInput(GLFWwindow *window, Shader &shader, Camera &camera,
   if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) {
     fKeyPressed = false;
   }
+
+  // Forward/deferred shading toggle with G key
+  static bool gKeyPressed = false;
+  if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !gKeyPressed) {
+    gKeyPressed = true;
+    deferred = !deferred;
+  }
+  if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE) {
+    gKeyPressed = false;
+  }
+
+  // Occlusion culling toggle with O key
+  static bool oKeyPressed = false;
+  if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !oKeyPressed) {
+    oKeyPressed = true;
+    occlusion = !occlusion;
+  }
+  if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE) {
+    oKeyPressed = false;
+  }
+
+  // Model level of detail toggle with L key
+  static bool lKeyPressed = false;
+  if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !lKeyPressed) {
+    lKeyPressed = true;
+    lod = !lod;
+  }
+  if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE) {
+    lKeyPressed = false;
+  }
+
+  // Directional light shadow toggle with H key
+  static bool hKeyPressed = false;
+  if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !hKeyPressed) {
+    hKeyPressed = true;
+    shadows = !shadows;
+  }
+  if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE) {
+    hKeyPressed = false;
+  }
+
+  // Profiler capture start/stop with P key
+  static bool pKeyPressed = false;
+  if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pKeyPressed) {
+    pKeyPressed = true;
+    if (!profiler::isCapturing()) {
+      profiler::beginCapture();
+      std::cout << "Profiling..." << std::endl;
+    } else if (profiler::endCapture(PROFILE_PATH)) {
+      std::cout << "Profile written to " << PROFILE_PATH << std::endl;
+    }
+  }
+  if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE) {
+    pKeyPressed = false;
+  }
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {